@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "ThinkGearStreamParser.h"
+#include "ring.h"
 #include "ffft.h"
 #include "globals.h"
 #include "LCD.h"
@@ -21,6 +22,7 @@
 
 //added
 #include <util/delay.h>
+#include <util/atomic.h>
 #include <avr/interrupt.h>
 
 #define	SYSCLK		16000000
@@ -45,6 +47,9 @@
 // Define the digital pin to use for scrolling.
 #define SWITCH_SCROLL 9
 
+// Send the parser health counters once every this many loop passes (500 ms each).
+#define STATS_PERIOD 2
+
 const u08 SYNC = 0xAA;
 
 void capture_wave (int16_t *buffer, uint16_t count);
@@ -73,12 +78,26 @@ volatile int checksum;
 volatile int rd =0;
 volatile bool dofft = FALSE;
 ThinkGearStreamParser parser;
+ThinkGearFrame frame;
+
+// Bytes received from the headset, waiting to be parsed by the main loop.
+Ring rxRing;
+// Bytes lost by the UART itself because the ISR was not serviced in time.
+volatile u16 rxOverruns = 0;
+// Extended CODE level of the last unrecognized DataRow, shown by the main loop.
+u08 extendedLevel = 0;
 
 
 // Local prototypes
 
 static void connectHeadset();
+static void drainHeadset();
+static void waitMs(u16 ms);
+static void sendParserStats();
+static void uart0TransmitString(const char *string);
+static void uart0TransmitPString(PGM_P string);
 void test02 ( void );
+void handleFrameFunc( const ThinkGearFrame *frame, void *customData );
 void handleDataValueFunc( unsigned char extendedCodeLevel,
 unsigned char code,
 unsigned char valueLength,
@@ -90,10 +109,12 @@ void *customData );
 
 //! Initializes XiphosLibrary, pullups, and timers, prints version.
 
+// Only queue the byte here; parsing happens in drainHeadset() from the main loop
 ISR(USART1_RX_vect)
 {
-	u08 data = UDR1;
-	THINKGEAR_parseByte( &parser, data);
+	if (UCSR1A & (1<<DOR1))
+		rxOverruns++;
+	ringPut(&rxRing, UDR1);
 }
 
 
@@ -116,14 +137,29 @@ int main()
   analogPullups(0xFF);
 
 
- THINKGEAR_initParser( &parser, PARSER_TYPE_PACKETS,
-handleDataValueFunc, NULL );
+ THINKGEAR_initFrameParser( &parser, &frame,
+handleFrameFunc, handleDataValueFunc, NULL );
+ THINKGEAR_setResync( &parser, 1 );
     connectHeadset();
     
     
+u08 statsCount = 0;
+
 //super loop
 while(1)
 {
+	drainHeadset();
+	if(++statsCount >= STATS_PERIOD){
+		statsCount = 0;
+		sendParserStats();
+	}
+	if(extendedLevel){
+		// Show it for two seconds, still draining the headset meanwhile
+		clearScreen();
+		printHexDigit(extendedLevel);
+		extendedLevel = 0;
+		waitMs(2000);
+	}
 	if(dofft){
 		clearScreen();
 		upperLine();
@@ -165,7 +201,7 @@ while(1)
         motor0(127);
         motor1(127);
     }
-    delayMs(500);
+    waitMs(500);
 }
 
 }
@@ -174,66 +210,132 @@ while(1)
 
 static void connectHeadset()
 {
-	delayMs(3000);
+	waitMs(3000);
 	uart1Transmit(0xc2); //Signal to dongle to connect
 	attention = 0;
 }
 
 
+// Runs the parser over everything the ISR has queued so far
+static void drainHeadset()
+{
+	const u08 *bytes;
+	u08 n;
+
+	while ((n = ringPeek(&rxRing, &bytes)) != 0)
+	{
+		THINKGEAR_parseBuffer(&parser, bytes, n);
+		ringConsume(&rxRing, n);
+	}
+}
+
+// Like delayMs(), but keeps draining headset data while waiting
+static void waitMs(u16 ms)
+{
+	while (ms--)
+	{
+		drainHeadset();
+		delayMs(1);
+	}
+}
+
+// Sends the parser's link health counters to the PC, then the bytes lost
+// before they reached the parser:
+// tg_stats=[ bytesIn packetsOk checksumFailures oversizeLength syncSkipped
+// resyncs packetsRecovered maxGapBytes rows[0] ... rows[THINKGEAR_ROWS_KINDS-1] ];
+// rx_overflows=n rx_overruns=n;
+static void sendParserStats()
+{
+	ThinkGearParserStats stats;
+	uint32_t values[8];
+	u16 overflows, overruns;
+	char str[12];
+	u08 i;
+
+	THINKGEAR_getStats(&parser, &stats);
+	// The 16-bit counters are written by the ISR, so read them with interrupts disabled
+	ATOMIC_BLOCK(ATOMIC_FORCEON)
+	{
+		overflows = rxRing.overflows;
+		overruns = rxOverruns;
+	}
+	values[0] = stats.bytesIn;
+	values[1] = stats.packetsOk;
+	values[2] = stats.checksumFailures;
+	values[3] = stats.oversizeLength;
+	values[4] = stats.syncSkipped;
+	values[5] = stats.resyncs;
+	values[6] = stats.packetsRecovered;
+	values[7] = stats.maxGapBytes;
+
+	uart0TransmitPString(PSTR("tg_stats=[ "));
+	for (i = 0; i < 8 + THINKGEAR_ROWS_KINDS; i++)
+	{
+		sprintf_P(str, PSTR("%lu "), (unsigned long)(i < 8 ? values[i] : stats.rows[i-8]));
+		uart0TransmitString(str);
+		drainHeadset();
+	}
+	uart0TransmitPString(PSTR("];\r\n"));
+	sprintf_P(str, PSTR("%u"), overflows);
+	uart0TransmitPString(PSTR("rx_overflows="));
+	uart0TransmitString(str);
+	sprintf_P(str, PSTR("%u"), overruns);
+	uart0TransmitPString(PSTR(" rx_overruns="));
+	uart0TransmitString(str);
+	uart0TransmitPString(PSTR(";\r\n"));
+}
+
+static void uart0TransmitString(const char *string)
+{
+	while (*string)
+		uart0Transmit(*string++);
+}
+
+// Sends a string kept in flash, e.g. PSTR("..."), so it takes no SRAM
+static void uart0TransmitPString(PGM_P string)
+{
+	char ch;
+	while ((ch = pgm_read_byte_near(string++)) != 0)
+		uart0Transmit(ch);
+}
+
+void handleFrameFunc( const ThinkGearFrame *frame, void *customData ) {
+
+	u08 i;
+
+	/* [CODE]: ATTENTION eSense */
+	if(frame->present & THINKGEAR_FRAME_ATTENTION)
+		attention = frame->attention;
+
+	/* [CODE]: MEDITATION eSense */
+	if(frame->present & THINKGEAR_FRAME_MEDITATION)
+		meditation = frame->meditation;
+
+	/* [CODE]: 16-bit RAW wave values */
+	for(i = 0; i < frame->numRaw; i++) {
+		if (rd<2048){
+			rawdata[rd]= frame->raw[i];
+			rd++;
+		}
+		else
+		{
+			dofft = TRUE;
+		}
+	}
+}
+
+
+/* Only called for DataRows the frame decoder does not recognize.  Runs
+ * inside drainHeadset(), so it must not block: the main loop shows the
+ * level instead. */
 void handleDataValueFunc( unsigned char extendedCodeLevel,
 unsigned char code,
 unsigned char valueLength,
 const unsigned char *value,
 void *customData ) {
 
-	int i ;
-	if(extendedCodeLevel== 0 ) {
-		
-		switch( code ) {
-			
-			/* [CODE]: ATTENTION eSense */
-			case( 0x04 ):
-				attention= value[0];	
-			break;
-			
-			/* [CODE]: MEDITATION eSense */
-			case( 0x05 ):
-				meditation = value[0];
-
-			break;
-
-			case( 0x80 ):
-				if (rd<2048){
-					rawdata[rd]= value[0];//(value[0]<<8) | value[1];
-					rd++;
-				}
-				
-                else
-				{
-					dofft = TRUE;
-				}
-				
-
-			break;
-			
-			/* Other [CODE]s */
-			default:
-			//clearScreen();
-			//printString_P(PSTR("No Data"));
-			i=1;
-			i=i;
-			//lowerLine();
-			//printString_P(PSTR("Boohoo"));
-		}
-}
-	else 
-	
-{
-	clearScreen();
-	printHexDigit(extendedCodeLevel );
-	delayMs(2000);
-
-	
+	if(extendedCodeLevel != 0) {
+		extendedLevel = extendedCodeLevel;
 	}
 }
 
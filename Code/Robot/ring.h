@@ -0,0 +1,64 @@
+#ifndef RING_H
+#define RING_H
+
+#include "globals.h"
+
+/*! @file
+    Lock-free single-producer/single-consumer byte ring.
+
+    The producer (typically an ISR) only ever writes head, and the consumer
+    (the main loop) only ever writes tail.  Both indices are single bytes,
+    so every access is atomic on the AVR and no interrupts need to be
+    disabled on either side.  The indices wrap naturally at 256, so the
+    ring holds up to 255 bytes.
+ */
+
+//! Number of slots in the ring; must match the range of a u08 index.
+#define RING_SIZE 256
+
+//! Byte ring shared between one producer and one consumer.
+typedef struct
+{
+  volatile u08 head;        //!< Next slot to write. Only modified by the producer.
+  volatile u08 tail;        //!< Next slot to read. Only modified by the consumer.
+  volatile u16 overflows;   //!< Bytes dropped because the ring was full. Only modified by the producer.
+  volatile u08 data[RING_SIZE];
+} Ring;
+
+//! Appends a byte to the ring, or counts an overflow if the ring is full. Call from the producer only.
+static inline void ringPut(Ring *ring, u08 byte)
+{
+  u08 head = ring->head;
+  u08 next = head + 1;
+
+  if (next == ring->tail)
+  {
+    ring->overflows++;
+    return;
+  }
+  ring->data[head] = byte;
+  ring->head = next;
+}
+
+//! Points *bytes at the oldest unread bytes and returns how many are contiguous there. Call from the consumer only.
+static inline u08 ringPeek(Ring *ring, const u08 **bytes)
+{
+  u08 head = ring->head;
+  u08 tail = ring->tail;
+
+  *bytes = (const u08 *)&ring->data[tail];
+  if (head >= tail)
+  {
+    return head - tail;
+  }
+  // Only return up to the end of the array; the rest is picked up by the next peek.
+  return (u08)(RING_SIZE - tail);
+}
+
+//! Releases count bytes previously returned by ringPeek() back to the producer. Call from the consumer only.
+static inline void ringConsume(Ring *ring, u08 count)
+{
+  ring->tail += count;
+}
+
+#endif
@@ -32,6 +32,7 @@
 
 /* Include all external libraries required by this header */
 #include <stdlib.h>
+#include <stdint.h>
 
 /* Disable name-mangling when compiling as C++ */
 #ifdef __cplusplus
@@ -50,11 +51,96 @@ extern "C" {
 #define PARSER_CODE_MEDITATION         0x05
 #define PARSER_CODE_8BITRAW_SIGNAL     0x06
 #define PARSER_CODE_RAW_MARKER         0x07
+#define PARSER_CODE_BLINK_STRENGTH     0x16
 
 #define PARSER_CODE_RAW_SIGNAL         0x80
 #define PARSER_CODE_EEG_POWERS         0x81
 #define PARSER_CODE_ASIC_EEG_POWER_INT 0x83
 
+/* Dongle status CODE definitions (MindWave USB dongle) */
+#define PARSER_CODE_HEADSET_CONNECTED  0xD0
+#define PARSER_CODE_HEADSET_NOT_FOUND  0xD1
+#define PARSER_CODE_HEADSET_DISCONNECTED 0xD2
+#define PARSER_CODE_REQUEST_DENIED     0xD3
+#define PARSER_CODE_DONGLE_STANDBY     0xD4
+
+/* Number of bands in a PARSER_CODE_ASIC_EEG_POWER_INT DataRow */
+#define THINKGEAR_EEG_BANDS            8
+
+/* Most 16-bit raw samples a single Packet can carry (one per 2 bytes) */
+#define THINKGEAR_FRAME_MAX_RAW        84
+
+/* Bits of ThinkGearFrame.present */
+#define THINKGEAR_FRAME_BATTERY        0x0001
+#define THINKGEAR_FRAME_POOR_SIGNAL    0x0002
+#define THINKGEAR_FRAME_ATTENTION      0x0004
+#define THINKGEAR_FRAME_MEDITATION     0x0008
+#define THINKGEAR_FRAME_BLINK          0x0010
+#define THINKGEAR_FRAME_RAW            0x0020
+#define THINKGEAR_FRAME_EEG_POWER      0x0040
+#define THINKGEAR_FRAME_DONGLE         0x0080
+
+/* Indices into ThinkGearParserStats.rows[] */
+#define THINKGEAR_ROWS_BATTERY         0
+#define THINKGEAR_ROWS_POOR_SIGNAL     1
+#define THINKGEAR_ROWS_ATTENTION       2
+#define THINKGEAR_ROWS_MEDITATION      3
+#define THINKGEAR_ROWS_BLINK           4
+#define THINKGEAR_ROWS_RAW             5
+#define THINKGEAR_ROWS_EEG_POWER       6    /* 0x81 and 0x83 */
+#define THINKGEAR_ROWS_DONGLE          7    /* 0xD0-0xD4 */
+#define THINKGEAR_ROWS_EXTENDED        8    /* Any extended CODE level */
+#define THINKGEAR_ROWS_OTHER           9
+#define THINKGEAR_ROWS_KINDS           10
+
+/**
+ * Link health counters kept by each parser.  Byte counts can be turned
+ * into time with the baud rate (57600 baud is 5760 bytes per second).
+ */
+typedef struct _ThinkGearParserStats {
+
+    uint32_t        bytesIn;          /* Bytes fed to the parser */
+    uint32_t        packetsOk;        /* Packets that passed their checksum */
+    uint32_t        checksumFailures;
+    uint32_t        oversizeLength;   /* Packets rejected for PLENGTH >= 170 */
+    uint32_t        syncSkipped;      /* Bytes discarded hunting for SYNC */
+    uint32_t        resyncs;          /* Failed Packets that held a header */
+    uint32_t        packetsRecovered; /* Valid Packets found by rescanning */
+    uint32_t        rows[THINKGEAR_ROWS_KINDS];
+    uint32_t        rawSamples;       /* Samples in all raw DataRows */
+
+    /* Most bytes seen between the end of one valid Packet and the start
+     * of the next; 0 on a clean link */
+    uint32_t        maxGapBytes;
+    uint32_t        gapBytes;         /* Bytes since the last valid Packet */
+
+} ThinkGearParserStats;
+
+/**
+ * The decoded contents of one Packet.  The @c present bitmask tells which
+ * fields were carried by the most recent Packet; fields whose bit is clear
+ * still hold the last value that was received for them.
+ */
+typedef struct _ThinkGearFrame {
+
+    uint16_t        present;
+
+    uint8_t         battery;
+    uint8_t         poorSignal;
+    uint8_t         attention;
+    uint8_t         meditation;
+    uint8_t         blinkStrength;
+    uint8_t         dongleStatus;     /* One of the 0xD0-0xD4 CODEs */
+
+    uint8_t         numRaw;           /* Raw samples this Packet carried */
+    int16_t         raw[THINKGEAR_FRAME_MAX_RAW];
+
+    /* 24-bit band powers: delta, theta, low/high alpha, low/high beta,
+     * low/mid gamma */
+    uint32_t        eegPower[THINKGEAR_EEG_BANDS];
+
+} ThinkGearFrame;
+
 /**
  * The Parser is a state machine that manages the parsing state.
  */
@@ -76,6 +162,19 @@ typedef struct _ThinkGearStreamParser {
                              const unsigned char *value, void *customData );
     void  *customData;
 
+    ThinkGearFrame *frame;
+    void (*handleFrame)( const ThinkGearFrame *frame, void *customData );
+
+    unsigned char   resync;           /* Rescan failed Packets for a header */
+    unsigned char   replaying;
+    unsigned char   recovering;
+
+    ThinkGearParserStats stats;
+
+    int16_t        *rawRing;          /* See THINKGEAR_setRawRing() */
+    uint16_t        rawRingMask;
+    uint16_t        rawRingHead;      /* Samples written so far, wrapping */
+
 } ThinkGearStreamParser;
 
 /**
@@ -102,6 +201,101 @@ THINKGEAR_initParser( ThinkGearStreamParser *parser, unsigned char parserType,
                           const unsigned char *value, void *customData),
                       void *customData );
 
+/**
+ * Initializes a Packet @c parser that decodes each Packet into @c frame
+ * and then calls @c handleFrameFunc once, instead of calling a handler for
+ * every DataRow.  DataRows the decoder does not recognize (including all
+ * extended CODEs) are still passed to @c handleDataValueFunc, if given.
+ *
+ * @param parser              Pointer to a ThinkGearStreamParser object.
+ * @param frame               Caller-owned storage for the decoded Packet.
+ * @param handleFrameFunc     Called after each valid Packet is decoded.
+ * @param handleDataValueFunc Called for undecoded DataRows.  May be NULL.
+ * @param customData          Passed to both callbacks.
+ *
+ * @return -1 if @c parser is NULL.
+ * @return -3 if @c frame is NULL.
+ * @return 0 on success.
+ */
+int
+THINKGEAR_initFrameParser( ThinkGearStreamParser *parser,
+                           ThinkGearFrame *frame,
+                           void (*handleFrameFunc)(
+                               const ThinkGearFrame *frame,
+                               void *customData),
+                           void (*handleDataValueFunc)(
+                               unsigned char extendedCodeLevel,
+                               unsigned char code, unsigned char numBytes,
+                               const unsigned char *value, void *customData),
+                           void *customData );
+
+/**
+ * Enables or disables resynchronization after checksum failures.  When
+ * enabled, the bytes of a Packet that failed its checksum are rescanned
+ * for an embedded pair of SyncBytes, and parsing resumes from there rather
+ * than from the next byte on the stream.  The @c resyncs and
+ * @c packetsRecovered counters (see THINKGEAR_getStats()) tell how often
+ * this found a header and how many valid Packets it recovered.
+ * Recovered Packets reach handleDataValue() during the THINKGEAR_parseByte()
+ * call that saw the checksum fail, which still returns -2 for the failed
+ * one; THINKGEAR_parseBuffer() does count them in its return value.
+ *
+ * @param parser Pointer to an initialized ThinkGearStreamParser object.
+ * @param enable Non-zero to enable resynchronization.
+ *
+ * @return -1 if @c parser is NULL.
+ * @return 0 on success.
+ */
+int
+THINKGEAR_setResync( ThinkGearStreamParser *parser, unsigned char enable );
+
+/**
+ * Makes the @c parser decode each 16-bit raw sample straight into a
+ * caller-owned circular buffer of @c size samples.  Sample n of the
+ * stream goes to ring[n & (size-1)]; the @c rawRingHead field of the
+ * @c parser counts samples written so far (modulo 65536), so the newest
+ * sample is at ring[(rawRingHead-1) & (size-1)].  Frame parsers still
+ * copy the samples of each Packet into ThinkGearFrame.raw[] as well.
+ *
+ * A PARSER_CODE_RAW_SIGNAL DataRow may carry any even number of bytes,
+ * one big-endian sample per pair, whether or not a ring is set.  Rows of
+ * odd length are handed to the handleDataValueFunc() undecoded.
+ *
+ * @param parser Pointer to an initialized ThinkGearStreamParser object.
+ * @param ring   The buffer, or NULL to stop writing samples to a ring.
+ * @param size   Length of @c ring in samples; must be a power of two.
+ *
+ * @return -1 if @c parser is NULL.
+ * @return -2 if @c size is not a power of two.
+ * @return 0 on success.
+ */
+int
+THINKGEAR_setRawRing( ThinkGearStreamParser *parser, int16_t *ring,
+                      uint16_t size );
+
+/**
+ * Copies the @c parser's link health counters into @c stats.  The
+ * counters are kept inside the parser itself, so this never allocates.
+ *
+ * @param parser Pointer to an initialized ThinkGearStreamParser object.
+ * @param stats  Receives the snapshot.
+ *
+ * @return -1 if @c parser or @c stats is NULL.
+ * @return 0 on success.
+ */
+int
+THINKGEAR_getStats( const ThinkGearStreamParser *parser,
+                    ThinkGearParserStats *stats );
+
+/**
+ * Zeroes the @c parser's link health counters.
+ *
+ * @return -1 if @c parser is NULL.
+ * @return 0 on success.
+ */
+int
+THINKGEAR_resetStats( ThinkGearStreamParser *parser );
+
 /**
  * This is merely an example function prototype for a handleDataValueFunc()
  * callback function to be passed to THINKGEAR_initParser().  The user is
@@ -149,6 +343,25 @@ exampleHandleDataValueFunc( unsigned char extendedCodeLevel,
 signed char
 THINKGEAR_parseByte( ThinkGearStreamParser *parser, unsigned char byte );
 
+/**
+ * Feeds @c length bytes from @c buffer into the @c parser, exactly as if
+ * each byte had been passed to THINKGEAR_parseByte() in turn, but skipping
+ * over noise between Packets and copying each Payload[] in bulk.  Use this
+ * whenever bytes arrive in chunks (e.g. from read()).
+ *
+ * @param parser Pointer to an initialized ThinkGearDataParser object.
+ * @param buffer The next @c length bytes of the data stream.
+ * @param length Number of bytes in @c buffer.
+ *
+ * @return -1 if @c parser is NULL.
+ * @return The number of Packets received and parsed successfully,
+ *         including any recovered by resynchronization; that is, how much
+ *         the @c packetsOk counter went up.
+ */
+int
+THINKGEAR_parseBuffer( ThinkGearStreamParser *parser,
+                       const unsigned char *buffer, size_t length );
+
 
 #ifdef __cplusplus
 }  /* extern "C" */
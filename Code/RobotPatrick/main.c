@@ -15,11 +15,14 @@
 #include "serial.h"
 #include "utility.h"
 #include "ThinkGearStreamParser.h"
+#include "ring.h"
 #include <util/atomic.h>
 #include <stdio.h>
 
 #define DRIVE_POWER 30
 #define SPIN_POWER 50
+// Send the parser health counters once every this many loop cycles.
+#define STATS_PERIOD 8
 
 volatile u08 batteryLevel;
 volatile u08 poorSignal;
@@ -28,31 +31,45 @@ volatile u08 meditation;
 volatile u16 samples;
 
 //! Circular buffer containing the latest EEG data received.
-volatile s16 rawData[FFT_N];
-
-//! Index of circular buffer's head element.
-volatile u16 rawHead = 0;
+//! The parser decodes raw samples straight into it; sample n is at rawData[n % FFT_N].
+s16 rawData[FFT_N];
 
 ThinkGearStreamParser parser;
 
+//! The most recently decoded ThinkGear packet.
+ThinkGearFrame frame;
+
+//! Bytes received from the headset, waiting to be parsed by the main loop.
+Ring rxRing;
+
+//! Number of bytes the UART itself lost because USART1_RX_vect was not serviced in time.
+volatile u16 rxOverruns = 0;
+
 // Local prototypes.
 static void connectHeadset();
+static void drainHeadset();
 void runFFT();
 static void spin(u08 speed);
 static void drive(u08 speed);
 static void stop();
 static void uart0TransmitString(const char * const string);
 static void uart0TransmitPString(PGM_P const string);
+static void sendParserStats();
 
+void handleFrameFunc(const ThinkGearFrame *frame, void *customData);
 void handleDataValueFunc(unsigned char extendedCodeLevel, unsigned char code,
     unsigned char valueLength, const unsigned char *value,
     void *customData);
 
 //! Interrupt Service Routine that receives data on UART1 from the MindWave headset.
+//! Bytes are only queued here; drainHeadset() parses them from the main loop.
 ISR(USART1_RX_vect)
 {
-  u08 data = UDR1;
-  THINKGEAR_parseByte(&parser, data);
+  if (UCSR1A & (1 << DOR1))
+  {
+    rxOverruns++;
+  }
+  ringPut(&rxRing, UDR1);
 }
 
 //! Initializes XiphosLibrary and runs main loop.
@@ -62,7 +79,11 @@ int main()
   initialize();
 
   // Initialize ThinkGear parser.
-  THINKGEAR_initParser(&parser, PARSER_TYPE_PACKETS, handleDataValueFunc, NULL);
+  THINKGEAR_initFrameParser(&parser, &frame, handleFrameFunc, handleDataValueFunc, NULL);
+  // Recover packets whose header was swallowed by a corrupt packet.
+  THINKGEAR_setResync(&parser, 1);
+  // Decode raw samples, however many each packet carries, into the FFT ring.
+  THINKGEAR_setRawRing(&parser, rawData, FFT_N);
 
   // Initialize UARTs.
   uart0Init();
@@ -76,11 +97,16 @@ int main()
   // Super loop.
   u16 cycles = 0;
   u16 samplesCopy;
+  u16 overflowsCopy;
+  u16 overrunsCopy;
   char str[10];
   
     
 while (1)
   {
+    // Parse everything received since the last pass.
+    drainHeadset();
+
     // Print 4 individual values across the top line.
     upperLine();
     print_u08(attention);
@@ -91,11 +117,13 @@ while (1)
     printChar(' ');
     print_u08(batteryLevel);
 
-    // Disable interrupts momentarily and make a contiguous copy of the circular buffer.
-    ATOMIC_BLOCK(ATOMIC_FORCEON)
-        {
+    // Make a contiguous copy of the circular buffer. The parser runs from the main loop,
+    // so nothing can modify the buffer while it is being copied.
+    {
       u16 i = 0;
       u16 r;
+      // Index of circular buffer's head element (oldest sample).
+      u16 rawHead = parser.rawRingHead & (FFT_N - 1);
       for (r = rawHead; r < FFT_N; r++)
       {
         // Put real data into even bins.
@@ -111,10 +139,16 @@ while (1)
         fft_input[i++] = 0;
       }
 
-      // Also copy the samples variable while we have interrupts disabled.
       samplesCopy = samples;
     }
 
+    // The 16-bit counters are written by the ISR, so read them with interrupts disabled.
+    ATOMIC_BLOCK(ATOMIC_FORCEON)
+    {
+      overflowsCopy = rxRing.overflows;
+      overrunsCopy = rxOverruns;
+    }
+
     // Run FFT on the contiguous copy.
     runFFT();
 
@@ -138,6 +172,21 @@ while (1)
     }
     uart0TransmitPString(PSTR("];\r\n"));
 
+    // Send receive overflow counters to PC.
+    sprintf(str, "%u", overflowsCopy);
+    uart0TransmitPString(PSTR("rx_overflows="));
+    uart0TransmitString(str);
+    sprintf(str, "%u", overrunsCopy);
+    uart0TransmitPString(PSTR(" rx_overruns="));
+    uart0TransmitString(str);
+    uart0TransmitPString(PSTR(";\r\n"));
+
+    // Send parser health counters to PC every few cycles.
+    if (cycles % STATS_PERIOD == 0)
+    {
+      sendParserStats();
+    }
+
     // TODO Do something useful with the spectrum output fft_lin_out.
 
     // Control motors based on MindWave headset readings.
@@ -171,6 +220,19 @@ void runFFT()
   fft_mag_lin(); // take the linear output of the fft
 }
 
+//! Runs the parser over everything the ISR has queued so far.
+static void drainHeadset()
+{
+  const u08 *bytes;
+  u08 n;
+
+  while ((n = ringPeek(&rxRing, &bytes)) != 0)
+  {
+    THINKGEAR_parseBuffer(&parser, bytes, n);
+    ringConsume(&rxRing, n);
+  }
+}
+
 static void uart0TransmitString(const char * const string)
 {
   u08 i = 0;
@@ -181,6 +243,8 @@ static void uart0TransmitString(const char * const string)
     uart0Transmit(ch);
     i++;
   }
+  // Sending the FFT dump takes far longer than the ring can buffer, so keep parsing between strings.
+  drainHeadset();
 }
 
 static void uart0TransmitPString(PGM_P const string)
@@ -195,6 +259,43 @@ static void uart0TransmitPString(PGM_P const string)
   }
 }
 
+//! Sends the parser's link health counters as one line:
+//! tg_stats=[ bytesIn packetsOk checksumFailures oversizeLength syncSkipped
+//! resyncs packetsRecovered maxGapBytes rows[0] ... rows[THINKGEAR_ROWS_KINDS-1] ];
+static void sendParserStats()
+{
+  ThinkGearParserStats stats;
+  char str[12];
+  u08 i;
+
+  // The parser only runs from the main loop, so the copy is consistent.
+  THINKGEAR_getStats(&parser, &stats);
+
+  uart0TransmitPString(PSTR("tg_stats=[ "));
+  sprintf(str, "%lu ", (unsigned long)stats.bytesIn);
+  uart0TransmitString(str);
+  sprintf(str, "%lu ", (unsigned long)stats.packetsOk);
+  uart0TransmitString(str);
+  sprintf(str, "%lu ", (unsigned long)stats.checksumFailures);
+  uart0TransmitString(str);
+  sprintf(str, "%lu ", (unsigned long)stats.oversizeLength);
+  uart0TransmitString(str);
+  sprintf(str, "%lu ", (unsigned long)stats.syncSkipped);
+  uart0TransmitString(str);
+  sprintf(str, "%lu ", (unsigned long)stats.resyncs);
+  uart0TransmitString(str);
+  sprintf(str, "%lu ", (unsigned long)stats.packetsRecovered);
+  uart0TransmitString(str);
+  sprintf(str, "%lu ", (unsigned long)stats.maxGapBytes);
+  uart0TransmitString(str);
+  for (i = 0; i < THINKGEAR_ROWS_KINDS; i++)
+  {
+    sprintf(str, "%lu ", (unsigned long)stats.rows[i]);
+    uart0TransmitString(str);
+  }
+  uart0TransmitPString(PSTR("];\r\n"));
+}
+
 inline static void spin(u08 speed)
 {
   motor0(127 + speed);
@@ -228,66 +329,42 @@ static void connectHeadset()
   uart1Transmit(0xC2);
 }
 
+//! Called once per ThinkGear packet with all of its decoded values.
+void handleFrameFunc(const ThinkGearFrame *frame, void *customData)
+{
+  // 16-bit RAW wave values are already in rawData; just count them.
+  samples += frame->numRaw;
+
+  // BATTERY Level
+  if (frame->present & THINKGEAR_FRAME_BATTERY)
+  {
+    batteryLevel = frame->battery;
+  }
+
+  // POOR_SIGNAL Quality
+  if (frame->present & THINKGEAR_FRAME_POOR_SIGNAL)
+  {
+    poorSignal = frame->poorSignal;
+  }
+
+  // ATTENTION eSense
+  if (frame->present & THINKGEAR_FRAME_ATTENTION)
+  {
+    attention = frame->attention;
+  }
+
+  // MEDITATION eSense
+  if (frame->present & THINKGEAR_FRAME_MEDITATION)
+  {
+    meditation = frame->meditation;
+  }
+}
+
+//! Called for each data row the frame decoder does not recognize.
 void handleDataValueFunc(unsigned char extendedCodeLevel, unsigned char code,
     unsigned char valueLength, const unsigned char *value,
     void *customData)
 {
-  // Only process non-extended codes (extended codes are undocumented).
-  if (extendedCodeLevel == 0)
-  {
-    switch (code)
-    {
-      // 16-bit RAW wave value
-      case PARSER_CODE_RAW_SIGNAL:
-        // TODO: this if-statement block can be removed if it doesn't get triggered.
-        if (valueLength != 2)
-        {
-          // Code expects valueLength for RAW to always be 2.
-          // If headset can send multiple RAW values back-to-back,
-          // we need to change our code, so print an alert and halt program.
-          clearScreen();
-          printString_P(PSTR("raw>2!: "));
-          printPlain_u08(valueLength);
-          // Halt the program.
-          cli();
-          while (1)
-            ;
-        }
-
-        // Store this sample into the head element of the circular buffer.
-        rawData[rawHead] = (value[0] << 8) | value[1];
-        // Increment head to the next slot, wrapping around when needed.
-        rawHead++;
-        if (rawHead >= FFT_N)
-        {
-          rawHead = 0;
-        }
-        samples++;
-        break;
-
-        // BATTERY Level
-      case PARSER_CODE_BATTERY:
-        batteryLevel = value[0];
-        break;
-
-        // POOR_SIGNAL Quality
-      case PARSER_CODE_POOR_QUALITY:
-        poorSignal = value[0];
-        break;
-
-        // ATTENTION eSense
-      case PARSER_CODE_ATTENTION:
-        attention = value[0];
-        break;
-
-        // MEDITATION eSense
-      case PARSER_CODE_MEDITATION:
-        meditation = value[0];
-        break;
-
-        // Ignore any other received codes.
-      default:
-        break;
-    }
-  }
+  // RAW rows with any even number of bytes are decoded by the parser, and the
+  // remaining codes are not used, so there is nothing to do here.
 }
@@ -0,0 +1,380 @@
+#include "ThinkGearArduinoFft.h"
+#include <string.h>
+
+namespace thinkgear {
+
+namespace {
+
+// The library's tables, straight from its .inc files
+const int16_t WK_16[] = {
+#include "../../ArduinoFFT/wklookup_16.inc"
+};
+const int16_t WK_32[] = {
+#include "../../ArduinoFFT/wklookup_32.inc"
+};
+const int16_t WK_64[] = {
+#include "../../ArduinoFFT/wklookup_64.inc"
+};
+const int16_t WK_128[] = {
+#include "../../ArduinoFFT/wklookup_128.inc"
+};
+const int16_t WK_256[] = {
+#include "../../ArduinoFFT/wklookup_256.inc"
+};
+
+const uint8_t REORDER_16[] = {
+#include "../../ArduinoFFT/16_reorder.inc"
+};
+const uint8_t REORDER_32[] = {
+#include "../../ArduinoFFT/32_reorder.inc"
+};
+const uint8_t REORDER_64[] = {
+#include "../../ArduinoFFT/64_reorder.inc"
+};
+const uint8_t REORDER_128[] = {
+#include "../../ArduinoFFT/128_reorder.inc"
+};
+const uint8_t REORDER_256[] = {
+#include "../../ArduinoFFT/256_reorder.inc"
+};
+
+const int16_t HANN_16[] = {
+#include "../../ArduinoFFT/hann_16.inc"
+};
+const int16_t HANN_32[] = {
+#include "../../ArduinoFFT/hann_32.inc"
+};
+const int16_t HANN_64[] = {
+#include "../../ArduinoFFT/hann_64.inc"
+};
+const int16_t HANN_128[] = {
+#include "../../ArduinoFFT/hann_128.inc"
+};
+const int16_t HANN_256[] = {
+#include "../../ArduinoFFT/hann_256.inc"
+};
+
+const uint8_t LOG_TABLE[] = {
+#include "../../ArduinoFFT/decibel.inc"
+};
+const uint8_t LIN_TABLE[] = {
+#include "../../ArduinoFFT/sqrtlookup16.inc"
+};
+const uint8_t LIN_TABLE8[] = {
+#include "../../ArduinoFFT/sqrtlookup8.inc"
+};
+
+#if defined(__GNUC__)
+typedef int32_t Lanes __attribute__((vector_size(THINKGEAR_ARDUINO_LANES * sizeof(int32_t))));
+typedef uint32_t ULanes __attribute__((vector_size(THINKGEAR_ARDUINO_LANES * sizeof(int32_t))));
+#else
+// One transform at a time
+typedef int32_t Lanes;
+typedef uint32_t ULanes;
+#endif
+
+const size_t LANES = sizeof(Lanes) / sizeof(int32_t);
+
+// 16-bit registers held in 32-bit lanes, always sign extended.  Products
+// are taken unsigned so they wrap at 32 bits like the AVR's.
+
+// add/adc, sub/sbc: keep the low 16 bits
+inline Lanes wrap(Lanes x){
+    return (Lanes)((ULanes)x << 16) >> 16;
+}
+
+// asr, ror: divide by 2 rounding down
+inline Lanes half(Lanes x){
+    return x >> 1;
+}
+
+// The high 16 bits of a 32-bit accumulator
+inline Lanes high(ULanes x){
+    return (Lanes)x >> 16;
+}
+
+inline ULanes product(Lanes a, int32_t c){
+    return (ULanes)a * (uint32_t)c;
+}
+
+// fmuls/fmul/fmulsu: the product shifted up a bit, high 16 bits
+inline Lanes fractional(Lanes a, int32_t c){
+    return high(product(a, c) << 1);
+}
+
+// The robot's Wk = (0,1) butterflies, stage 2 and the middle of each group
+inline void quarter(Lanes *top, Lanes *bottom){
+    Lanes a = half(top[0]), b = half(bottom[0]);
+    top[0] = a;
+    top[1] = b;
+    bottom[0] = a;
+    bottom[1] = wrap(-b);
+}
+
+// Wk = (1,0): the real parts only, the imaginary parts are left as they are
+inline void unity(Lanes *top, Lanes *bottom){
+    Lanes a = half(top[0]), b = half(bottom[0]);
+    top[0] = wrap(a + b);
+    bottom[0] = wrap(a - b);
+}
+
+// Top half plus and minus the already scaled bottom half
+inline void combine(Lanes *top, Lanes *bottom, Lanes re, Lanes im){
+    Lanes a = half(top[0]), b = half(top[1]);
+    top[0] = wrap(a + re);
+    top[1] = wrap(b + im);
+    bottom[0] = wrap(a - re);
+    bottom[1] = wrap(b - im);
+}
+
+// fft_run() on one batch, x[2*e] and x[2*e + 1] the parts of element e
+void butterflies(Lanes *x, size_t n, const int16_t *wk){
+    // First: pairs, all real
+    for (size_t e=0; e<n; e+=2)
+        unity(x + 2*e, x + 2*(e+1));
+
+    // Second: groups of 4, Wk = (1,0) and (0,1)
+    for (size_t g=0; g<n; g+=4){
+        unity(x + 2*g, x + 2*(g+2));
+        quarter(x + 2*(g+1), x + 2*(g+3));
+    }
+
+    // Third: groups of 8, adding before multiplying by +-0.707
+    const int32_t R2 = 0x5a82, MINUS_R2 = (int16_t)0xa57e;
+    for (size_t g=0; g<n; g+=8){
+        unity(x + 2*g, x + 2*(g+4));
+
+        Lanes *t = x + 2*(g+1), *b = x + 2*(g+5);
+        Lanes re = half(b[0]), im = half(b[1]);
+        combine(t, b, fractional(wrap(re - im), R2), fractional(wrap(im + re), R2));
+
+        quarter(x + 2*(g+2), x + 2*(g+6));
+
+        t = x + 2*(g+3);
+        b = x + 2*(g+7);
+        re = half(b[0]);
+        im = half(b[1]);
+        combine(t, b, fractional(wrap(re + im), MINUS_R2), fractional(wrap(re - im), R2));
+    }
+
+    // The rest: Wk from the table, which skips each group's first and
+    // middle butterflies and starts over for every group of a stage
+    for (size_t h=8; h<n; h*=2){
+        for (size_t g=0; g<n; g+=2*h){
+            const int16_t *w = wk;
+            unity(x + 2*g, x + 2*(g+h));
+            for (size_t j=1; j<h; ++j){
+                Lanes *t = x + 2*(g+j), *b = x + 2*(g+j+h);
+                if (j == h/2){
+                    quarter(t, b);
+                    continue;
+                }
+                int32_t c = w[0], s = w[1];
+                w += 2;
+                Lanes re = high(product(b[0], c) - product(b[1], s));
+                Lanes im = high(product(b[1], c) + product(b[0], s));
+                combine(t, b, re, im);
+            }
+        }
+        wk += 2 * (h - 2);
+    }
+}
+
+// re^2 + im^2, exact in 32 bits as the mag functions compute it
+inline uint32_t power(const int16_t *x){
+    return (uint32_t)((int32_t)x[0] * x[0]) + (uint32_t)((int32_t)x[1] * x[1]);
+}
+
+// fft_mag_log(): the top byte from an even shift indexes decibel.inc and
+// every 2 bits of shift take 16 off
+uint8_t logOf(uint32_t p){
+    uint8_t b3 = p >> 24, b2 = p >> 16, b1 = p >> 8, b0 = p;
+    int exponent;
+    uint16_t z;
+    if (b3){
+        exponent = 12;
+        z = b3 << 8 | b2;
+    } else if (b2){
+        exponent = 8;
+        z = b2 << 8 | b1;
+    } else if (b1){
+        exponent = 4;
+        z = b1 << 8 | b0;
+    } else {
+        return LOG_TABLE[b0];
+    }
+    while (z < 0x4000){
+        z = (uint16_t)(z << 2);
+        exponent--;
+    }
+    return (uint8_t)(LOG_TABLE[z >> 8] + (exponent << 4));
+}
+
+// fft_mag_lin(): sqrtlookup16.inc's four sections, shifted back up by the
+// exponent.  Above 0xffffff it normalizes by one step at most, as the
+// assembly does.
+uint16_t linOf(uint32_t p){
+    uint8_t b3 = p >> 24, b2 = p >> 16, b1 = p >> 8, b0 = p;
+    int exponent = 0;
+    size_t index;
+    if (b3){
+        exponent = 8;
+        uint16_t z = b3 << 8 | b2;
+        if (z < 0x4000){
+            z = (uint16_t)(z << 2 | b1 >> 6);
+            exponent--;
+        }
+        index = 0x200 + (z >> 8);
+    } else if (b2){
+        exponent = 4;
+        uint16_t z = b2 << 8 | b1;
+        uint8_t rest = b0;
+        while (z < 0x4000){
+            z = (uint16_t)(z << 2 | rest >> 6);
+            rest = (uint8_t)(rest << 2);
+            exponent--;
+        }
+        index = 0x200 + (z >> 8);
+    } else {
+        uint16_t z = b1 << 8 | b0;
+        if (z >= 0x4000)
+            index = 0x200 + (z >> 8);
+        else if (z >= 0x1000)
+            index = 0x100 + (0x80 | ((z >> 7) & 0xff));
+        else if (z >= 0x100)
+            index = 0x100 + (z >> 5);
+        else
+            index = z;
+    }
+    return (uint16_t)(LIN_TABLE[index] << exponent);
+}
+
+// fft_mag_lin8(): SCALE picks 16 bits of the power, sqrtlookup8.inc's
+// three sections (the last one wrapping over 0x7fff) make them 8
+uint8_t lin8Of(uint32_t p, unsigned scale){
+    uint16_t z = (uint16_t)((uint64_t)(p >> 8) * scale >> 8);
+    size_t index;
+    if (z >= 0x1000)
+        index = 0x180 + ((z >> 7) & 0xff);
+    else if (z >= 0x100)
+        index = 0x100 + (z >> 5);
+    else
+        index = z;
+    return LIN_TABLE8[index];
+}
+
+}  // namespace
+
+ArduinoFft::ArduinoFft()
+    : n(0), logN(0), wk(NULL), swaps(NULL), swapCount(0), hann(NULL) {
+}
+
+bool ArduinoFft::setup(size_t n){
+    // FFT_N, LOG_N and _R_V as in FFT.h
+    switch (n){
+    case 16:  logN = 4; wk = WK_16;  swaps = REORDER_16;  hann = HANN_16;  swapCount = 8 - 2; break;
+    case 32:  logN = 5; wk = WK_32;  swaps = REORDER_32;  hann = HANN_32;  swapCount = 16 - 4; break;
+    case 64:  logN = 6; wk = WK_64;  swaps = REORDER_64;  hann = HANN_64;  swapCount = 32 - 4; break;
+    case 128: logN = 7; wk = WK_128; swaps = REORDER_128; hann = HANN_128; swapCount = 64 - 8; break;
+    case 256: logN = 8; wk = WK_256; swaps = REORDER_256; hann = HANN_256; swapCount = 128 - 8; break;
+    default:
+        return false;
+    }
+    this->n = n;
+    return true;
+}
+
+void ArduinoFft::load(const int16_t *samples, size_t hop, int16_t *input, size_t count) const {
+    for (size_t t=0; t<count; ++t){
+        const int16_t *s = samples + t*hop;
+        int16_t *x = input + t*2*n;
+        for (size_t i=0; i<n; ++i){
+            x[2*i] = s[i];
+            x[2*i + 1] = 0;
+        }
+    }
+}
+
+void ArduinoFft::window(int16_t *input, size_t count) const {
+    for (size_t t=0; t<count; ++t){
+        int16_t *x = input + t*2*n;
+        for (size_t i=0; i<n; ++i)
+            x[2*i] = (int16_t)((int32_t)((uint32_t)((int32_t)x[2*i] * hann[i]) << 1) >> 16);
+    }
+}
+
+void ArduinoFft::reorder(int16_t *input, size_t count) const {
+    for (size_t t=0; t<count; ++t){
+        int16_t *x = input + t*2*n;
+        for (size_t i=0; i<swapCount; ++i){
+            int16_t *a = x + 2*swaps[2*i], *b = x + 2*swaps[2*i + 1];
+            int16_t re = a[0], im = a[1];
+            a[0] = b[0];
+            a[1] = b[1];
+            b[0] = re;
+            b[1] = im;
+        }
+    }
+}
+
+void ArduinoFft::run(int16_t *input, size_t count) const {
+    if (!n)
+        return;
+    Lanes x[2 * 256];
+    int32_t row[LANES];
+    for (size_t done=0; done<count; done+=LANES){
+        size_t lanes = count - done < LANES ? count - done : LANES;
+        int16_t *batch = input + done*2*n;
+        // Transforms side by side, value by value
+        for (size_t i=0; i<2*n; ++i){
+            for (size_t l=0; l<LANES; ++l)
+                row[l] = l < lanes ? batch[l*2*n + i] : 0;
+            memcpy(&x[i], row, sizeof(row));
+        }
+        butterflies(x, n, wk);
+        for (size_t i=0; i<2*n; ++i){
+            memcpy(row, &x[i], sizeof(row));
+            for (size_t l=0; l<lanes; ++l)
+                batch[l*2*n + i] = (int16_t)row[l];
+        }
+    }
+}
+
+void ArduinoFft::magLog(const int16_t *input, uint8_t *out, size_t count) const {
+    for (size_t t=0; t<count; ++t)
+        for (size_t k=0; k<n/2; ++k)
+            *out++ = logOf(power(input + t*2*n + 2*k));
+}
+
+void ArduinoFft::magLin(const int16_t *input, uint16_t *out, size_t count) const {
+    for (size_t t=0; t<count; ++t)
+        for (size_t k=0; k<n/2; ++k)
+            *out++ = linOf(power(input + t*2*n + 2*k));
+}
+
+void ArduinoFft::magLin8(const int16_t *input, uint8_t *out, size_t count, unsigned scale) const {
+    for (size_t t=0; t<count; ++t)
+        for (size_t k=0; k<n/2; ++k)
+            *out++ = lin8Of(power(input + t*2*n + 2*k), scale);
+}
+
+void ArduinoFft::magOctave(const int16_t *input, uint8_t *out, size_t count, bool normalize) const {
+    for (size_t t=0; t<count; ++t){
+        const int16_t *x = input + t*2*n;
+        // Bins 0 and 1 alone, then doubling; summed in 40 bits
+        size_t k = 0;
+        for (size_t o=0; o<logN; ++o){
+            size_t bins = o == 0 ? 1 : (size_t)1 << (o - 1);
+            uint64_t sum = 0;
+            for (size_t i=0; i<bins; ++i, ++k)
+                sum += power(x + 2*k);
+            sum &= 0xffffffffffull;
+            if (normalize)
+                for (size_t b=bins; b>1; b>>=1)
+                    sum >>= 1;
+            *out++ = logOf((uint32_t)sum);
+        }
+    }
+}
+
+}  // namespace thinkgear
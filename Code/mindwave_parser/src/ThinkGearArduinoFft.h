@@ -0,0 +1,96 @@
+#ifndef THINKGEAR_ARDUINO_FFT_H_
+#define THINKGEAR_ARDUINO_FFT_H_
+
+/**
+ * @file ThinkGearArduinoFft.h
+ *
+ * A bit-exact host model of the ArduinoFFT library (Code/ArduinoFFT/FFT.h)
+ * that the robot firmware runs on raw samples, so what the robot saw can
+ * be worked out again on a PC from the same samples.
+ *
+ * FFT.h is AVR assembly only.  This reproduces its 16-bit fixed point
+ * arithmetic step for step: every butterfly halves its inputs, products
+ * keep the high 16 bits of the exact 32-bit result (the fmul stages and
+ * fft_window() one bit further up), sums wrap at 16 bits, and the first
+ * and middle butterflies of a group only touch what the assembly touches.
+ * The twiddle, reorder, Hann, square root and decibel tables are the
+ * library's own .inc files, compiled in from Code/ArduinoFFT.
+ * tests/arduinofft.cpp checks all of it against an emulator of the
+ * assembly.
+ *
+ * Data is laid out like fft_input: 2 * n values per transform, real and
+ * imaginary interleaved, and every call takes a batch of transforms back
+ * to back.  run() transforms THINKGEAR_ARDUINO_LANES of them side by side,
+ * one vector instruction per butterfly step.
+ *
+ *     thinkgear::ArduinoFft fft;
+ *     fft.setup(128);                         // FFT_N 128
+ *     fft.load(samples, 32, input, count);    // a transform every 32 samples
+ *     fft.window(input, count);               // as the robot's runFFT()
+ *     fft.reorder(input, count);
+ *     fft.run(input, count);
+ *     fft.magLin(input, lin, count);          // 64 values per transform
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Transforms run side by side by run()
+#define THINKGEAR_ARDUINO_LANES 4
+
+namespace thinkgear {
+
+class ArduinoFft {
+public:
+    ArduinoFft();
+
+    /** Uses the tables for FFT_N @c n: 16, 32, 64, 128 or 256.  False otherwise. */
+    bool setup(size_t n);
+    bool isSetup() const { return n != 0; }
+    /** FFT_N */
+    size_t getSize() const { return n; }
+    /** LOG_N, the values per transform of magOctave() */
+    size_t getOctaves() const { return logN; }
+
+    /**
+     * Fills @c count transforms of @c input the way the sketches do:
+     * transform t gets samples[t * hop] onwards as its real parts and
+     * zero imaginary parts.
+     */
+    void load(const int16_t *samples, size_t hop, int16_t *input, size_t count) const;
+
+    /** fft_window(): the real parts times hann_N.inc (WINDOW 1) */
+    void window(int16_t *input, size_t count) const;
+    /** fft_reorder(): bit-reversed order via N_reorder.inc */
+    void reorder(int16_t *input, size_t count) const;
+    /** fft_run(): the butterflies, in place */
+    void run(int16_t *input, size_t count) const;
+
+    /** fft_mag_log(): 16 * log2 of each magnitude, n / 2 per transform */
+    void magLog(const int16_t *input, uint8_t *out, size_t count) const;
+    /** fft_mag_lin(): the magnitudes, n / 2 per transform */
+    void magLin(const int16_t *input, uint16_t *out, size_t count) const;
+    /**
+     * fft_mag_lin8() built with SCALE @c scale (1 to 256): the magnitudes
+     * stretched to 8 bits, n / 2 per transform
+     */
+    void magLin8(const int16_t *input, uint8_t *out, size_t count, unsigned scale = 1) const;
+    /**
+     * fft_mag_octave(), normalized like OCT_NORM 1 unless told otherwise:
+     * the log of the power in bins 0, 1, 2-3, 4-7 and so on, LOG_N per
+     * transform
+     */
+    void magOctave(const int16_t *input, uint8_t *out, size_t count, bool normalize = true) const;
+
+private:
+    size_t n;
+    size_t logN;
+    const int16_t *wk;          // _wk_constants: cos, sin pairs
+    const uint8_t *swaps;       // _reorder_table: source, destination pairs
+    size_t swapCount;
+    const int16_t *hann;        // _window_func
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_ARDUINO_FFT_H_ */
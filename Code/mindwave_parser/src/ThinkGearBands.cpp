@@ -0,0 +1,135 @@
+#include "ThinkGearBands.h"
+#include "ThinkGearSpectrum.h"
+#include <math.h>
+#include <algorithm>
+
+namespace thinkgear {
+
+const float BAND_LIMITS[THINKGEAR_EEG_BANDS][2] = {
+    { 0.5f, 2.75f },    // delta
+    { 3.5f, 6.75f },    // theta
+    { 7.5f, 9.25f },    // low alpha
+    { 10.0f, 11.75f },  // high alpha
+    { 13.0f, 16.75f },  // low beta
+    { 18.0f, 29.75f },  // high beta
+    { 31.0f, 39.75f },  // low gamma
+    { 41.0f, 49.75f }   // mid gamma
+};
+
+BandBank::BandBank()
+    : window(0), hop(0), fed(0), nextIndex(0), sinceUpdate(0), updates(0), end(0) {
+    for (int b=0; b<THINKGEAR_EEG_BANDS; ++b)
+        powers[b] = 0;
+}
+
+bool BandBank::setup(size_t hop, size_t window){
+    if (window < 256 || window > 4096 || (window & (window-1)) || hop == 0)
+        return false;
+    this->window = window;
+    this->hop = hop;
+    history.assign(window, 0.0f);
+
+    // The bins whose centre lies in each band, at least the nearest one
+    float binHz = (float)THINKGEAR_RAW_RATE / window;
+    std::vector<int> wanted[THINKGEAR_EEG_BANDS];
+    std::vector<int> all;
+    for (int b=0; b<THINKGEAR_EEG_BANDS; ++b){
+        int lo = (int)ceilf(BAND_LIMITS[b][0] / binHz);
+        int hi = (int)floorf(BAND_LIMITS[b][1] / binHz);
+        if (lo > hi)
+            lo = hi = (int)floorf((BAND_LIMITS[b][0] + BAND_LIMITS[b][1]) / 2 / binHz + 0.5f);
+        if (lo < 1)
+            lo = 1;
+        for (int k=lo; k<=hi; ++k){
+            wanted[b].push_back(k);
+            // The Hann window is applied afterwards from the neighbours
+            all.push_back(k-1);
+            all.push_back(k);
+            all.push_back(k+1);
+        }
+    }
+    std::sort(all.begin(), all.end());
+    all.erase(std::unique(all.begin(), all.end()), all.end());
+    bins = all;
+
+    re.assign(bins.size(), 0.0);
+    im.assign(bins.size(), 0.0);
+    twiddleRe.resize(bins.size());
+    twiddleIm.resize(bins.size());
+    for (size_t i=0; i<bins.size(); ++i){
+        double a = 2 * M_PI * bins[i] / window;
+        twiddleRe[i] = cos(a);
+        twiddleIm[i] = sin(a);
+    }
+    bandBins.clear();
+    for (int b=0; b<THINKGEAR_EEG_BANDS; ++b){
+        for (size_t j=0; j<wanted[b].size(); ++j){
+            int k = wanted[b][j];
+            BandBin bb;
+            bb.band = b;
+            bb.below = std::lower_bound(bins.begin(), bins.end(), k-1) - bins.begin();
+            bb.at = bb.below + 1;
+            bb.above = bb.below + 2;
+            bandBins.push_back(bb);
+        }
+    }
+    updates = 0;
+    reset();
+    return true;
+}
+
+void BandBank::reset(){
+    std::fill(history.begin(), history.end(), 0.0f);
+    std::fill(re.begin(), re.end(), 0.0);
+    std::fill(im.begin(), im.end(), 0.0);
+    fed = 0;
+    sinceUpdate = 0;
+}
+
+size_t BandBank::feed(const int16_t *samples, size_t count){
+    if (!window)
+        return 0;
+    uint64_t before = updates;
+    size_t n = bins.size();
+    double *xr = &re[0], *xi = &im[0];
+    const double *wr = &twiddleRe[0], *wi = &twiddleIm[0];
+    for (size_t s=0; s<count; ++s){
+        // X[k] = (X[k] + new - oldest) e^(2 pi i k / window) keeps X the DFT
+        // of the last window samples, the oldest at index 0
+        float &slot = history[fed & (window-1)];
+        double delta = (double)samples[s] - slot;
+        slot = samples[s];
+        for (size_t i=0; i<n; ++i){
+            double r = xr[i] + delta;
+            double m = xi[i];
+            xr[i] = r*wr[i] - m*wi[i];
+            xi[i] = r*wi[i] + m*wr[i];
+        }
+        ++fed;
+        ++nextIndex;
+        if (++sinceUpdate >= hop && fed >= window){
+            sinceUpdate = 0;
+            update();
+        }
+    }
+    return (size_t)(updates - before);
+}
+
+// Sums the Hann-windowed power of each band's bins
+void BandBank::update(){
+    double sums[THINKGEAR_EEG_BANDS] = { 0 };
+    // Amplitude scale of a Hann window of this length
+    double scale = 4.0 / window;
+    for (size_t j=0; j<bandBins.size(); ++j){
+        const BandBin& bb = bandBins[j];
+        double r = 0.5*re[bb.at] - 0.25*(re[bb.below] + re[bb.above]);
+        double i = 0.5*im[bb.at] - 0.25*(im[bb.below] + im[bb.above]);
+        sums[bb.band] += (r*r + i*i) * scale * scale;
+    }
+    for (int b=0; b<THINKGEAR_EEG_BANDS; ++b)
+        powers[b] = sums[b] < 4294967295.0 ? (uint32_t)(sums[b] + 0.5) : 0xFFFFFFFFu;
+    end = nextIndex;
+    ++updates;
+}
+
+}  // namespace thinkgear
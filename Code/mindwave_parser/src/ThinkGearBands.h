@@ -0,0 +1,108 @@
+#ifndef THINKGEAR_BANDS_H_
+#define THINKGEAR_BANDS_H_
+
+/**
+ * @file ThinkGearBands.h
+ *
+ * The eight ThinkGear EEG bands (delta through mid-gamma, as in the 0x83
+ * packet) computed on the host from raw samples, as often as wanted
+ * instead of once a second.
+ *
+ *     thinkgear::BandBank bands;
+ *     bands.setup(32);                // 16 updates a second
+ *     if (bands.feed(history.raw))
+ *         eeg.feed(bands.getPowers());
+ *
+ * A sliding DFT over the last @c window samples keeps only the bins the
+ * bands need, about 50 of 256 for the default 1 s window, each updated
+ * with one complex multiply per sample.  An update then only sums a few
+ * Hann-windowed bins per band, so its rate costs almost nothing.
+ *
+ * The powers are in raw units squared (a sine of amplitude A adds about
+ * A*A to its band), not the headset's own scale; compare them with each
+ * other, not with 0x83 values.
+ */
+
+#include "ThinkGearHistory.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace thinkgear {
+
+/** Lowest and highest frequency of each band, in Hz, in 0x83 order */
+extern const float BAND_LIMITS[THINKGEAR_EEG_BANDS][2];
+
+class BandBank {
+public:
+    BandBank();
+
+    /**
+     * Updates the powers every @c hop samples (32 is 16 times a second)
+     * from the last @c window samples, a power of two from 256 to 4096.
+     * Returns false for anything else.  Starts over if called again.
+     */
+    bool setup(size_t hop = 32, size_t window = 512);
+    bool isSetup() const { return window != 0; }
+
+    /** Forgets the samples fed so far; the last powers stay. */
+    void reset();
+
+    /** Adds consecutive raw samples; returns the number of updates. */
+    size_t feed(const int16_t *samples, size_t count);
+
+    /** Adds whatever @c ring has gained since the last call, like Stft::feed() */
+    template <size_t N>
+    size_t feed(const HistoryRing<int16_t, N>& ring){
+        typename HistoryRing<int16_t, N>::Span s = ring.since(nextIndex);
+        if (s.start != nextIndex)
+            reset();
+        nextIndex = s.start;
+        size_t before = (size_t)updates;
+        feed(s.first, s.firstCount);
+        feed(s.second, s.secondCount);
+        if (!ring.isIntact(s)){
+            reset();
+            nextIndex = ring.getWritten();
+        }
+        return (size_t)updates - before;
+    }
+
+    /** Power of each band as of the last update, THINKGEAR_EEG_BANDS values */
+    const uint32_t *getPowers() const { return powers; }
+    /** Updates so far */
+    uint64_t getUpdates() const { return updates; }
+    /** Stream index just past the last sample of the last update */
+    uint64_t getEnd() const { return end; }
+    /** DFT bins tracked per sample */
+    size_t getBinCount() const { return bins.size(); }
+
+private:
+    void update();
+
+    size_t window;
+    size_t hop;
+
+    std::vector<float> history;         // last window samples, circular
+    // Tracked bins, structure of arrays so the per-sample loop vectorizes
+    std::vector<int> bins;
+    std::vector<double> re, im;         // running DFT of the last window samples
+    std::vector<double> twiddleRe, twiddleIm;   // e^(2 pi i k / window)
+    // Each band's bins, as positions in bins[] of the bin and its two neighbours
+    struct BandBin {
+        int band;
+        size_t below, at, above;
+    };
+    std::vector<BandBin> bandBins;
+
+    uint64_t fed;
+    uint64_t nextIndex;
+    size_t sinceUpdate;
+    uint64_t updates;
+    uint64_t end;
+    uint32_t powers[THINKGEAR_EEG_BANDS];
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_BANDS_H_ */
@@ -0,0 +1,266 @@
+#include "ThinkGearCapture.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace thinkgear {
+
+namespace {
+
+void put16(unsigned char *p, uint16_t v){
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+void put32(unsigned char *p, uint32_t v){
+    for (int i=0; i<4; ++i)
+        p[i] = (unsigned char)(v >> (8*i));
+}
+
+void put64(unsigned char *p, uint64_t v){
+    for (int i=0; i<8; ++i)
+        p[i] = (unsigned char)(v >> (8*i));
+}
+
+uint16_t get16(const unsigned char *p){
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t get32(const unsigned char *p){
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint64_t get64(const unsigned char *p){
+    return (uint64_t)get32(p) | ((uint64_t)get32(p+4) << 32);
+}
+
+void putVarint(std::vector<unsigned char>& out, uint64_t v){
+    while (v >= 0x80){
+        out.push_back((unsigned char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((unsigned char)v);
+}
+
+bool getVarint(const unsigned char *&p, const unsigned char *end, uint64_t& v){
+    v = 0;
+    for (int shift=0; p < end && shift < 64; shift += 7){
+        unsigned char b = *p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// Two varints of at most 10 bytes each
+const size_t MAX_READ_ENTRY = 20;
+
+}  // namespace
+
+CaptureReadIterator::CaptureReadIterator(const CaptureChunk& chunk)
+    : p(chunk.times), end(chunk.times + chunk.timeBytes), micros(chunk.baseMicros) {
+}
+
+bool CaptureReadIterator::next(uint64_t& readMicros, size_t& length){
+    uint64_t delta, n;
+    if (p >= end || !getVarint(p, end, delta) || !getVarint(p, end, n))
+        return false;
+    micros += delta;
+    readMicros = micros;
+    length = (size_t)n;
+    return true;
+}
+
+CaptureWriter::CaptureWriter() : file(NULL), chunkBase(0), lastMicros(0), reads(0) {
+}
+
+CaptureWriter::~CaptureWriter(){
+    close();
+}
+
+bool CaptureWriter::open(const char *path, uint32_t baud){
+    close();
+    file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    start = std::chrono::steady_clock::now();
+    uint64_t wall = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    unsigned char h[THINKGEAR_CAPTURE_HEADER_SIZE];
+    memset(h, 0, sizeof(h));
+    memcpy(h, "TGCP", 4);
+    put16(h+4, THINKGEAR_CAPTURE_VERSION);
+    put16(h+6, THINKGEAR_CAPTURE_HEADER_SIZE);
+    put32(h+8, baud);
+    put64(h+16, wall);
+    if (fwrite(h, sizeof(h), 1, file) != 1){
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+
+    times.clear();
+    times.reserve(CHUNK_READS * MAX_READ_ENTRY);
+    raw.clear();
+    raw.reserve(CHUNK_RAW_BYTES);
+    reads = 0;
+    chunkBase = 0;
+    lastMicros = 0;
+    return true;
+}
+
+void CaptureWriter::close(){
+    if (!file)
+        return;
+    flush();
+    fclose(file);
+    file = NULL;
+}
+
+bool CaptureWriter::append(const unsigned char *bytes, size_t n){
+    uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    return append(bytes, n, micros);
+}
+
+bool CaptureWriter::append(const unsigned char *bytes, size_t n, uint64_t micros){
+    if (!file)
+        return false;
+    // Times must not go backwards within the file
+    if (micros < lastMicros)
+        micros = lastMicros;
+
+    while (n > 0){
+        if (reads == CHUNK_READS || raw.size() == CHUNK_RAW_BYTES){
+            if (!flush())
+                return false;
+        }
+        if (reads == 0)
+            chunkBase = micros;
+
+        size_t room = CHUNK_RAW_BYTES - raw.size();
+        size_t take = n < room ? n : room;
+        putVarint(times, micros - (reads ? lastMicros : chunkBase));
+        putVarint(times, take);
+        raw.insert(raw.end(), bytes, bytes + take);
+        reads++;
+        lastMicros = micros;
+        bytes += take;
+        n -= take;
+    }
+    return true;
+}
+
+bool CaptureWriter::flush(){
+    if (!file)
+        return false;
+    if (reads == 0)
+        return true;
+
+    unsigned char h[THINKGEAR_CAPTURE_CHUNK_SIZE];
+    memcpy(h, "TGCK", 4);
+    put32(h+4, reads);
+    put32(h+8, (uint32_t)times.size());
+    put32(h+12, (uint32_t)raw.size());
+    put64(h+16, chunkBase);
+    bool ok = fwrite(h, sizeof(h), 1, file) == 1 &&
+              fwrite(&times[0], times.size(), 1, file) == 1 &&
+              fwrite(&raw[0], raw.size(), 1, file) == 1;
+
+    times.clear();
+    raw.clear();
+    reads = 0;
+    return ok;
+}
+
+CaptureReader::CaptureReader()
+    : data(NULL), size(0), offset(0), firstChunk(0), truncated(false) {
+    memset(&header, 0, sizeof(header));
+}
+
+CaptureReader::~CaptureReader(){
+    close();
+}
+
+bool CaptureReader::open(const char *path){
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < THINKGEAR_CAPTURE_HEADER_SIZE){
+        ::close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    const unsigned char *p = static_cast<const unsigned char*>(map);
+    uint16_t headerSize = get16(p+6);
+    if (memcmp(p, "TGCP", 4) != 0 || get16(p+4) != THINKGEAR_CAPTURE_VERSION ||
+        headerSize < THINKGEAR_CAPTURE_HEADER_SIZE || headerSize > st.st_size){
+        munmap(map, (size_t)st.st_size);
+        return false;
+    }
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    data = p;
+    size = (size_t)st.st_size;
+    header.version = get16(p+4);
+    header.baud = get32(p+8);
+    header.startTime = get64(p+16);
+    firstChunk = headerSize;
+    rewind();
+    return true;
+}
+
+void CaptureReader::close(){
+    if (data)
+        munmap(const_cast<unsigned char*>(data), size);
+    data = NULL;
+    size = 0;
+    offset = 0;
+    truncated = false;
+}
+
+void CaptureReader::rewind(){
+    offset = firstChunk;
+    truncated = false;
+}
+
+bool CaptureReader::next(CaptureChunk& chunk){
+    if (!data || offset >= size)
+        return false;
+
+    size_t left = size - offset;
+    const unsigned char *p = data + offset;
+    if (left < THINKGEAR_CAPTURE_CHUNK_SIZE || memcmp(p, "TGCK", 4) != 0){
+        truncated = true;
+        return false;
+    }
+    uint64_t timeBytes = get32(p+8);
+    uint64_t rawBytes = get32(p+12);
+    if (THINKGEAR_CAPTURE_CHUNK_SIZE + timeBytes + rawBytes > left){
+        truncated = true;
+        return false;
+    }
+
+    chunk.reads = get32(p+4);
+    chunk.baseMicros = get64(p+16);
+    chunk.times = p + THINKGEAR_CAPTURE_CHUNK_SIZE;
+    chunk.timeBytes = (size_t)timeBytes;
+    chunk.bytes = chunk.times + timeBytes;
+    chunk.numBytes = (size_t)rawBytes;
+    offset += THINKGEAR_CAPTURE_CHUNK_SIZE + (size_t)(timeBytes + rawBytes);
+    return true;
+}
+
+}  // namespace thinkgear
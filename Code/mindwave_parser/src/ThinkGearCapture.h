@@ -0,0 +1,163 @@
+#ifndef THINKGEAR_CAPTURE_H_
+#define THINKGEAR_CAPTURE_H_
+
+/**
+ * @file ThinkGearCapture.h
+ *
+ * Recording and replay of a headset's raw serial byte stream.
+ *
+ * A capture file keeps every byte read from the serial port together with
+ * the time each read arrived, so a session can be fed back through
+ * ThinkGearStreamParser exactly as it was received.  All integers are
+ * little-endian.
+ *
+ * File header, 32 bytes:
+ *   0  char[4]  "TGCP"
+ *   4  uint16   version (THINKGEAR_CAPTURE_VERSION)
+ *   6  uint16   header size in bytes
+ *   8  uint32   baud rate of the serial port
+ *  12  uint32   reserved, 0
+ *  16  uint64   wall clock time the capture started, in us since 1970
+ *  24  uint64   reserved, 0
+ *
+ * Followed by any number of chunks, each with a 24 byte header:
+ *   0  char[4]  "TGCK"
+ *   4  uint32   reads: number of serial reads in the chunk
+ *   8  uint32   timeBytes: size of the read table
+ *  12  uint32   rawBytes: size of the raw bytes
+ *  16  uint64   base time of the chunk, in us since the capture started
+ *
+ * then the read table, one pair of LEB128 varints per read (arrival time
+ * minus the previous read's, the first one relative to the chunk base;
+ * and the number of bytes read), then the raw bytes of all reads back to
+ * back.  The raw bytes of a chunk are contiguous, so a replay can hand a
+ * whole chunk to THINKGEAR_parseBuffer() straight from a mapped file.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <chrono>
+
+#define THINKGEAR_CAPTURE_VERSION      1
+#define THINKGEAR_CAPTURE_HEADER_SIZE  32
+#define THINKGEAR_CAPTURE_CHUNK_SIZE   24
+
+namespace thinkgear {
+
+struct CaptureHeader {
+    uint16_t version;
+    uint32_t baud;
+    uint64_t startTime;     // us since 1970
+};
+
+/** One chunk of a mapped capture file; the pointers point into the map. */
+struct CaptureChunk {
+    uint64_t baseMicros;
+    uint32_t reads;
+    const unsigned char *times;
+    size_t timeBytes;
+    const unsigned char *bytes;
+    size_t numBytes;
+};
+
+/**
+ * Walks the read table of a CaptureChunk.
+ */
+class CaptureReadIterator {
+public:
+    explicit CaptureReadIterator(const CaptureChunk& chunk);
+
+    /**
+     * Gets the arrival time (us since the capture started) and length of
+     * the next read.  Returns false after the last read, or if the table
+     * is corrupt.
+     */
+    bool next(uint64_t& micros, size_t& length);
+
+private:
+    const unsigned char *p;
+    const unsigned char *end;
+    uint64_t micros;
+};
+
+/**
+ * Appends serial reads to a capture file.  Reads are collected into a
+ * chunk in memory and written out when the chunk is full, on flush() and
+ * on close(); append() does not allocate once the file is open.
+ */
+class CaptureWriter {
+public:
+    enum {
+        CHUNK_RAW_BYTES = 65536,    // raw bytes per chunk
+        CHUNK_READS = 4096          // reads per chunk
+    };
+
+    CaptureWriter();
+    ~CaptureWriter();
+
+    bool open(const char *path, uint32_t baud);
+    void close();
+    bool isOpen() const { return file != NULL; }
+
+    /** Records a read that arrived now. */
+    bool append(const unsigned char *bytes, size_t n);
+    /** Records a read that arrived @c micros us after open(). */
+    bool append(const unsigned char *bytes, size_t n, uint64_t micros);
+
+    /** Writes out the pending chunk, if any. */
+    bool flush();
+
+private:
+    CaptureWriter(const CaptureWriter&);
+    CaptureWriter& operator=(const CaptureWriter&);
+
+    FILE *file;
+    std::chrono::steady_clock::time_point start;
+    uint64_t chunkBase;
+    uint64_t lastMicros;
+    uint32_t reads;
+    std::vector<unsigned char> times;
+    std::vector<unsigned char> raw;
+};
+
+/**
+ * Maps a capture file read-only and hands out its chunks without copying.
+ */
+class CaptureReader {
+public:
+    CaptureReader();
+    ~CaptureReader();
+
+    bool open(const char *path);
+    void close();
+    bool isOpen() const { return data != NULL; }
+
+    const CaptureHeader& getHeader() const { return header; }
+
+    /**
+     * Gets the next chunk.  Returns false at the end of the file, or at a
+     * chunk that is cut short or corrupt (see isTruncated()).
+     */
+    bool next(CaptureChunk& chunk);
+    /** Goes back to the first chunk. */
+    void rewind();
+    /** True if next() stopped before the end of the file. */
+    bool isTruncated() const { return truncated; }
+
+private:
+    CaptureReader(const CaptureReader&);
+    CaptureReader& operator=(const CaptureReader&);
+
+    const unsigned char *data;
+    size_t size;
+    size_t offset;
+    size_t firstChunk;
+    bool truncated;
+    CaptureHeader header;
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_CAPTURE_H_ */
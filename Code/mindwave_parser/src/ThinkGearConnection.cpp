@@ -0,0 +1,96 @@
+#include "ThinkGearConnection.h"
+
+namespace thinkgear {
+
+namespace {
+
+// Packet contents that only a connected headset sends
+const uint16_t HEADSET_DATA = THINKGEAR_FRAME_RAW | THINKGEAR_FRAME_POOR_SIGNAL |
+                              THINKGEAR_FRAME_ATTENTION | THINKGEAR_FRAME_MEDITATION |
+                              THINKGEAR_FRAME_EEG_POWER | THINKGEAR_FRAME_BLINK;
+
+}  // namespace
+
+const char *connectionStateName(ConnectionState state){
+    switch (state){
+        case CONNECTION_DISCONNECTED: return "disconnected";
+        case CONNECTION_STANDBY: return "standby";
+        case CONNECTION_SCANNING: return "scanning";
+        case CONNECTION_CONNECTED: return "connected";
+        case CONNECTION_NOT_FOUND: return "not found";
+        default: return "?";
+    }
+}
+
+Connection::Connection()
+    : autoConnect(true), retryMicros(1000000), scanTimeout(10000000),
+      haveRequest(false), lastRequest(0), connectFrom(0), stats() {
+    stats.state = CONNECTION_DISCONNECTED;
+}
+
+void Connection::reset(uint64_t micros){
+    haveRequest = false;
+    connectFrom = micros;
+    enter(CONNECTION_DISCONNECTED, micros);
+}
+
+void Connection::enter(ConnectionState state, uint64_t micros){
+    if (state == stats.state)
+        return;
+    if (state == CONNECTION_CONNECTED){
+        stats.connects++;
+        stats.lastConnectMicros = micros - connectFrom;
+    } else if (stats.state == CONNECTION_CONNECTED){
+        // Time the next connection from when this one was lost
+        connectFrom = micros;
+    }
+    stats.state = state;
+    stats.stateMicros = micros;
+}
+
+void Connection::frame(const ThinkGearFrame& frame, uint64_t micros){
+    if (frame.present & THINKGEAR_FRAME_DONGLE){
+        switch (frame.dongleStatus){
+            case PARSER_CODE_HEADSET_CONNECTED:
+                enter(CONNECTION_CONNECTED, micros);
+                break;
+            case PARSER_CODE_HEADSET_NOT_FOUND:
+            case PARSER_CODE_REQUEST_DENIED:
+                if (stats.state == CONNECTION_SCANNING)
+                    stats.notFound++;
+                enter(CONNECTION_NOT_FOUND, micros);
+                break;
+            case PARSER_CODE_HEADSET_DISCONNECTED:
+                enter(CONNECTION_DISCONNECTED, micros);
+                break;
+            case PARSER_CODE_DONGLE_STANDBY:
+                // Scanning and not found keep the dongle in standby too
+                if (stats.state == CONNECTION_DISCONNECTED || stats.state == CONNECTION_CONNECTED)
+                    enter(CONNECTION_STANDBY, micros);
+                break;
+            default:
+                break;
+        }
+    }
+    if ((frame.present & HEADSET_DATA) && stats.state != CONNECTION_CONNECTED)
+        enter(CONNECTION_CONNECTED, micros);
+}
+
+unsigned char Connection::poll(uint64_t micros){
+    if (stats.state == CONNECTION_SCANNING && micros - lastRequest >= scanTimeout){
+        stats.notFound++;
+        enter(CONNECTION_NOT_FOUND, micros);
+    }
+    if (!autoConnect ||
+        (stats.state != CONNECTION_STANDBY && stats.state != CONNECTION_NOT_FOUND) ||
+        (haveRequest && micros - lastRequest < retryMicros))
+        return 0;
+
+    haveRequest = true;
+    lastRequest = micros;
+    stats.requests++;
+    enter(CONNECTION_SCANNING, micros);
+    return 0xC2;
+}
+
+}  // namespace thinkgear
@@ -0,0 +1,90 @@
+#ifndef THINKGEAR_CONNECTION_H_
+#define THINKGEAR_CONNECTION_H_
+
+/**
+ * @file ThinkGearConnection.h
+ *
+ * The MindWave dongle handshake as a state machine.  It only looks at
+ * decoded packets and the clock and says when to send a connect request;
+ * the owner does the writing, outside the parser callbacks.
+ *
+ *   disconnected --0xD4--> standby --0xC2--> scanning --0xD0--> connected
+ *                                               |
+ *                                  0xD1, 0xD3 or timeout
+ *                                               v
+ *                                           not found --retry--> scanning
+ *
+ * 0xD2 from any state goes to disconnected, and the dongle's next 0xD4
+ * to standby.  Headset data with no dongle codes at all, as from a
+ * MindWave Mobile, counts as connected.
+ */
+
+#include "ThinkGearStreamParser.h"
+#include <stdint.h>
+
+namespace thinkgear {
+
+enum ConnectionState {
+    CONNECTION_DISCONNECTED,    // nothing heard yet, or the dongle lost the headset
+    CONNECTION_STANDBY,         // the dongle is waiting for a connect request
+    CONNECTION_SCANNING,        // connect requested, no answer yet
+    CONNECTION_CONNECTED,       // headset data flowing
+    CONNECTION_NOT_FOUND        // the last request failed; retried after a while
+};
+
+const char *connectionStateName(ConnectionState state);
+
+/** Counters and timings, all times on the caller's microsecond clock */
+struct ConnectionStats {
+    ConnectionState state;
+    uint64_t stateMicros;       // when the current state began
+    uint32_t requests;          // connect requests sent
+    uint32_t connects;          // times it reached connected
+    uint32_t notFound;          // requests that failed or timed out
+    uint64_t lastConnectMicros; // time to connect, from reset() or losing the last
+                                // connection; 0 if never connected
+};
+
+class Connection {
+public:
+    Connection();
+
+    /**
+     * Send connect requests in standby and not found, at most one every
+     * @c retryMicros (1 s by default).  On by default.
+     */
+    void setAutoConnect(bool enable){ autoConnect = enable; }
+    void setRetryMicros(uint64_t micros){ retryMicros = micros; }
+    /** Give up on a request with no answer after this long; 10 s by default. */
+    void setScanTimeoutMicros(uint64_t micros){ scanTimeout = micros; }
+
+    /** Starts over, e.g. when the port is reopened. */
+    void reset(uint64_t micros);
+
+    /** Feeds one decoded packet that arrived at @c micros. */
+    void frame(const ThinkGearFrame& frame, uint64_t micros);
+
+    /**
+     * Returns the command byte to send now (0xC2), or 0 for nothing.
+     * Call after each batch of packets; a returned request counts as sent.
+     */
+    unsigned char poll(uint64_t micros);
+
+    ConnectionState getState() const { return stats.state; }
+    const ConnectionStats& getStats() const { return stats; }
+
+private:
+    void enter(ConnectionState state, uint64_t micros);
+
+    bool autoConnect;
+    uint64_t retryMicros;
+    uint64_t scanTimeout;
+    bool haveRequest;           // lastRequest is valid
+    uint64_t lastRequest;       // when the last request was sent
+    uint64_t connectFrom;       // reset() or losing the last connection
+    ConnectionStats stats;
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_CONNECTION_H_ */
@@ -0,0 +1,142 @@
+#ifndef THINKGEAR_EEG_H_
+#define THINKGEAR_EEG_H_
+
+/**
+ * @file ThinkGearEeg.h
+ *
+ * EegData, ofxThinkgear's eight EEG bands ranked from strongest to weakest,
+ * without openFrameworks, so host tools and tests can use it too.  Feed it
+ * the band powers of a 0x83 packet or of thinkgear::BandBank:
+ *
+ *     EegData eeg;
+ *     eeg.feed(bands.getPowers());
+ *     for (EegDataPart *part : eeg)
+ *         ...;    // strongest first; part->rank is its place
+ *
+ * The classes keep their ofxThinkgear names, outside namespace thinkgear.
+ */
+
+#include <array>
+#include <utility>
+
+class ofxThinkgearEventArgs;
+
+enum EEG_KIND {
+    EEG_DELTA,
+    EEG_THETA,
+    EEG_LOW_ALPHA,
+    EEG_HIGH_ALPHA,
+    EEG_LOW_BETA,
+    EEG_HIGH_BETA,
+    EEG_LOW_GAMMA,
+    EEG_MID_GAMMA
+};
+
+class EegDataPart {
+public:
+    EEG_KIND kind;
+    unsigned int value;
+    unsigned int previousValue;
+    float ratio;
+    float previousRatio;
+    unsigned char rank;         // 0 for the strongest band
+    
+    EegDataPart(EEG_KIND k) : kind(k) {
+        value = 0;
+        ratio = 0;
+        previousValue = 0;
+        previousRatio = 0;
+        rank = (unsigned char)k;
+    }
+    
+    void feed(unsigned int v, unsigned long int total){
+        previousRatio = ratio;
+        previousValue = value;
+        value = v;
+        ratio = total > 0 ? (float)v / (float)total : 0.0f;
+    }
+};
+
+class EegData {
+public:
+    // Bands ordered from strongest to weakest; rebuilt in place by feed()
+    std::array<EegDataPart*, 8> data;
+    typedef std::array<EegDataPart*, 8>::iterator iterator;
+    typedef std::array<EegDataPart*, 8>::const_iterator const_iterator;
+    
+    EegDataPart delta;
+    EegDataPart theta;
+    EegDataPart lowAlpha;
+    EegDataPart highAlpha;
+    EegDataPart lowBeta;
+    EegDataPart highBeta;
+    EegDataPart lowGamma;
+    EegDataPart midGamma;
+    
+    EegData() : 
+        delta(EEG_DELTA),
+        theta(EEG_THETA),
+        lowAlpha(EEG_LOW_ALPHA),
+        highAlpha(EEG_HIGH_ALPHA),
+        lowBeta(EEG_LOW_BETA),
+        highBeta(EEG_HIGH_BETA),
+        lowGamma(EEG_LOW_GAMMA),
+        midGamma(EEG_MID_GAMMA)
+    {
+        data[0] = &delta;
+        data[1] = &theta;
+        data[2] = &lowAlpha;
+        data[3] = &highAlpha;
+        data[4] = &lowBeta;
+        data[5] = &highBeta;
+        data[6] = &lowGamma;
+        data[7] = &midGamma;
+    }
+        
+    // The band powers of the last packet; defined in ofxThinkgear.h
+    void feed(ofxThinkgearEventArgs& owner);
+
+    // Band powers in EEG_KIND order, e.g. thinkgear::BandBank::getPowers()
+    void feed(const unsigned int *power){
+        unsigned long int total = 0;
+        for (int i=0; i<8; ++i)
+            total += power[i];
+        delta.feed(power[EEG_DELTA], total);
+        theta.feed(power[EEG_THETA], total);
+        lowAlpha.feed(power[EEG_LOW_ALPHA], total);
+        highAlpha.feed(power[EEG_HIGH_ALPHA], total);
+        lowBeta.feed(power[EEG_LOW_BETA], total);
+        highBeta.feed(power[EEG_HIGH_BETA], total);
+        lowGamma.feed(power[EEG_LOW_GAMMA], total);
+        midGamma.feed(power[EEG_MID_GAMMA], total);
+
+        // Optimal 19 comparator sorting network for 8 elements. It starts
+        // from the last ranking, which usually needs few swaps.
+        order(0,2); order(1,3); order(4,6); order(5,7);
+        order(0,4); order(1,5); order(2,6); order(3,7);
+        order(0,1); order(2,3); order(4,5); order(6,7);
+        order(2,4); order(3,5);
+        order(1,4); order(3,6);
+        order(1,2); order(3,4); order(5,6);
+        for (unsigned char i=0; i<data.size(); ++i)
+            data[i]->rank = i;
+    }
+    
+    iterator begin(){ return data.begin(); }
+    iterator end(){ return data.end(); }
+    const_iterator begin() const { return data.begin(); }
+    const_iterator end() const { return data.end(); }
+
+    // True if a ranks before b: larger value first, ties in band order
+    static bool compare(const EegDataPart* a, const EegDataPart* b){
+        return a->value > b->value || (a->value == b->value && a->kind < b->kind);
+    }
+    
+private:
+    void order(int i, int j){
+        if (compare(data[j], data[i]))
+            std::swap(data[i], data[j]);
+    }
+};
+
+#endif /* THINKGEAR_EEG_H_ */
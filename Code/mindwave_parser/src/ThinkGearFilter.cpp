@@ -0,0 +1,187 @@
+#include "ThinkGearFilter.h"
+#include "ThinkGearBands.h"
+#include "ThinkGearSpectrum.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace thinkgear {
+
+namespace {
+
+// Samples of a group gathered and filtered at a time
+const size_t BLOCK = 256;
+
+#if defined(__GNUC__)
+typedef float Lanes __attribute__((vector_size(THINKGEAR_FILTER_LANES * sizeof(float))));
+#endif
+
+// Cookbook intermediates for a centre or corner frequency and q
+struct Design {
+    double c, alpha;
+    Design(float hz, float q){
+        double w = 2 * M_PI * hz / THINKGEAR_RAW_RATE;
+        c = cos(w);
+        alpha = sin(w) / (2 * q);
+    }
+};
+
+Biquad normalize(double b0, double b1, double b2, double a0, double a1, double a2){
+    Biquad f;
+    f.b0 = (float)(b0 / a0);
+    f.b1 = (float)(b1 / a0);
+    f.b2 = (float)(b2 / a0);
+    f.a1 = (float)(a1 / a0);
+    f.a2 = (float)(a2 / a0);
+    return f;
+}
+
+}  // namespace
+
+Biquad Biquad::notch(float hz, float q){
+    Design d(hz, q);
+    return normalize(1, -2*d.c, 1, 1 + d.alpha, -2*d.c, 1 - d.alpha);
+}
+
+Biquad Biquad::highPass(float hz, float q){
+    Design d(hz, q);
+    return normalize((1 + d.c)/2, -(1 + d.c), (1 + d.c)/2, 1 + d.alpha, -2*d.c, 1 - d.alpha);
+}
+
+Biquad Biquad::lowPass(float hz, float q){
+    Design d(hz, q);
+    return normalize((1 - d.c)/2, 1 - d.c, (1 - d.c)/2, 1 + d.alpha, -2*d.c, 1 - d.alpha);
+}
+
+Biquad Biquad::bandPass(float hz, float q){
+    Design d(hz, q);
+    return normalize(d.alpha, 0, -d.alpha, 1 + d.alpha, -2*d.c, 1 - d.alpha);
+}
+
+std::vector<Biquad> mainsChain(float mainsHz, float highPassHz){
+    std::vector<Biquad> chain;
+    if (highPassHz > 0)
+        chain.push_back(Biquad::highPass(highPassHz));
+    chain.push_back(Biquad::notch(mainsHz));
+    if (2 * mainsHz < THINKGEAR_RAW_RATE / 2)
+        chain.push_back(Biquad::notch(2 * mainsHz));
+    return chain;
+}
+
+std::vector<Biquad> bandChain(int band, size_t sections){
+    float lo = BAND_LIMITS[band][0], hi = BAND_LIMITS[band][1];
+    float centre = sqrtf(lo * hi);
+    return std::vector<Biquad>(sections, Biquad::bandPass(centre, centre / (hi - lo)));
+}
+
+FilterBank::FilterBank() : channels(0) {
+}
+
+void FilterBank::setup(const std::vector<Biquad>& stages, size_t channels){
+    this->stages = stages;
+    this->channels = channels;
+    states.assign(groups() * stages.size() * 2 * THINKGEAR_FILTER_LANES, 0.0f);
+    block.assign(BLOCK * THINKGEAR_FILTER_LANES, 0.0f);
+}
+
+void FilterBank::reset(){
+    std::fill(states.begin(), states.end(), 0.0f);
+}
+
+void FilterBank::reset(size_t channel){
+    if (channel >= channels)
+        return;
+    size_t g = channel / THINKGEAR_FILTER_LANES, lane = channel % THINKGEAR_FILTER_LANES;
+    for (size_t s=0; s<stages.size(); ++s){
+        state(g, s)[lane] = 0;
+        state(g, s)[THINKGEAR_FILTER_LANES + lane] = 0;
+    }
+}
+
+void FilterBank::process(const int16_t *const *in, float *const *out, size_t count){
+    const size_t L = THINKGEAR_FILTER_LANES;
+    for (size_t g=0; g<groups(); ++g){
+        size_t lanes = std::min(L, channels - g*L);
+        for (size_t done=0; done<count; done+=BLOCK){
+            size_t n = std::min(BLOCK, count - done);
+            // Gather: headsets side by side, sample by sample
+            for (size_t l=0; l<lanes; ++l){
+                const int16_t *src = in[g*L + l] + done;
+                for (size_t i=0; i<n; ++i)
+                    block[i*L + l] = src[i];
+            }
+            for (size_t s=0; s<stages.size(); ++s){
+                const Biquad& f = stages[s];
+                float *st = state(g, s);
+#if defined(__GNUC__)
+                // Transposed direct form II, a whole group per instruction
+                Lanes s1, s2;
+                memcpy(&s1, st, sizeof(s1));
+                memcpy(&s2, st + L, sizeof(s2));
+                for (size_t i=0; i<n; ++i){
+                    Lanes x, y;
+                    memcpy(&x, &block[i*L], sizeof(x));
+                    y = f.b0*x + s1;
+                    s1 = f.b1*x - f.a1*y + s2;
+                    s2 = f.b2*x - f.a2*y;
+                    memcpy(&block[i*L], &y, sizeof(y));
+                }
+                memcpy(st, &s1, sizeof(s1));
+                memcpy(st + L, &s2, sizeof(s2));
+#else
+                for (size_t i=0; i<n; ++i){
+                    float *x = &block[i*L];
+                    for (size_t l=0; l<L; ++l){
+                        float y = f.b0*x[l] + st[l];
+                        st[l] = f.b1*x[l] - f.a1*y + st[L + l];
+                        st[L + l] = f.b2*x[l] - f.a2*y;
+                        x[l] = y;
+                    }
+                }
+#endif
+            }
+            // Scatter back to each headset's output
+            for (size_t l=0; l<lanes; ++l){
+                float *dst = out[g*L + l] + done;
+                for (size_t i=0; i<n; ++i)
+                    dst[i] = block[i*L + l];
+            }
+        }
+    }
+}
+
+void FilterBank::process(size_t channel, const int16_t *in, float *out, size_t count){
+    if (channel >= channels)
+        return;
+    size_t g = channel / THINKGEAR_FILTER_LANES, lane = channel % THINKGEAR_FILTER_LANES;
+    for (size_t i=0; i<count; ++i)
+        out[i] = in[i];
+    for (size_t s=0; s<stages.size(); ++s){
+        const Biquad& f = stages[s];
+        float *st = state(g, s);
+        float s1 = st[lane], s2 = st[THINKGEAR_FILTER_LANES + lane];
+        for (size_t i=0; i<count; ++i){
+            float x = out[i];
+            float y = f.b0*x + s1;
+            s1 = f.b1*x - f.a1*y + s2;
+            s2 = f.b2*x - f.a2*y;
+            out[i] = y;
+        }
+        st[lane] = s1;
+        st[THINKGEAR_FILTER_LANES + lane] = s2;
+    }
+}
+
+void FilterBank::process(size_t channel, const int16_t *in, int16_t *out, size_t count){
+    float buffer[BLOCK];
+    for (size_t done=0; done<count; done+=BLOCK){
+        size_t n = std::min(BLOCK, count - done);
+        process(channel, in + done, buffer, n);
+        for (size_t i=0; i<n; ++i){
+            float y = buffer[i] < -32768 ? -32768 : buffer[i] > 32767 ? 32767 : buffer[i];
+            out[done + i] = (int16_t)lrintf(y);
+        }
+    }
+}
+
+}  // namespace thinkgear
@@ -0,0 +1,101 @@
+#ifndef THINKGEAR_FILTER_H_
+#define THINKGEAR_FILTER_H_
+
+/**
+ * @file ThinkGearFilter.h
+ *
+ * IIR filtering of raw samples before any spectrum stage: cascaded
+ * biquads to take out mains hum (notch), electrode drift (high-pass), or
+ * everything but one band (band-pass).
+ *
+ * A FilterBank runs the same cascade over many headsets at once.  Their
+ * filter states sit side by side, THINKGEAR_FILTER_LANES headsets to a
+ * group, so one vector instruction advances a whole group by a sample.
+ * Each sample is filtered as soon as it is given, with no look-ahead, so
+ * a block adds no latency beyond its own length.
+ *
+ *     thinkgear::FilterBank bank;
+ *     bank.setup(thinkgear::mainsChain(50), 100);     // 100 headsets
+ *     bank.process(in, out, 64);  // in[h], out[h]: 64 samples of headset h
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Headsets filtered together by one vector instruction
+#define THINKGEAR_FILTER_LANES 8
+
+namespace thinkgear {
+
+/**
+ * One second order section, normalized so a0 is 1, designed for the 512
+ * Hz raw stream after the Audio EQ Cookbook.
+ */
+struct Biquad {
+    float b0, b1, b2, a1, a2;
+
+    /** Removes @c hz, e.g. 50 or 60 Hz mains; larger @c q is narrower. */
+    static Biquad notch(float hz, float q = 10);
+    /** Butterworth high-pass below @c hz with the default @c q */
+    static Biquad highPass(float hz, float q = 0.7071f);
+    static Biquad lowPass(float hz, float q = 0.7071f);
+    /** Band-pass around @c hz, unit gain at @c hz */
+    static Biquad bandPass(float hz, float q);
+};
+
+/**
+ * High-pass at @c highPassHz against drift, then notches at @c mainsHz
+ * and its second harmonic.
+ */
+std::vector<Biquad> mainsChain(float mainsHz, float highPassHz = 0.5f);
+
+/**
+ * A band-pass for ThinkGear band @c band (0 for delta through 7 for
+ * mid-gamma, see ThinkGearBands.h): @c sections identical sections for
+ * steeper sides.
+ */
+std::vector<Biquad> bandChain(int band, size_t sections = 2);
+
+class FilterBank {
+public:
+    FilterBank();
+
+    /** Runs @c stages one after another on each of @c channels headsets. */
+    void setup(const std::vector<Biquad>& stages, size_t channels);
+    bool isSetup() const { return !stages.empty(); }
+    size_t getChannels() const { return channels; }
+
+    /** Clears every channel's state, as if only zeros came before. */
+    void reset();
+    void reset(size_t channel);
+
+    /**
+     * Filters @c count samples of every channel: @c in[c] to @c out[c].
+     * Groups of THINKGEAR_FILTER_LANES channels run as vectors.
+     */
+    void process(const int16_t *const *in, float *const *out, size_t count);
+
+    /** Filters @c count samples of one channel only, e.g. one that fell behind. */
+    void process(size_t channel, const int16_t *in, float *out, size_t count);
+    /** The same, rounded and clamped back to raw samples */
+    void process(size_t channel, const int16_t *in, int16_t *out, size_t count);
+
+private:
+    size_t groups() const { return (channels + THINKGEAR_FILTER_LANES - 1) / THINKGEAR_FILTER_LANES; }
+    float *state(size_t group, size_t stage){
+        return &states[((group * stages.size() + stage) * 2) * THINKGEAR_FILTER_LANES];
+    }
+
+    std::vector<Biquad> stages;
+    size_t channels;
+    // Per group and stage, the two transposed direct form II states of
+    // every lane: s1[LANES] then s2[LANES]
+    std::vector<float> states;
+    // One group's samples, sample-major: block[i * LANES + lane]
+    std::vector<float> block;
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_FILTER_H_ */
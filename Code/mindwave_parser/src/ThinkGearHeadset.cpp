@@ -0,0 +1,252 @@
+#include "ThinkGearHeadset.h"
+#include <chrono>
+
+namespace thinkgear {
+
+Headset::Headset()
+    : frameFunc(NULL), frameData(NULL), dataValueFunc(NULL), dataValueData(NULL), log(NULL),
+      readMicros(0), baud(THINKGEAR_DEFAULT_BAUD), threaded(false),
+      queued(false), running(false), deviceOpen(false), droppedFrames(0), stats() {
+    connectionStats = connection.getStats();
+    THINKGEAR_initFrameParser(&parser, &frame, handleFrame, handleDataValue, this);
+}
+
+Headset::~Headset(){
+    close();
+}
+
+void Headset::setFrameCallback(FrameFunc func, void *customData){
+    frameFunc = func;
+    frameData = customData;
+}
+
+void Headset::setDataValueCallback(DataValueFunc func, void *customData){
+    dataValueFunc = func;
+    dataValueData = customData;
+}
+
+uint64_t Headset::nowMicros(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Headset::handleFrame(const ThinkGearFrame *frame, void *customData){
+    Headset& h = *static_cast<Headset*>(customData);
+    // Only tracks the handshake; any reply is written after the whole read
+    h.connection.frame(*frame, h.readMicros);
+    if (!h.queued){
+        if (h.frameFunc)
+            h.frameFunc(*frame, h.readMicros, h.frameData);
+        return;
+    }
+    QueuedFrame *slot = h.frames.tryPushSlot();
+    if (!slot){
+        h.droppedFrames++;
+        return;
+    }
+    slot->frame = *frame;
+    slot->micros = h.readMicros;
+    h.frames.commitPush();
+}
+
+void Headset::handleDataValue(unsigned char extendedCodeLevel, unsigned char code,
+                              unsigned char valueLength, const unsigned char *value,
+                              void *customData){
+    Headset& h = *static_cast<Headset*>(customData);
+    if (h.log)
+        h.log->dataValue(extendedCodeLevel, code, valueLength, value, h.readMicros);
+    if (h.dataValueFunc)
+        h.dataValueFunc(extendedCodeLevel, code, valueLength, value, h.dataValueData);
+}
+
+bool Headset::openPort(const char *path, int baud){
+    std::lock_guard<std::mutex> lock(portMutex);
+    if (!port.open(path, baud))
+        return false;
+    port.flush();
+    THINKGEAR_initFrameParser(&parser, &frame, handleFrame, handleDataValue, this);
+    THINKGEAR_setResync(&parser, 1);
+    connection.reset(nowMicros());
+    {
+        std::lock_guard<std::mutex> statsLock(mutex);
+        THINKGEAR_getStats(&parser, &stats);
+        connectionStats = connection.getStats();
+    }
+    deviceOpen = true;
+    return true;
+}
+
+void Headset::closePort(){
+    std::lock_guard<std::mutex> lock(portMutex);
+    if (port.isOpen()){
+        // Disconnect the dongle so the next open starts from standby
+        port.writeByte(0xC1);
+        port.close();
+    }
+    deviceOpen = false;
+}
+
+// Reads and parses whatever the device has buffered once wait() said there
+// was some; returns the bytes read, or -1 if the device is gone
+int Headset::readPort(){
+    int total = 0;
+    int n;
+    while ((n = port.read(buffer, sizeof(buffer))) > 0){
+        readMicros = nowMicros();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (recorder.isOpen())
+                recorder.append(buffer, n);
+        }
+        THINKGEAR_parseBuffer(&parser, buffer, n);
+        total += n;
+    }
+    if (n < 0 || total == 0){
+        // Readable but empty means end of file, e.g. an unplugged adapter
+        return -1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        THINKGEAR_getStats(&parser, &stats);
+    }
+    updateConnection(readMicros);
+    return total;
+}
+
+// Sends whatever the handshake calls for, at most one byte per call, and
+// publishes its state
+void Headset::updateConnection(uint64_t micros){
+    ConnectionState before = connection.getState();
+    unsigned char command = connection.poll(micros);
+    if (command)
+        writeByte(command);
+    if (command || connection.getState() != before ||
+        connection.getState() != connectionStats.state){
+        std::lock_guard<std::mutex> lock(mutex);
+        connectionStats = connection.getStats();
+    }
+}
+
+bool Headset::open(const char *path, int baud){
+    if (threaded)
+        return false;
+    closePort();
+    queued = false;
+    this->path = path;
+    this->baud = baud;
+    return openPort(path, baud);
+}
+
+bool Headset::openQueued(const char *path, int baud){
+    if (!open(path, baud))
+        return false;
+    queued = true;
+    return true;
+}
+
+int Headset::readAvailable(){
+    return deviceOpen ? readPort() : -1;
+}
+
+int Headset::poll(int timeoutMs){
+    if (queued || !deviceOpen)
+        return -1;
+    int n = port.wait(timeoutMs);
+    if (n > 0)
+        n = readPort();
+    else if (n == 0)
+        updateConnection(nowMicros());
+    if (n < 0)
+        closePort();
+    return n;
+}
+
+bool Headset::startThread(const char *path, int baud, int retryMs){
+    if (threaded)
+        return false;
+    closePort();
+    this->path = path;
+    this->baud = baud;
+    threaded = true;
+    queued = true;
+    running = true;
+    reader = std::thread(&Headset::run, this, retryMs);
+    return true;
+}
+
+void Headset::run(int retryMs){
+    // Short waits so close() never has to wait long for the thread
+    const int sliceMs = 50;
+    while (running){
+        if (!deviceOpen && !openPort(path.c_str(), baud)){
+            for (int waited=0; running && waited<retryMs; waited+=sliceMs)
+                std::this_thread::sleep_for(std::chrono::milliseconds(sliceMs));
+            continue;
+        }
+        int ready = port.wait(sliceMs);
+        if (ready == 0)
+            updateConnection(nowMicros());
+        else if (ready < 0 || readPort() < 0)
+            closePort();
+    }
+}
+
+size_t Headset::drain(){
+    size_t count = 0;
+    const QueuedFrame *next;
+    while ((next = frames.front()) != NULL){
+        if (frameFunc)
+            frameFunc(next->frame, next->micros, frameData);
+        frames.popFront();
+        ++count;
+    }
+    return count;
+}
+
+void Headset::close(){
+    if (threaded){
+        running = false;
+        reader.join();
+        threaded = false;
+    }
+    queued = false;
+    stopRecording();
+    closePort();
+}
+
+bool Headset::writeByte(unsigned char byte){
+    std::lock_guard<std::mutex> lock(portMutex);
+    return port.writeByte(byte);
+}
+
+void Headset::flush(){
+    std::lock_guard<std::mutex> lock(portMutex);
+    port.flush();
+}
+
+ThinkGearParserStats Headset::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+ConnectionStats Headset::getConnectionStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return connectionStats;
+}
+
+bool Headset::startRecording(const char *path){
+    std::lock_guard<std::mutex> lock(mutex);
+    return recorder.open(path, (uint32_t)baud);
+}
+
+void Headset::stopRecording(){
+    std::lock_guard<std::mutex> lock(mutex);
+    recorder.close();
+}
+
+bool Headset::isRecording() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return recorder.isOpen();
+}
+
+}  // namespace thinkgear
@@ -0,0 +1,203 @@
+#ifndef THINKGEAR_HEADSET_H_
+#define THINKGEAR_HEADSET_H_
+
+/**
+ * @file ThinkGearHeadset.h
+ *
+ * The openFrameworks-free core of ofxThinkgear: one ThinkGear device on a
+ * POSIX serial port, its parser, and an optional reader thread, delivering
+ * decoded packets to a plain callback.
+ *
+ * Direct use, everything on the calling thread:
+ *
+ *     thinkgear::Headset h;
+ *     h.setFrameCallback(onFrame, &app);
+ *     h.open("/dev/ttyUSB0");
+ *     while (h.poll(100) >= 0) {}
+ *
+ * Threaded use: startThread() opens the device itself, reopens it whenever
+ * it goes away, and queues the decoded packets; drain() then runs the
+ * callback for each of them on the calling thread.
+ */
+
+#include "ThinkGearStreamParser.h"
+#include "ThinkGearCapture.h"
+#include "ThinkGearConnection.h"
+#include "ThinkGearLog.h"
+#include "ThinkGearRing.h"
+#include "ThinkGearSerial.h"
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Baud rate of the MindWave dongle and MindWave Mobile
+#define THINKGEAR_DEFAULT_BAUD 115200
+// Decoded packets the reader thread can queue for drain(); 2 seconds of raw packets
+#define THINKGEAR_FRAME_QUEUE 1024
+
+namespace thinkgear {
+
+class Headset {
+public:
+    /**
+     * Called once per decoded packet.  @c micros is when its bytes were
+     * read, on the nowMicros() clock.
+     */
+    typedef void (*FrameFunc)(const ThinkGearFrame& frame, uint64_t micros, void *customData);
+
+    /** Called for DataRows the frame decoder does not recognize. */
+    typedef void (*DataValueFunc)(unsigned char extendedCodeLevel, unsigned char code,
+                                  unsigned char valueLength, const unsigned char *value,
+                                  void *customData);
+
+    Headset();
+    ~Headset();
+
+    /** Set before open() or startThread(). */
+    void setFrameCallback(FrameFunc func, void *customData);
+    void setDataValueCallback(DataValueFunc func, void *customData);
+    /**
+     * Also logs unrecognized DataRows to @c channel, from the thread that
+     * parses (see ThinkGearLog.h); NULL, the default, for none.
+     */
+    void setLog(LogChannel *channel){ log = channel; }
+
+    /**
+     * Opens @c path for poll().  Returns false if it cannot be opened; the
+     * caller decides when to try again.
+     */
+    bool open(const char *path, int baud = THINKGEAR_DEFAULT_BAUD);
+
+    /**
+     * Stops the reader thread, stops recording, and asks a dongle to drop
+     * the headset before closing the device.
+     */
+    void close();
+    bool isOpen() const { return deviceOpen; }
+
+    /**
+     * Direct mode: waits up to @c timeoutMs for data, then reads and parses
+     * everything buffered, running the callbacks on this thread.  Returns
+     * the bytes read, or -1 once the device is gone, after closing it.
+     */
+    int poll(int timeoutMs);
+
+    /**
+     * Reads @c path on a background thread from now on, opening it again
+     * every @c retryMs while it is missing.  Returns false if already
+     * threaded.
+     */
+    bool startThread(const char *path, int baud = THINKGEAR_DEFAULT_BAUD, int retryMs = 500);
+    bool isThreaded() const { return threaded; }
+
+    /**
+     * Opens @c path without a thread, but queues packets for drain() like
+     * startThread() does.  For one thread serving many devices (see
+     * ThinkGearManager.h): it calls readAvailable() whenever
+     * getDescriptor() polls readable, and close() when that returns -1.
+     */
+    bool openQueued(const char *path, int baud = THINKGEAR_DEFAULT_BAUD);
+    int readAvailable();
+    int getDescriptor() const { return port.getDescriptor(); }
+
+    /**
+     * Threaded or queued mode: runs the frame callback for every packet
+     * queued since the last call, on this thread.  Returns how many there
+     * were.
+     */
+    size_t drain();
+
+    /**
+     * Packets thrown away because drain() was not called for over
+     * THINKGEAR_FRAME_QUEUE packets (about 2 seconds)
+     */
+    unsigned long getDroppedFrames() const { return droppedFrames; }
+
+    /** Link health counters of the parser since the device last opened */
+    ThinkGearParserStats getStats() const;
+
+    /**
+     * Answer a dongle in standby with a connect request, so it pairs with
+     * the first headset it finds, and retry once a second while it is not
+     * found (see ThinkGearConnection.h).  On by default; set before open()
+     * or startThread().
+     */
+    void setAutoConnect(bool enable){ connection.setAutoConnect(enable); }
+
+    /** State of the dongle handshake, and how long connecting took */
+    ConnectionStats getConnectionStats() const;
+
+    /** Sends one command byte, e.g. 0xC2 to connect a dongle.  Any thread. */
+    bool writeByte(unsigned char byte);
+
+    /** Drops the bytes buffered by the serial driver */
+    void flush();
+
+    /**
+     * Records every byte read from the device, with arrival times, to a
+     * capture file (see ThinkGearCapture.h) until stopRecording() or close()
+     */
+    bool startRecording(const char *path);
+    void stopRecording();
+    bool isRecording() const;
+
+    /** Monotonic time in us, as passed to the frame callback */
+    static uint64_t nowMicros();
+
+private:
+    Headset(const Headset&);
+    Headset& operator=(const Headset&);
+
+    static void handleFrame(const ThinkGearFrame *frame, void *customData);
+    static void handleDataValue(unsigned char extendedCodeLevel, unsigned char code,
+                                unsigned char valueLength, const unsigned char *value,
+                                void *customData);
+
+    bool openPort(const char *path, int baud);
+    void closePort();
+    int readPort();
+    void updateConnection(uint64_t micros);
+    void run(int retryMs);
+
+    // A decoded packet and when it arrived
+    struct QueuedFrame {
+        ThinkGearFrame frame;
+        uint64_t micros;
+    };
+
+    FrameFunc frameFunc;
+    void *frameData;
+    DataValueFunc dataValueFunc;
+    void *dataValueData;
+    LogChannel *log;
+
+    // Owned by the reader thread while threaded
+    SerialPort port;
+    ThinkGearStreamParser parser;
+    ThinkGearFrame frame;
+    Connection connection;
+    uint64_t readMicros;
+    unsigned char buffer[512];
+    std::string path;
+    int baud;
+
+    // Shared with the reader thread
+    bool threaded;
+    bool queued;                        // threaded, or opened by openQueued()
+    std::thread reader;
+    std::atomic<bool> running;
+    SpscRing<QueuedFrame, THINKGEAR_FRAME_QUEUE> frames;
+    std::atomic<bool> deviceOpen;
+    std::atomic<unsigned long> droppedFrames;
+    std::mutex portMutex;               // guards opening, closing and writing the port
+    mutable std::mutex mutex;           // guards recorder and both stats
+    CaptureWriter recorder;
+    ThinkGearParserStats stats;
+    ConnectionStats connectionStats;
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_HEADSET_H_ */
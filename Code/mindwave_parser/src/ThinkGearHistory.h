@@ -0,0 +1,234 @@
+#ifndef THINKGEAR_HISTORY_H_
+#define THINKGEAR_HISTORY_H_
+
+/**
+ * @file ThinkGearHistory.h
+ *
+ * The last few seconds of a headset, kept in fixed-size rings that readers
+ * look at in place.  One thread writes; any number of threads may read at
+ * the same time without locks, copies or slowing the writer down.
+ *
+ *     HistoryRing<int16_t, 4096>::Span s = history.raw.newest(512);
+ *     for (size_t i=0; i<s.firstCount; ++i) use(s.first[i]);
+ *     for (size_t i=0; i<s.secondCount; ++i) use(s.second[i]);
+ *     if (!history.raw.isIntact(s))
+ *         ...;    // the writer lapped us; throw the result away
+ *
+ * A reader on the writer's own thread, such as an ofxThinkgear event
+ * handler, always sees intact spans and need not check.
+ */
+
+#include "ThinkGearStreamParser.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+namespace thinkgear {
+
+/**
+ * The newest @c N values of a stream, @c N a power of two.  Every value
+ * has a stream index, counting from 0 for the first one ever pushed.
+ *
+ * The two indices form a sequence lock: the writer raises @c claimed
+ * before overwriting slots and @c published once they are written, so a
+ * reader that finds its oldest index still within @c N of @c claimed
+ * after reading knows nothing it read was touched.
+ */
+template <class T, size_t N>
+class HistoryRing {
+    static_assert(N > 0 && (N & (N-1)) == 0, "HistoryRing size must be a power of two");
+
+public:
+    /**
+     * Up to @c N consecutive values, oldest first, as at most two runs in
+     * the ring: @c first, then @c second where the ring wraps.  Points
+     * into the ring; valid for as long as isIntact() says so.
+     */
+    struct Span {
+        const T *first;
+        size_t firstCount;
+        const T *second;
+        size_t secondCount;
+        uint64_t start;         // stream index of the oldest value
+
+        size_t size() const { return firstCount + secondCount; }
+        uint64_t end() const { return start + firstCount + secondCount; }
+        const T& operator[](size_t i) const {
+            return i < firstCount ? first[i] : second[i - firstCount];
+        }
+        /** Copies the values out in order; returns how many. */
+        size_t copyTo(T *out) const {
+            for (size_t i=0; i<firstCount; ++i)
+                out[i] = first[i];
+            for (size_t i=0; i<secondCount; ++i)
+                out[firstCount + i] = second[i];
+            return size();
+        }
+    };
+
+    HistoryRing() : claimed(0), published(0) {}
+
+    /** Writer: appends one value. */
+    void push(const T& value){
+        uint64_t w = published.load(std::memory_order_relaxed);
+        claimed.store(w + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        items[w & (N-1)] = value;
+        published.store(w + 1, std::memory_order_release);
+    }
+
+    /** Writer: appends @c count values; only the last @c N are kept. */
+    void push(const T *values, size_t count){
+        uint64_t w = published.load(std::memory_order_relaxed);
+        uint64_t end = w + count;
+        if (count > N){
+            values += count - N;
+            w = end - N;
+            count = N;
+        }
+        claimed.store(end, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i=0; i<count; ++i)
+            items[(w + i) & (N-1)] = values[i];
+        published.store(end, std::memory_order_release);
+    }
+
+    /** Values ever pushed; the next one gets this stream index. */
+    uint64_t getWritten() const { return published.load(std::memory_order_acquire); }
+
+    /**
+     * The newest @c count values, fewer if there are not that many yet.
+     * Asking for close to @c N leaves the writer little time before it
+     * overwrites the oldest; half the ring or less is comfortable.
+     */
+    Span newest(size_t count) const {
+        uint64_t end = published.load(std::memory_order_acquire);
+        if (count > end)
+            count = (size_t)end;
+        if (count > N)
+            count = N;
+        return span(end - count, end);
+    }
+
+    /**
+     * Everything from stream index @c from to the newest, e.g. the values
+     * added since a stage last ran.  Starts later than @c from if those
+     * have been overwritten already; check Span::start.
+     */
+    Span since(uint64_t from) const {
+        uint64_t end = published.load(std::memory_order_acquire);
+        if (from > end)
+            from = end;
+        if (end - from > N)
+            from = end - N;
+        return span(from, end);
+    }
+
+    /**
+     * Reader: true if no value of @c s has been overwritten yet.  Call
+     * after reading the span; the result covers everything read before.
+     */
+    bool isIntact(const Span& s) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return s.start + N >= claimed.load(std::memory_order_relaxed);
+    }
+
+    static size_t capacity(){ return N; }
+
+private:
+    HistoryRing(const HistoryRing&);
+    HistoryRing& operator=(const HistoryRing&);
+
+    Span span(uint64_t from, uint64_t end) const {
+        Span s;
+        size_t offset = (size_t)(from & (N-1));
+        size_t count = (size_t)(end - from);
+        s.start = from;
+        s.first = &items[offset];
+        s.firstCount = count < N - offset ? count : N - offset;
+        s.second = items;
+        s.secondCount = count - s.firstCount;
+        return s;
+    }
+
+    // Written together by the writer, read by every reader
+    alignas(64) std::atomic<uint64_t> claimed;
+    std::atomic<uint64_t> published;
+    alignas(64) T items[N];
+};
+
+/** One EEG band power packet (0x83) */
+struct BandPowers {
+    uint64_t micros;            // arrival, on the caller's clock
+    uint64_t rawIndex;          // raw samples before it, to line up with the raw ring
+    uint32_t power[THINKGEAR_EEG_BANDS];
+};
+
+/** The eSense and signal quality values as of one packet that changed them */
+struct ESense {
+    uint64_t micros;
+    uint64_t rawIndex;
+    uint8_t attention;
+    uint8_t meditation;
+    uint8_t poorSignal;
+};
+
+/**
+ * Raw samples, band powers and eSense values of one headset.  @c RAW raw
+ * samples are RAW/512 seconds; the slower values arrive once a second, so
+ * @c SLOW of them is that many seconds.  add() is the writer.
+ */
+template <size_t RAW, size_t SLOW>
+class History {
+public:
+    HistoryRing<int16_t, RAW> raw;
+    HistoryRing<BandPowers, SLOW> bands;
+    HistoryRing<ESense, SLOW> esense;
+
+    History() : attention(0), meditation(0), poorSignal(200) {}
+
+    /** Writer: records whatever @c frame carried, as arriving at @c micros. */
+    void add(const ThinkGearFrame& frame, uint64_t micros){
+        uint64_t rawIndex = raw.getWritten();
+        if (frame.present & THINKGEAR_FRAME_RAW)
+            raw.push(frame.raw, frame.numRaw);
+        if (frame.present & THINKGEAR_FRAME_EEG_POWER){
+            BandPowers b;
+            b.micros = micros;
+            b.rawIndex = rawIndex;
+            for (int i=0; i<THINKGEAR_EEG_BANDS; ++i)
+                b.power[i] = frame.eegPower[i];
+            bands.push(b);
+        }
+        const uint32_t ESENSE_FIELDS =
+            THINKGEAR_FRAME_ATTENTION | THINKGEAR_FRAME_MEDITATION | THINKGEAR_FRAME_POOR_SIGNAL;
+        if (frame.present & ESENSE_FIELDS){
+            if (frame.present & THINKGEAR_FRAME_ATTENTION)
+                attention = frame.attention;
+            if (frame.present & THINKGEAR_FRAME_MEDITATION)
+                meditation = frame.meditation;
+            if (frame.present & THINKGEAR_FRAME_POOR_SIGNAL)
+                poorSignal = frame.poorSignal;
+            ESense e;
+            e.micros = micros;
+            e.rawIndex = rawIndex;
+            e.attention = attention;
+            e.meditation = meditation;
+            e.poorSignal = poorSignal;
+            esense.push(e);
+        }
+    }
+
+private:
+    History(const History&);
+    History& operator=(const History&);
+
+    // Latest of each, as packets usually carry only some of them
+    uint8_t attention;
+    uint8_t meditation;
+    uint8_t poorSignal;
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_HISTORY_H_ */
@@ -0,0 +1,181 @@
+#include "ThinkGearLog.h"
+#include <string.h>
+#include <chrono>
+
+namespace thinkgear {
+
+namespace {
+
+// Monotonic time in us, on the clock of Headset::nowMicros()
+uint64_t nowMicros(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+LogChannel::LogChannel(const std::string& name, uint32_t burst)
+    : name(name), burst(burst), dropped(0), lastDropped(0) {
+    for (int l=0; l<2; ++l){
+        for (int c=0; c<256; ++c){
+            counts[l][c].store(0, std::memory_order_relaxed);
+            windowSecond[l][c] = 0;
+            windowCount[l][c] = 0;
+            skipped[l][c] = 0;
+            lastCounts[l][c] = 0;
+        }
+    }
+}
+
+void LogChannel::dataValue(unsigned char extendedCodeLevel, unsigned char code,
+                           unsigned char valueLength, const unsigned char *value, uint64_t micros){
+    int l = extendedCodeLevel ? 1 : 0;
+    // Only this thread writes the counters, so no read-modify-write needed
+    counts[l][code].store(counts[l][code].load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+
+    uint32_t second = (uint32_t)(micros / 1000000);
+    if (windowSecond[l][code] != second || windowCount[l][code] == 0){
+        windowSecond[l][code] = second;
+        windowCount[l][code] = 0;
+    }
+    if (++windowCount[l][code] > burst){
+        skipped[l][code]++;
+        return;
+    }
+
+    LogRecord *r = records.tryPushSlot();
+    if (!r){
+        dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        skipped[l][code]++;
+        return;
+    }
+    r->micros = micros;
+    r->skipped = skipped[l][code];
+    r->level = extendedCodeLevel;
+    r->code = code;
+    r->length = valueLength;
+    r->reserved = 0;
+    memcpy(r->bytes, value, valueLength < THINKGEAR_LOG_BYTES ? valueLength : THINKGEAR_LOG_BYTES);
+    records.commitPush();
+    skipped[l][code] = 0;
+}
+
+AsyncLog::AsyncLog(FILE *out)
+    : out(out), burst(4), flushMillis(100), summaryMillis(10000), lastSummary(0),
+      running(false) {
+}
+
+AsyncLog::~AsyncLog(){
+    if (running){
+        running = false;
+        flusher.join();
+    }
+    flush();
+    for (size_t i=0; i<channels.size(); ++i)
+        delete channels[i];
+}
+
+AsyncLog& AsyncLog::shared(){
+    static AsyncLog log;
+    return log;
+}
+
+void AsyncLog::setIntervals(uint32_t flush, uint32_t summary){
+    flushMillis = flush > 0 ? flush : 1;
+    summaryMillis = summary;
+}
+
+LogChannel *AsyncLog::addChannel(const std::string& name){
+    LogChannel *channel = new LogChannel(name, burst);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        channels.push_back(channel);
+        if (!lastSummary)
+            lastSummary = nowMicros();
+    }
+    bool expected = false;
+    if (running.compare_exchange_strong(expected, true))
+        flusher = std::thread(&AsyncLog::run, this);
+    return channel;
+}
+
+void AsyncLog::removeChannel(LogChannel *channel){
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i=0; i<channels.size(); ++i){
+        if (channels[i] == channel){
+            drain(*channel);
+            channels.erase(channels.begin() + i);
+            delete channel;
+            return;
+        }
+    }
+}
+
+// Writes out the records of one channel; mutex must be held
+void AsyncLog::drain(LogChannel& channel){
+    const LogRecord *r;
+    while ((r = channel.records.front()) != NULL){
+        fprintf(out, "%s %.6f level=%d code=0x%02X length=%d data=", channel.name.c_str(),
+                r->micros * 1e-6, r->level, r->code, r->length);
+        int shown = r->length < THINKGEAR_LOG_BYTES ? r->length : THINKGEAR_LOG_BYTES;
+        for (int i=0; i<shown; ++i)
+            fprintf(out, "%02X", r->bytes[i]);
+        if (shown < r->length)
+            fprintf(out, "...");
+        if (r->skipped)
+            fprintf(out, " (%u more not shown)", r->skipped);
+        fprintf(out, "\n");
+        channel.records.popFront();
+    }
+}
+
+// Prints codes seen since the last summary, with their rates; mutex must be held
+void AsyncLog::summarize(LogChannel& channel, double seconds){
+    bool any = false;
+    for (int l=0; l<2; ++l){
+        for (int c=0; c<256; ++c){
+            uint32_t count = channel.counts[l][c].load(std::memory_order_relaxed);
+            uint32_t delta = count - channel.lastCounts[l][c];
+            channel.lastCounts[l][c] = count;
+            if (!delta)
+                continue;
+            if (!any)
+                fprintf(out, "%s rates:", channel.name.c_str());
+            any = true;
+            fprintf(out, " %s0x%02X=%.1f/s", l ? "ex" : "", c, delta / seconds);
+        }
+    }
+    uint32_t dropped = channel.getDropped();
+    if (any || dropped != channel.lastDropped){
+        if (!any)
+            fprintf(out, "%s rates:", channel.name.c_str());
+        fprintf(out, " dropped=%u\n", dropped - channel.lastDropped);
+    }
+    channel.lastDropped = dropped;
+}
+
+void AsyncLog::flush(){
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i=0; i<channels.size(); ++i)
+        drain(*channels[i]);
+    fflush(out);
+}
+
+void AsyncLog::run(){
+    while (running){
+        std::this_thread::sleep_for(std::chrono::milliseconds(flushMillis));
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i=0; i<channels.size(); ++i)
+            drain(*channels[i]);
+        uint64_t now = nowMicros();
+        if (summaryMillis && now - lastSummary >= summaryMillis * 1000ULL){
+            for (size_t i=0; i<channels.size(); ++i)
+                summarize(*channels[i], (now - lastSummary) * 1e-6);
+            lastSummary = now;
+        }
+        fflush(out);
+    }
+}
+
+}  // namespace thinkgear
@@ -0,0 +1,153 @@
+#ifndef THINKGEAR_LOG_H_
+#define THINKGEAR_LOG_H_
+
+/**
+ * @file ThinkGearLog.h
+ *
+ * Logging of the DataRows the frame decoder does not recognize, without
+ * slowing down the thread that parses.  Each parsing thread writes binary
+ * records into a LogChannel of its own; a background thread of AsyncLog
+ * turns them into text lines.
+ *
+ *     thinkgear::LogChannel *log = thinkgear::AsyncLog::shared().addChannel("/dev/ttyUSB0");
+ *     headset.setLog(log);
+ *
+ * The writer side never locks, allocates or waits: counters are plain
+ * stores, and a record that does not fit in the channel is counted and
+ * dropped.  A code seen more than a few times a second is sampled: the
+ * rest of that second's records are only counted, and the next record
+ * written for the code says how many were left out.
+ */
+
+#include "ThinkGearRing.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Value bytes kept per record; longer values are cut short
+#define THINKGEAR_LOG_BYTES 16
+// Records a channel holds until the flusher gets to them
+#define THINKGEAR_LOG_QUEUE 256
+
+namespace thinkgear {
+
+/** One unrecognized DataRow, 32 bytes */
+struct LogRecord {
+    uint64_t micros;            // when it was read, Headset::nowMicros() clock
+    uint32_t skipped;           // records of this code sampled out before it
+    uint8_t level;              // extended code level
+    uint8_t code;
+    uint8_t length;             // full value length; bytes holds the start of it
+    uint8_t reserved;
+    uint8_t bytes[THINKGEAR_LOG_BYTES];
+};
+
+/** The writer side of one parsing thread; see AsyncLog::addChannel() */
+class LogChannel {
+public:
+    /**
+     * Logs one DataRow.  Only the one thread that owns the channel may call
+     * it; wait-free.
+     */
+    void dataValue(unsigned char extendedCodeLevel, unsigned char code,
+                   unsigned char valueLength, const unsigned char *value, uint64_t micros);
+
+    const std::string& getName() const { return name; }
+
+    /** DataRows seen of this level (0 or 1, higher counts as 1) and code; any thread */
+    uint32_t getCount(unsigned char extendedCodeLevel, unsigned char code) const {
+        return counts[extendedCodeLevel ? 1 : 0][code].load(std::memory_order_relaxed);
+    }
+
+    /** Records lost because the flusher fell behind */
+    uint32_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    friend class AsyncLog;
+
+    LogChannel(const std::string& name, uint32_t burst);
+    LogChannel(const LogChannel&);
+    LogChannel& operator=(const LogChannel&);
+
+    std::string name;
+    uint32_t burst;             // records per code per second before sampling
+
+    // Written by the owning thread only
+    SpscRing<LogRecord, THINKGEAR_LOG_QUEUE> records;
+    std::atomic<uint32_t> counts[2][256];
+    std::atomic<uint32_t> dropped;
+    uint32_t windowSecond[2][256];      // second of micros the code's window began
+    uint32_t windowCount[2][256];       // records of the code in that second
+    uint32_t skipped[2][256];           // sampled out since its last record
+
+    // Read by the flusher only: counts at the last rate summary
+    uint32_t lastCounts[2][256];
+    uint32_t lastDropped;
+};
+
+class AsyncLog {
+public:
+    /** Writes lines to @c out, stderr by default. */
+    explicit AsyncLog(FILE *out = stderr);
+    /** Flushes what is left and stops the flusher thread. */
+    ~AsyncLog();
+
+    /** The process-wide log on stderr, as used by ofxThinkgear */
+    static AsyncLog& shared();
+
+    /**
+     * Records per code per second written out before the rest of that
+     * second's are only counted; 4 by default.  Applies to channels added
+     * afterwards.
+     */
+    void setBurst(uint32_t perSecond){ burst = perSecond; }
+
+    /**
+     * How often the flusher wakes (100 ms by default), and how often it
+     * prints the rate of every code seen since the last summary (10 s by
+     * default, 0 for never).
+     */
+    void setIntervals(uint32_t flushMillis, uint32_t summaryMillis);
+
+    /**
+     * A new channel for one parsing thread, e.g. one Headset; @c name
+     * starts its lines.  Starts the flusher if it is not running yet.  The
+     * channel lives until removeChannel() or the log's destruction.
+     */
+    LogChannel *addChannel(const std::string& name);
+
+    /** Writes out and deletes @c channel; its writer must be done with it. */
+    void removeChannel(LogChannel *channel);
+
+    /** Writes out everything logged so far, on the calling thread. */
+    void flush();
+
+private:
+    AsyncLog(const AsyncLog&);
+    AsyncLog& operator=(const AsyncLog&);
+
+    void run();
+    void drain(LogChannel& channel);
+    void summarize(LogChannel& channel, double seconds);
+
+    FILE *out;
+    uint32_t burst;
+    uint32_t flushMillis;
+    uint32_t summaryMillis;
+
+    std::mutex mutex;                   // guards channels and the output
+    std::vector<LogChannel*> channels;
+    uint64_t lastSummary;
+
+    std::thread flusher;
+    std::atomic<bool> running;
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_LOG_H_ */
@@ -0,0 +1,324 @@
+#include "ThinkGearManager.h"
+#include <errno.h>
+#include <glob.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace thinkgear {
+
+namespace {
+
+// A device that has read nothing for this long is reported silent
+const uint64_t SILENT_MICROS = 1000000;
+// Longest poll(), so stop() and new devices are noticed quickly
+const int POLL_MILLIS = 100;
+
+}  // namespace
+
+const char *deviceStateName(DeviceState state){
+    switch (state){
+        case DEVICE_MISSING: return "missing";
+        case DEVICE_OPEN: return "open";
+        case DEVICE_STREAMING: return "streaming";
+        case DEVICE_SILENT: return "silent";
+        default: return "?";
+    }
+}
+
+HeadsetManager::HeadsetManager()
+    : frameFunc(NULL), frameData(NULL), minBackoff(250), maxBackoff(8000),
+      rescanMillis(2000), running(false) {
+}
+
+HeadsetManager::~HeadsetManager(){
+    stop();
+    for (size_t i=0; i<devices.size(); ++i)
+        delete devices[i];
+}
+
+void HeadsetManager::setFrameCallback(FrameFunc func, void *customData){
+    frameFunc = func;
+    frameData = customData;
+}
+
+void HeadsetManager::setBackoff(uint32_t minMillis, uint32_t maxMillis){
+    minBackoff = minMillis > 0 ? minMillis : 1;
+    maxBackoff = maxMillis > minBackoff ? maxMillis : minBackoff;
+}
+
+void HeadsetManager::handleFrame(const ThinkGearFrame& frame, uint64_t micros, void *customData){
+    Device& d = *static_cast<Device*>(customData);
+    if (d.owner->frameFunc)
+        d.owner->frameFunc(d.index, frame, micros, d.owner->frameData);
+}
+
+size_t HeadsetManager::addPort(const char *path, int baud){
+    return add(path, baud);
+}
+
+size_t HeadsetManager::add(const std::string& path, int baud){
+    std::lock_guard<std::mutex> lock(devicesMutex);
+    for (size_t i=0; i<devices.size(); ++i)
+        if (devices[i]->path == path)
+            return i;
+
+    Device *d = new Device();
+    d->owner = this;
+    d->index = devices.size();
+    d->path = path;
+    d->baud = baud;
+    d->wasOpen = false;
+    d->state = DEVICE_MISSING;
+    d->failures = 0;
+    d->absent = false;
+    d->reconnects = 0;
+    d->retryMicros = 0;
+    d->lastReadMicros = 0;
+    d->headset.setFrameCallback(handleFrame, d);
+    devices.push_back(d);
+    if (running)
+        assign(d);
+    return d->index;
+}
+
+// Gives a device to the worker with the fewest; devicesMutex must be held
+void HeadsetManager::assign(Device *device){
+    Worker *best = workers[0];
+    for (size_t i=1; i<workers.size(); ++i)
+        if (workers[i]->load < best->load)
+            best = workers[i];
+    best->load++;
+    std::lock_guard<std::mutex> lock(best->mutex);
+    best->incoming.push_back(device);
+}
+
+size_t HeadsetManager::addPorts(const char *pattern, int baud, uint32_t rescan){
+    size_t before = getDeviceCount();
+    glob_t g;
+    if (glob(pattern, 0, NULL, &g) == 0){
+        for (size_t i=0; i<g.gl_pathc; ++i)
+            add(g.gl_pathv[i], baud);
+        globfree(&g);
+    }
+    std::lock_guard<std::mutex> lock(devicesMutex);
+    Pattern p = { pattern, baud };
+    patterns.push_back(p);
+    if (rescan > 0 && rescan < rescanMillis)
+        rescanMillis = rescan;
+    return devices.size() - before;
+}
+
+// Picks up new matches of the patterns, and retries missing devices whose
+// path was gone when they last failed and has come back right away instead
+// of at the end of their backoff.  A path that is there but fails to open
+// (permissions, busy, not a tty) would only fail again.
+void HeadsetManager::rescan(uint64_t now){
+    std::vector<Pattern> current;
+    {
+        std::lock_guard<std::mutex> lock(devicesMutex);
+        current = patterns;
+    }
+    for (size_t p=0; p<current.size(); ++p){
+        glob_t g;
+        if (glob(current[p].glob.c_str(), 0, NULL, &g) != 0)
+            continue;
+        for (size_t i=0; i<g.gl_pathc; ++i)
+            add(g.gl_pathv[i], current[p].baud);
+        globfree(&g);
+    }
+
+    std::lock_guard<std::mutex> lock(devicesMutex);
+    for (size_t i=0; i<devices.size(); ++i){
+        Device& d = *devices[i];
+        if (d.state == DEVICE_MISSING && d.absent && d.retryMicros > now &&
+            access(d.path.c_str(), F_OK) == 0)
+            d.retryMicros = now;
+    }
+}
+
+bool HeadsetManager::start(int threads){
+    if (running)
+        return false;
+    std::lock_guard<std::mutex> lock(devicesMutex);
+    if (threads < 1){
+        int cores = (int)std::thread::hardware_concurrency();
+        threads = ((int)devices.size() + 31) / 32;
+        if (cores > 0 && threads > cores)
+            threads = cores;
+        if (threads < 1)
+            threads = 1;
+    }
+    for (int i=0; i<threads; ++i){
+        workers.push_back(new Worker());
+        workers.back()->load = 0;
+    }
+    for (size_t i=0; i<devices.size(); ++i)
+        assign(devices[i]);
+    running = true;
+    for (size_t i=0; i<workers.size(); ++i)
+        workers[i]->thread = std::thread(&HeadsetManager::serve, this, workers[i], i == 0);
+    return true;
+}
+
+void HeadsetManager::stop(){
+    if (!running)
+        return;
+    running = false;
+    for (size_t i=0; i<workers.size(); ++i){
+        workers[i]->thread.join();
+        delete workers[i];
+    }
+    workers.clear();
+}
+
+void HeadsetManager::tryOpen(Device& d, uint64_t now){
+    errno = 0;
+    if (d.headset.openQueued(d.path.c_str(), d.baud)){
+        if (d.wasOpen)
+            d.reconnects++;
+        d.wasOpen = true;
+        d.failures = 0;
+        d.absent = false;
+        d.state = DEVICE_OPEN;
+        return;
+    }
+    // open() leaves errno as the failed system call set it
+    d.absent = errno == ENOENT;
+    uint32_t failures = ++d.failures;
+    // minBackoff after the first failure, then doubling
+    uint64_t backoff = minBackoff;
+    for (uint32_t k=1; k<failures && backoff<maxBackoff; ++k)
+        backoff *= 2;
+    if (backoff > maxBackoff)
+        backoff = maxBackoff;
+    d.retryMicros = now + backoff * 1000;
+}
+
+void HeadsetManager::lost(Device& d, uint64_t now){
+    d.headset.close();
+    d.state = DEVICE_MISSING;
+    d.retryMicros = now + minBackoff * 1000ULL;
+}
+
+void HeadsetManager::serve(Worker *worker, bool rescans){
+    std::vector<Device*> mine;
+    std::vector<Device*> polled;
+    std::vector<struct pollfd> fds;
+    uint64_t nextRescan = Headset::nowMicros() + rescanMillis * 1000ULL;
+
+    while (running){
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            mine.insert(mine.end(), worker->incoming.begin(), worker->incoming.end());
+            worker->incoming.clear();
+        }
+
+        uint64_t now = Headset::nowMicros();
+        uint64_t wake = now + POLL_MILLIS * 1000;
+        if (rescans){
+            if (now >= nextRescan){
+                rescan(now);
+                nextRescan = now + rescanMillis * 1000ULL;
+            }
+            if (nextRescan < wake)
+                wake = nextRescan;
+        }
+
+        polled.clear();
+        fds.clear();
+        for (size_t i=0; i<mine.size(); ++i){
+            Device& d = *mine[i];
+            if (d.state == DEVICE_MISSING){
+                if (d.retryMicros <= now)
+                    tryOpen(d, now);
+                if (d.state == DEVICE_MISSING){
+                    if (d.retryMicros < wake)
+                        wake = d.retryMicros;
+                    continue;
+                }
+            }
+            struct pollfd p;
+            p.fd = d.headset.getDescriptor();
+            p.events = POLLIN;
+            p.revents = 0;
+            fds.push_back(p);
+            polled.push_back(&d);
+        }
+
+        int timeout = wake > now ? (int)((wake - now + 999) / 1000) : 0;
+        if (poll(fds.empty() ? NULL : &fds[0], fds.size(), timeout) < 0)
+            continue;
+
+        now = Headset::nowMicros();
+        for (size_t i=0; i<polled.size(); ++i){
+            Device& d = *polled[i];
+            if (fds[i].revents){
+                // Hangups and errors show up here too, as a failed read
+                if (d.headset.readAvailable() < 0){
+                    lost(d, now);
+                    continue;
+                }
+                d.lastReadMicros = now;
+                d.state = DEVICE_STREAMING;
+            } else if (d.state == DEVICE_STREAMING && now - d.lastReadMicros > SILENT_MICROS){
+                d.state = DEVICE_SILENT;
+            }
+        }
+    }
+
+    for (size_t i=0; i<mine.size(); ++i){
+        mine[i]->headset.close();
+        mine[i]->state = DEVICE_MISSING;
+        mine[i]->retryMicros = 0;
+    }
+}
+
+size_t HeadsetManager::update(){
+    size_t count = getDeviceCount();
+    size_t packets = 0;
+    for (size_t i=0; i<count; ++i){
+        Device *d;
+        {
+            std::lock_guard<std::mutex> lock(devicesMutex);
+            d = devices[i];
+        }
+        packets += d->headset.drain();
+    }
+    return packets;
+}
+
+size_t HeadsetManager::getDeviceCount() const {
+    std::lock_guard<std::mutex> lock(devicesMutex);
+    return devices.size();
+}
+
+DeviceStatus HeadsetManager::getStatus(size_t device) const {
+    DeviceStatus s;
+    Device *d = NULL;
+    {
+        std::lock_guard<std::mutex> lock(devicesMutex);
+        if (device < devices.size())
+            d = devices[device];
+    }
+    if (!d){
+        s.state = DEVICE_MISSING;
+        s.failures = s.reconnects = 0;
+        s.retryMicros = s.lastReadMicros = 0;
+        s.droppedFrames = 0;
+        s.stats = ThinkGearParserStats();
+        s.connection = ConnectionStats();
+        return s;
+    }
+    s.path = d->path;
+    s.state = (DeviceState)d->state.load();
+    s.failures = d->failures;
+    s.reconnects = d->reconnects;
+    s.retryMicros = d->retryMicros;
+    s.lastReadMicros = d->lastReadMicros;
+    s.droppedFrames = d->headset.getDroppedFrames();
+    s.stats = d->headset.getStats();
+    s.connection = d->headset.getConnectionStats();
+    return s;
+}
+
+}  // namespace thinkgear
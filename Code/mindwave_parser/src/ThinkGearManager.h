@@ -0,0 +1,159 @@
+#ifndef THINKGEAR_MANAGER_H_
+#define THINKGEAR_MANAGER_H_
+
+/**
+ * @file ThinkGearManager.h
+ *
+ * Reads a room full of ThinkGear devices.  Every device is a Headset in
+ * queued mode; a few pool threads poll() their share of the devices, open
+ * missing ones with exponential backoff and close lost ones, so a slow or
+ * unplugged dongle never holds up the thread that calls update().
+ *
+ *     thinkgear::HeadsetManager m;
+ *     m.setFrameCallback(onFrame, &app);
+ *     m.addPorts("/dev/ttyUSB*");
+ *     m.start();
+ *     ...
+ *     m.update();     // once a frame: onFrame() for every new packet
+ */
+
+#include "ThinkGearHeadset.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace thinkgear {
+
+enum DeviceState {
+    DEVICE_MISSING,         // not open; waiting to try again
+    DEVICE_OPEN,            // open, nothing read yet
+    DEVICE_STREAMING,       // bytes read within the last second
+    DEVICE_SILENT           // open, but nothing read for over a second
+};
+
+const char *deviceStateName(DeviceState state);
+
+/** A snapshot of one device, see HeadsetManager::getStatus() */
+struct DeviceStatus {
+    std::string path;
+    DeviceState state;
+    uint32_t failures;          // failed opens since it was last open
+    uint32_t reconnects;        // times it was opened again after being lost
+    uint64_t retryMicros;       // next open attempt while missing, nowMicros() clock
+    uint64_t lastReadMicros;    // last bytes read, 0 if none yet
+    unsigned long droppedFrames;
+    ThinkGearParserStats stats;
+    ConnectionStats connection;
+};
+
+class HeadsetManager {
+public:
+    /** Called once per packet, on the thread that calls update(). */
+    typedef void (*FrameFunc)(size_t device, const ThinkGearFrame& frame, uint64_t micros,
+                              void *customData);
+
+    HeadsetManager();
+    ~HeadsetManager();
+
+    /** Set before start(). */
+    void setFrameCallback(FrameFunc func, void *customData);
+
+    /**
+     * Time between open attempts on a missing device: @c minMillis after
+     * the first failure, doubling up to @c maxMillis.  250 and 8000 by
+     * default.
+     */
+    void setBackoff(uint32_t minMillis, uint32_t maxMillis);
+
+    /** Adds a device, before or after start(); returns its index. */
+    size_t addPort(const char *path, int baud = THINKGEAR_DEFAULT_BAUD);
+
+    /**
+     * Adds every path matching the glob @c pattern, e.g. "/dev/ttyUSB*",
+     * and while running looks for new matches every @c rescanMillis.
+     * Each look also retries at once any missing device whose path was
+     * absent when it last failed to open and is back now; devices that
+     * exist but fail to open keep their backoff.  Returns the number
+     * added now.
+     */
+    size_t addPorts(const char *pattern, int baud = THINKGEAR_DEFAULT_BAUD,
+                    uint32_t rescanMillis = 2000);
+
+    /**
+     * Starts @c threads pool threads, by default one per 32 devices up to
+     * the number of cores.  Returns false if already running.
+     */
+    bool start(int threads = 0);
+    /** Stops the pool and closes every device. */
+    void stop();
+    bool isRunning() const { return running; }
+
+    /**
+     * Runs the frame callback for every packet read since the last call,
+     * device by device.  Returns how many there were.
+     */
+    size_t update();
+
+    size_t getDeviceCount() const;
+    DeviceStatus getStatus(size_t device) const;
+
+private:
+    HeadsetManager(const HeadsetManager&);
+    HeadsetManager& operator=(const HeadsetManager&);
+
+    struct Device {
+        Headset headset;
+        HeadsetManager *owner;
+        size_t index;
+        std::string path;
+        int baud;
+        bool wasOpen;
+        std::atomic<int> state;
+        std::atomic<uint32_t> failures;
+        std::atomic<bool> absent;       // the last open failed for want of the path
+        std::atomic<uint32_t> reconnects;
+        std::atomic<uint64_t> retryMicros;
+        std::atomic<uint64_t> lastReadMicros;
+    };
+
+    struct Worker {
+        std::thread thread;
+        std::mutex mutex;               // guards incoming
+        std::vector<Device*> incoming;  // added since the worker last looked
+        size_t load;                    // devices given to it, under devicesMutex
+    };
+
+    static void handleFrame(const ThinkGearFrame& frame, uint64_t micros, void *customData);
+
+    size_t add(const std::string& path, int baud);
+    void assign(Device *device);
+    void rescan(uint64_t now);
+    void serve(Worker *worker, bool rescans);
+    void tryOpen(Device& device, uint64_t now);
+    void lost(Device& device, uint64_t now);
+
+    FrameFunc frameFunc;
+    void *frameData;
+    uint32_t minBackoff;
+    uint32_t maxBackoff;
+
+    mutable std::mutex devicesMutex;    // guards devices, patterns and worker loads
+    std::vector<Device*> devices;
+    struct Pattern {
+        std::string glob;
+        int baud;
+    };
+    std::vector<Pattern> patterns;
+    uint32_t rescanMillis;
+
+    std::atomic<bool> running;
+    std::vector<Worker*> workers;
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_MANAGER_H_ */
@@ -0,0 +1,266 @@
+#ifndef THINKGEAR_PARSER_H_
+#define THINKGEAR_PARSER_H_
+
+/**
+ * @file ThinkGearParser.h
+ *
+ * Header-only C++ counterpart of THINKGEAR_parseByte() for host code.
+ *
+ * thinkgear::Parser runs the same Packet state machine as the C parser,
+ * resynchronization included, but calls a functor instead of a function
+ * pointer, so the compiler can inline the per-DataRow handler.  When a
+ * list of CODEs is given, rows with any other CODE are skipped without
+ * calling the handler at all, and the handler only needs to deal with the
+ * listed CODEs:
+ *
+ * @code
+ * struct RawHandler {
+ *     void operator()(unsigned char extendedCodeLevel, unsigned char code,
+ *                     unsigned char numBytes, const unsigned char *value);
+ * };
+ * thinkgear::Parser<RawHandler, PARSER_CODE_RAW_SIGNAL> parser;
+ * parser.parse(buffer, n);
+ * @endcode
+ *
+ * A CODE in the list means that CODE at extended level 0; list
+ * thinkgear::extendedCode(level, code) for rows behind EXCODE bytes.  The
+ * list is a compile-time constant, so the check before each row inlines
+ * to a few compares against constants, and to nothing without a list.
+ * tools/tgbatch decodes capture files with one that takes raw rows only.
+ *
+ * Only the Packet stream format is supported, not the old 2-byte raw format,
+ * and no counters are kept; see THINKGEAR_getStats() for those.
+ */
+
+#include "ThinkGearStreamParser.h"
+#include <stddef.h>
+#include <string.h>
+
+namespace thinkgear {
+
+/** A DataRow CODE behind @c level EXCODE bytes, for a Parser's CODE list */
+constexpr unsigned extendedCode(unsigned level, unsigned char code){
+    return (level << 8) | code;
+}
+
+/**
+ * Compile-time set of DataRow CODEs, each as extendedCode(level, code).
+ */
+template <unsigned... Codes>
+struct CodeSet;
+
+template <>
+struct CodeSet<> {
+    static bool contains(unsigned) { return false; }
+};
+
+template <unsigned First, unsigned... Rest>
+struct CodeSet<First, Rest...> {
+    static bool contains(unsigned code) {
+        return code == First || CodeSet<Rest...>::contains(code);
+    }
+};
+
+template <class Handler, unsigned... Codes>
+class Parser {
+public:
+    explicit Parser(const Handler& h = Handler()) : handler(h), packetsOk(0), resync(false) {
+        reset();
+    }
+
+    /** Drops any partial Packet and waits for the next SyncBytes. */
+    void reset(){
+        state = STATE_SYNC;
+        payloadLength = 0;
+        payloadBytesReceived = 0;
+        payloadSum = 0;
+        chksum = 0;
+        replaying = false;
+    }
+
+    /** Like THINKGEAR_setResync(): rescan failed Packets for a header */
+    void setResync(bool enable){ resync = enable; }
+
+    Handler& getHandler(){ return handler; }
+    const Handler& getHandler() const { return handler; }
+
+    /**
+     * Same contract and return values as THINKGEAR_parseByte().
+     */
+    int parseByte(unsigned char byte){
+        int returnValue = 0;
+
+        switch (state) {
+            case STATE_SYNC:
+                if (byte == SYNC_BYTE)
+                    state = STATE_SYNC_CHECK;
+                break;
+
+            case STATE_SYNC_CHECK:
+                state = (byte == SYNC_BYTE) ? STATE_PAYLOAD_LENGTH : STATE_SYNC;
+                break;
+
+            case STATE_PAYLOAD_LENGTH:
+                payloadLength = byte;
+                if (payloadLength > 170){
+                    state = STATE_SYNC;
+                    returnValue = -3;
+                } else if (payloadLength == 170){
+                    returnValue = -4;
+                } else {
+                    payloadBytesReceived = 0;
+                    payloadSum = 0;
+                    state = STATE_PAYLOAD;
+                }
+                break;
+
+            case STATE_PAYLOAD:
+                payload[payloadBytesReceived++] = byte;
+                payloadSum = (unsigned char)(payloadSum + byte);
+                if (payloadBytesReceived >= payloadLength)
+                    state = STATE_CHKSUM;
+                break;
+
+            case STATE_CHKSUM:
+                chksum = byte;
+                state = STATE_SYNC;
+                if (byte != (unsigned char)~payloadSum){
+                    returnValue = -2;
+                    if (resync && !replaying)
+                        resyncPayload();
+                } else {
+                    returnValue = 1;
+                    packetsOk++;
+                    parsePayload();
+                }
+                break;
+
+            default:
+                state = STATE_SYNC;
+                returnValue = -5;
+                break;
+        }
+        return returnValue;
+    }
+
+    /**
+     * Same contract and return values as THINKGEAR_parseBuffer(), so
+     * Packets recovered by resync are counted.
+     */
+    int parse(const unsigned char *buffer, size_t length){
+        const unsigned char *p = buffer;
+        const unsigned char *end = buffer + length;
+        unsigned long before = packetsOk;
+
+        while (p < end){
+            if (state == STATE_SYNC){
+                p = static_cast<const unsigned char*>(memchr(p, SYNC_BYTE, end - p));
+                if (!p)
+                    break;
+                state = STATE_SYNC_CHECK;
+                ++p;
+            } else if (state == STATE_PAYLOAD && payloadBytesReceived < payloadLength){
+                size_t n = payloadLength - payloadBytesReceived;
+                if (n > (size_t)(end - p))
+                    n = end - p;
+                memcpy(payload + payloadBytesReceived, p, n);
+                unsigned int sum = payloadSum;
+                for (size_t i=0; i<n; ++i)
+                    sum += p[i];
+                payloadSum = (unsigned char)sum;
+                payloadBytesReceived = (unsigned char)(payloadBytesReceived + n);
+                if (payloadBytesReceived >= payloadLength)
+                    state = STATE_CHKSUM;
+                p += n;
+            } else {
+                parseByte(*p++);
+            }
+        }
+        return (int)(packetsOk - before);
+    }
+
+private:
+    enum {
+        STATE_SYNC = 1,
+        STATE_SYNC_CHECK,
+        STATE_PAYLOAD_LENGTH,
+        STATE_PAYLOAD,
+        STATE_CHKSUM
+    };
+    enum {
+        SYNC_BYTE = 0xAA,
+        EXCODE_BYTE = 0x55
+    };
+
+    /** True if rows with this level and CODE reach the handler */
+    static bool wants(unsigned char extendedCodeLevel, unsigned char code){
+        return sizeof...(Codes) == 0 ||
+               CodeSet<Codes...>::contains(extendedCode(extendedCodeLevel, code));
+    }
+
+    void parsePayload(){
+        unsigned int i = 0;
+        while (i < payloadLength){
+            unsigned char extendedCodeLevel = 0;
+            while (i < payloadLength && payload[i] == EXCODE_BYTE){
+                extendedCodeLevel++;
+                i++;
+            }
+            unsigned char code = payload[i++];
+            unsigned char numBytes = (code >= 0x80) ? payload[i++] : 1;
+            if (i + numBytes > payloadLength)
+                break;
+            if (wants(extendedCodeLevel, code))
+                handler(extendedCodeLevel, code, numBytes, payload + i);
+            i += numBytes;
+        }
+    }
+
+    // The C parser's resyncPayload(): replay whatever follows a header
+    // found inside a failed Packet, in place
+    void resyncPayload(){
+        unsigned int length = payloadLength;
+        unsigned int i = 0;
+
+        payload[length++] = chksum;
+        replaying = true;
+        while (i + 1 < length){
+            if (payload[i] != SYNC_BYTE || payload[i+1] != SYNC_BYTE){
+                i++;
+                continue;
+            }
+            state = STATE_PAYLOAD_LENGTH;
+            for (i += 2; i < length; i++)
+                if (parseByte(payload[i]) == -2)
+                    break;
+            if (i >= length){
+                replaying = false;
+                return;
+            }
+            // The replayed Packet failed too: rescan its bytes, then the rest
+            unsigned int n = payloadLength;
+            payload[n] = chksum;
+            memmove(payload + n+1, payload + i+1, length - (i+1));
+            length = n+1 + length - (i+1);
+            i = 0;
+        }
+        if (payload[length-1] == SYNC_BYTE)
+            state = STATE_SYNC_CHECK;
+        replaying = false;
+    }
+
+    Handler handler;
+    unsigned long packetsOk;    // replayed ones included, for parse()
+    bool resync;
+    bool replaying;
+    unsigned char state;
+    unsigned char payloadLength;
+    unsigned char payloadBytesReceived;
+    unsigned char payloadSum;
+    unsigned char chksum;
+    unsigned char payload[256];
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_PARSER_H_ */
@@ -0,0 +1,115 @@
+#include "ThinkGearPool.h"
+
+namespace thinkgear {
+
+WorkPool::WorkPool(size_t threads)
+    : generation(0), running(0), stopping(false), func(NULL), customData(NULL), steals(0) {
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+    for (size_t i=0; i<threads; ++i){
+        workers.push_back(new Worker());
+        workers.back()->next = workers.back()->end = 0;
+    }
+    for (size_t i=0; i<threads; ++i)
+        workers[i]->thread = std::thread(&WorkPool::loop, this, i);
+}
+
+WorkPool::~WorkPool(){
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (size_t i=0; i<workers.size(); ++i){
+        workers[i]->thread.join();
+        delete workers[i];
+    }
+}
+
+void WorkPool::run(size_t count, TaskFunc func, void *customData){
+    size_t n = workers.size();
+    std::unique_lock<std::mutex> guard(lock);
+    this->func = func;
+    this->customData = customData;
+    steals = 0;
+    // Equal contiguous shares; the first count % n get one more
+    size_t start = 0;
+    for (size_t i=0; i<n; ++i){
+        size_t share = count / n + (i < count % n ? 1 : 0);
+        std::lock_guard<std::mutex> shareGuard(workers[i]->lock);
+        workers[i]->next = start;
+        workers[i]->end = start + share;
+        start += share;
+    }
+    running = n;
+    ++generation;
+    wake.notify_all();
+    finished.wait(guard, [this]{ return running == 0; });
+}
+
+void WorkPool::loop(size_t self){
+    uint64_t seen = 0;
+    for (;;){
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&]{ return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+        size_t task;
+        while (take(self, task) || (steal(self) && take(self, task)))
+            func(task, self, customData);
+        std::lock_guard<std::mutex> guard(lock);
+        if (--running == 0)
+            finished.notify_one();
+    }
+}
+
+// The next number of this worker's own share, lowest first
+bool WorkPool::take(size_t self, size_t& task){
+    Worker& w = *workers[self];
+    std::lock_guard<std::mutex> guard(w.lock);
+    if (w.next >= w.end)
+        return false;
+    task = w.next++;
+    return true;
+}
+
+// Moves the upper half of the largest other share to this worker
+bool WorkPool::steal(size_t self){
+    size_t n = workers.size();
+    for (;;){
+        size_t victim = n, most = 0;
+        for (size_t i=1; i<n; ++i){
+            Worker& w = *workers[(self + i) % n];
+            std::lock_guard<std::mutex> guard(w.lock);
+            if (w.end - w.next > most){
+                most = w.end - w.next;
+                victim = (self + i) % n;
+            }
+        }
+        if (victim == n)
+            return false;
+        size_t first, end;
+        {
+            Worker& v = *workers[victim];
+            std::lock_guard<std::mutex> guard(v.lock);
+            if (v.next >= v.end)
+                continue;   // emptied since the look above, look again
+            end = v.end;
+            first = v.next + (v.end - v.next) / 2;
+            v.end = first;
+        }
+        Worker& w = *workers[self];
+        std::lock_guard<std::mutex> guard(w.lock);
+        w.next = first;
+        w.end = end;
+        steals += end - first;
+        return true;
+    }
+}
+
+}  // namespace thinkgear
@@ -0,0 +1,80 @@
+#ifndef THINKGEAR_POOL_H_
+#define THINKGEAR_POOL_H_
+
+/**
+ * @file ThinkGearPool.h
+ *
+ * A work-stealing pool for batch jobs made of many independent, numbered
+ * tasks, e.g. the chunks of recorded sessions.
+ *
+ *     thinkgear::WorkPool pool;               // one thread per core
+ *     pool.run(chunks.size(), processChunk, &job);
+ *
+ * run() hands every worker an equal, contiguous share of the task numbers
+ * so neighbouring tasks (and the file pages they read) stay on one core.
+ * A worker that runs out takes the upper half of whatever is left of the
+ * largest share, so slow tasks or a busy core never leave the others
+ * idle.  Each share has its own lock, held only to take a number.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace thinkgear {
+
+class WorkPool {
+public:
+    /** Called once per task number, on one of the workers */
+    typedef void (*TaskFunc)(size_t task, size_t worker, void *customData);
+
+    /** Starts @c threads workers, by default one per core. */
+    explicit WorkPool(size_t threads = 0);
+    ~WorkPool();
+
+    size_t getThreads() const { return workers.size(); }
+
+    /**
+     * Calls @c func for every task number below @c count, spread over the
+     * workers, and returns once all calls have returned.  @c worker tells
+     * a call which worker runs it, for per-worker buffers.
+     */
+    void run(size_t count, TaskFunc func, void *customData);
+
+    /** Tasks the last run() moved from one worker's share to another's */
+    uint64_t getSteals() const { return steals; }
+
+private:
+    WorkPool(const WorkPool&);
+    WorkPool& operator=(const WorkPool&);
+
+    struct Worker {
+        std::mutex lock;
+        size_t next;            // share: task numbers next up to end
+        size_t end;
+        std::thread thread;
+    };
+
+    void loop(size_t self);
+    bool take(size_t self, size_t& task);
+    bool steal(size_t self);
+
+    std::vector<Worker*> workers;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    uint64_t generation;        // one per run()
+    size_t running;             // workers still busy with this run()
+    bool stopping;
+    TaskFunc func;
+    void *customData;
+    std::atomic<uint64_t> steals;
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_POOL_H_ */
@@ -0,0 +1,96 @@
+#ifndef THINKGEAR_RING_H_
+#define THINKGEAR_RING_H_
+
+/**
+ * @file ThinkGearRing.h
+ *
+ * Fixed-size lock-free queue for passing values from exactly one producer
+ * thread to exactly one consumer thread.
+ */
+
+#include <stddef.h>
+#include <atomic>
+
+namespace thinkgear {
+
+/**
+ * Single-producer, single-consumer ring of @c N values of type @c T.  @c N
+ * must be a power of two.  Only the producer may call push() and
+ * tryPushSlot()/commitPush(); only the consumer may call pop() and
+ * front()/popFront().  Neither side ever blocks or allocates.
+ */
+template <class T, size_t N>
+class SpscRing {
+    static_assert(N > 0 && (N & (N-1)) == 0, "SpscRing size must be a power of two");
+
+public:
+    SpscRing() : head(0), tail(0) {}
+
+    /** Copies @c value in; returns false, dropping it, if the ring is full. */
+    bool push(const T& value){
+        T *slot = tryPushSlot();
+        if (!slot)
+            return false;
+        *slot = value;
+        commitPush();
+        return true;
+    }
+
+    /**
+     * Producer: returns the slot the next value goes into, or NULL if the
+     * ring is full.  Fill it in place, then call commitPush().
+     */
+    T *tryPushSlot(){
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == N)
+            return NULL;
+        return &items[h & (N-1)];
+    }
+
+    void commitPush(){
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /** Copies the oldest value out; returns false if the ring is empty. */
+    bool pop(T& value){
+        const T *oldest = front();
+        if (!oldest)
+            return false;
+        value = *oldest;
+        popFront();
+        return true;
+    }
+
+    /** Consumer: the oldest value, left in place, or NULL if empty. */
+    const T *front() const {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == t)
+            return NULL;
+        return &items[t & (N-1)];
+    }
+
+    /** Consumer: releases the value returned by front(). */
+    void popFront(){
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /** Number of values queued; exact only when called by either side. */
+    size_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    static size_t capacity(){ return N; }
+
+private:
+    SpscRing(const SpscRing&);
+    SpscRing& operator=(const SpscRing&);
+
+    // Producer and consumer indices on separate cache lines
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) T items[N];
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_RING_H_ */
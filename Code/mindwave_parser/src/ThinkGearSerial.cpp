@@ -0,0 +1,133 @@
+#include "ThinkGearSerial.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace thinkgear {
+
+namespace {
+
+bool toSpeed(int baud, speed_t& speed){
+    switch (baud){
+        case 9600: speed = B9600; return true;
+        case 19200: speed = B19200; return true;
+        case 38400: speed = B38400; return true;
+        case 57600: speed = B57600; return true;
+        case 115200: speed = B115200; return true;
+#ifdef B230400
+        case 230400: speed = B230400; return true;
+#endif
+        default: return false;
+    }
+}
+
+}  // namespace
+
+SerialPort::SerialPort() : fd(-1) {
+}
+
+SerialPort::~SerialPort(){
+    close();
+}
+
+bool SerialPort::open(const char *path, int baud){
+    close();
+    speed_t speed;
+    if (!toSpeed(baud, speed))
+        return false;
+
+    fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0)
+        return false;
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0){
+        close();
+        return false;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(fd, TCSANOW, &tio) != 0){
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SerialPort::close(){
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
+
+int SerialPort::wait(int timeoutMs){
+    if (fd < 0)
+        return -1;
+    struct pollfd p;
+    p.fd = fd;
+    p.events = POLLIN;
+    p.revents = 0;
+    int r;
+    do {
+        r = poll(&p, 1, timeoutMs);
+    } while (r < 0 && errno == EINTR);
+    if (r < 0)
+        return -1;
+    if (r == 0)
+        return 0;
+    if (p.revents & POLLIN)
+        return 1;
+    // POLLHUP or POLLERR without data: the device went away
+    return -1;
+}
+
+int SerialPort::read(unsigned char *buffer, size_t n){
+    if (fd < 0)
+        return -1;
+    ssize_t r;
+    do {
+        r = ::read(fd, buffer, n);
+    } while (r < 0 && errno == EINTR);
+    if (r >= 0)
+        return (int)r;
+    return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+}
+
+bool SerialPort::write(const unsigned char *bytes, size_t n){
+    if (fd < 0)
+        return false;
+    while (n > 0){
+        ssize_t r = ::write(fd, bytes, n);
+        if (r < 0){
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK){
+                struct pollfd p;
+                p.fd = fd;
+                p.events = POLLOUT;
+                p.revents = 0;
+                if (poll(&p, 1, 100) <= 0)
+                    return false;
+                continue;
+            }
+            return false;
+        }
+        bytes += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+void SerialPort::flush(){
+    if (fd >= 0)
+        tcflush(fd, TCIOFLUSH);
+}
+
+}  // namespace thinkgear
@@ -0,0 +1,63 @@
+#ifndef THINKGEAR_SERIAL_H_
+#define THINKGEAR_SERIAL_H_
+
+/**
+ * @file ThinkGearSerial.h
+ *
+ * Minimal POSIX serial port for talking to a ThinkGear device without
+ * openFrameworks: raw 8N1 termios setup and non-blocking reads, with
+ * poll() to wait for data.  Works the same on a pseudo-terminal.
+ */
+
+#include <stddef.h>
+
+namespace thinkgear {
+
+class SerialPort {
+public:
+    SerialPort();
+    ~SerialPort();
+
+    /**
+     * Opens @c path at @c baud (9600, 19200, 38400, 57600, 115200 or
+     * 230400) in raw non-blocking mode.  Returns false if the device cannot
+     * be opened or the baud rate is not supported.
+     */
+    bool open(const char *path, int baud);
+    void close();
+    bool isOpen() const { return fd >= 0; }
+
+    /**
+     * Waits up to @c timeoutMs (0 to just check, -1 forever) for bytes to
+     * read.  Returns 1 if there are some, 0 on timeout, -1 if the device
+     * is gone or failed.
+     */
+    int wait(int timeoutMs);
+
+    /**
+     * Reads up to @c n bytes without blocking.  Returns the number read,
+     * 0 if nothing is buffered, -1 if the device failed.  A raw tty also
+     * returns 0 at end of file, so a device that wait() reports readable
+     * but that has nothing to read is gone.
+     */
+    int read(unsigned char *buffer, size_t n);
+
+    /** Writes all @c n bytes; returns false on error. */
+    bool write(const unsigned char *bytes, size_t n);
+    bool writeByte(unsigned char byte){ return write(&byte, 1); }
+
+    /** Drops anything buffered in either direction. */
+    void flush();
+
+    int getDescriptor() const { return fd; }
+
+private:
+    SerialPort(const SerialPort&);
+    SerialPort& operator=(const SerialPort&);
+
+    int fd;
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_SERIAL_H_ */
@@ -0,0 +1,337 @@
+#include "ThinkGearSession.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SESSION_HEADER_SIZE   32
+#define SESSION_INDEX_ENTRY   48
+#define SESSION_TRAILER_SIZE  16
+
+namespace thinkgear {
+
+namespace {
+
+void put16(unsigned char *p, uint16_t v){
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+void put32(unsigned char *p, uint32_t v){
+    for (int i=0; i<4; ++i)
+        p[i] = (unsigned char)(v >> (8*i));
+}
+
+void put64(unsigned char *p, uint64_t v){
+    for (int i=0; i<8; ++i)
+        p[i] = (unsigned char)(v >> (8*i));
+}
+
+uint16_t get16(const unsigned char *p){
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t get32(const unsigned char *p){
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint64_t get64(const unsigned char *p){
+    return (uint64_t)get32(p) | ((uint64_t)get32(p+4) << 32);
+}
+
+// Time between raw samples at 512 Hz, in us
+const double RAW_PERIOD = 1e6 / 512;
+
+}  // namespace
+
+size_t sessionValueSize(SessionColumn column){
+    switch (column){
+        case SESSION_RAW: return 2;
+        case SESSION_ATTENTION:
+        case SESSION_MEDITATION:
+        case SESSION_POOR_SIGNAL: return 1;
+        case SESSION_SLOW_TIME: return 8;
+        default: return 3;
+    }
+}
+
+int64_t SessionChunk::value(uint32_t i) const {
+    size_t size = sessionValueSize(column);
+    const unsigned char *p = static_cast<const unsigned char*>(data) + (size_t)i * size;
+    switch (size){
+        case 1: return p[0];
+        case 2: return (int16_t)get16(p);
+        case 3: return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16);
+        default: return (int64_t)get64(p);
+    }
+}
+
+const char *sessionColumnName(SessionColumn column){
+    static const char *names[SESSION_COLUMNS] = {
+        "raw", "delta", "theta", "lowAlpha", "highAlpha", "lowBeta",
+        "highBeta", "lowGamma", "midGamma", "attention", "meditation",
+        "poorSignal", "slowTime"
+    };
+    return column < SESSION_COLUMNS ? names[column] : "?";
+}
+
+SessionWriter::SessionWriter()
+    : file(NULL), offset(0), failed(false), indexEntries(0),
+      attention(0), meditation(0), poorSignal(0) {
+    memset(eegPower, 0, sizeof(eegPower));
+}
+
+SessionWriter::~SessionWriter(){
+    close();
+}
+
+bool SessionWriter::open(const char *path, uint64_t startTime){
+    close();
+    file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    unsigned char h[SESSION_HEADER_SIZE];
+    memset(h, 0, sizeof(h));
+    memcpy(h, "TGCS", 4);
+    put16(h+4, THINKGEAR_SESSION_VERSION);
+    put16(h+6, SESSION_COLUMNS);
+    put64(h+8, startTime);
+    if (fwrite(h, sizeof(h), 1, file) != 1){
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+    offset = sizeof(h);
+    failed = false;
+
+    for (int c=0; c<SESSION_COLUMNS; ++c){
+        size_t capacity = (c == SESSION_RAW ? RAW_CHUNK : SLOW_CHUNK) *
+                          sessionValueSize((SessionColumn)c);
+        pending[c].bytes.clear();
+        pending[c].bytes.reserve(capacity);
+        pending[c].count = 0;
+    }
+    index.clear();
+    index.reserve(1024 * SESSION_INDEX_ENTRY);
+    indexEntries = 0;
+    memset(eegPower, 0, sizeof(eegPower));
+    attention = meditation = poorSignal = 0;
+    return true;
+}
+
+bool SessionWriter::close(){
+    if (!file)
+        return false;
+    for (int c=0; c<SESSION_COLUMNS; ++c)
+        flushColumn((SessionColumn)c);
+
+    unsigned char t[SESSION_TRAILER_SIZE];
+    put64(t, offset);
+    put32(t+8, indexEntries);
+    memcpy(t+12, "TGCE", 4);
+    if ((!index.empty() && fwrite(&index[0], index.size(), 1, file) != 1) ||
+        fwrite(t, sizeof(t), 1, file) != 1)
+        failed = true;
+    if (fclose(file) != 0)
+        failed = true;
+    file = NULL;
+    return !failed;
+}
+
+bool SessionWriter::addFrame(const ThinkGearFrame& frame, uint64_t micros){
+    if (!file)
+        return false;
+
+    for (int i=0; i<frame.numRaw; ++i){
+        double behind = (frame.numRaw - 1 - i) * RAW_PERIOD;
+        uint64_t t = micros > behind ? (uint64_t)(micros - behind) : 0;
+        add(SESSION_RAW, frame.raw[i], t);
+    }
+
+    const uint16_t slow = THINKGEAR_FRAME_EEG_POWER | THINKGEAR_FRAME_ATTENTION |
+                          THINKGEAR_FRAME_MEDITATION | THINKGEAR_FRAME_POOR_SIGNAL;
+    if (frame.present & slow){
+        if (frame.present & THINKGEAR_FRAME_EEG_POWER)
+            memcpy(eegPower, frame.eegPower, sizeof(eegPower));
+        if (frame.present & THINKGEAR_FRAME_ATTENTION)
+            attention = frame.attention;
+        if (frame.present & THINKGEAR_FRAME_MEDITATION)
+            meditation = frame.meditation;
+        if (frame.present & THINKGEAR_FRAME_POOR_SIGNAL)
+            poorSignal = frame.poorSignal;
+
+        for (int b=0; b<THINKGEAR_EEG_BANDS; ++b)
+            add((SessionColumn)(SESSION_DELTA + b), eegPower[b], micros);
+        add(SESSION_ATTENTION, attention, micros);
+        add(SESSION_MEDITATION, meditation, micros);
+        add(SESSION_POOR_SIGNAL, poorSignal, micros);
+        add(SESSION_SLOW_TIME, (int64_t)micros, micros);
+    }
+    return !failed;
+}
+
+void SessionWriter::add(SessionColumn column, int64_t value, uint64_t micros){
+    Pending& p = pending[column];
+    size_t size = sessionValueSize(column);
+
+    if (p.count > 0){
+        // Raw samples are spaced evenly within a chunk, so a stall ends it
+        if (column == SESSION_RAW && micros > p.lastMicros + RAW_STALL_MICROS)
+            flushColumn(column);
+        else if (p.count == (column == SESSION_RAW ? (uint32_t)RAW_CHUNK : (uint32_t)SLOW_CHUNK))
+            flushColumn(column);
+    }
+    if (p.count > 0 && micros < p.lastMicros)
+        micros = p.lastMicros;
+
+    unsigned char v[8];
+    put64(v, (uint64_t)value);
+    p.bytes.insert(p.bytes.end(), v, v + size);
+    if (p.count == 0){
+        p.firstMicros = micros;
+        p.min = p.max = value;
+    } else if (value < p.min){
+        p.min = value;
+    } else if (value > p.max){
+        p.max = value;
+    }
+    p.lastMicros = micros;
+    p.count++;
+}
+
+bool SessionWriter::flushColumn(SessionColumn column){
+    Pending& p = pending[column];
+    if (p.count == 0)
+        return true;
+
+    static const unsigned char zeros[8] = {0};
+    size_t pad = (8 - p.bytes.size() % 8) % 8;
+    if (fwrite(&p.bytes[0], p.bytes.size(), 1, file) != 1 ||
+        (pad && fwrite(zeros, pad, 1, file) != 1))
+        failed = true;
+
+    unsigned char e[SESSION_INDEX_ENTRY];
+    put16(e, (uint16_t)column);
+    put16(e+2, (uint16_t)sessionValueSize(column));
+    put32(e+4, p.count);
+    put64(e+8, offset);
+    put64(e+16, p.firstMicros);
+    put64(e+24, p.lastMicros);
+    put64(e+32, (uint64_t)p.min);
+    put64(e+40, (uint64_t)p.max);
+    index.insert(index.end(), e, e + sizeof(e));
+    indexEntries++;
+
+    offset += p.bytes.size() + pad;
+    p.bytes.clear();
+    p.count = 0;
+    return !failed;
+}
+
+SessionReader::SessionReader() : data(NULL), size(0), startTime(0) {
+}
+
+SessionReader::~SessionReader(){
+    close();
+}
+
+bool SessionReader::open(const char *path){
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < SESSION_HEADER_SIZE + SESSION_TRAILER_SIZE){
+        ::close(fd);
+        return false;
+    }
+    size_t length = (size_t)st.st_size;
+    void *map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    const unsigned char *p = static_cast<const unsigned char*>(map);
+    const unsigned char *t = p + length - SESSION_TRAILER_SIZE;
+    uint64_t indexOffset = get64(t);
+    uint64_t entries = get32(t+8);
+    uint64_t indexEnd = length - SESSION_TRAILER_SIZE;
+    // Bounds first, so a corrupt trailer cannot wrap the sum below
+    bool ok = memcmp(p, "TGCS", 4) == 0 &&
+              get16(p+4) == THINKGEAR_SESSION_VERSION &&
+              memcmp(t+12, "TGCE", 4) == 0 &&
+              indexOffset >= SESSION_HEADER_SIZE && indexOffset <= indexEnd &&
+              entries <= (indexEnd - indexOffset) / SESSION_INDEX_ENTRY &&
+              indexOffset + entries * SESSION_INDEX_ENTRY == indexEnd;
+
+    for (uint64_t i=0; ok && i<entries; ++i){
+        const unsigned char *e = p + indexOffset + i * SESSION_INDEX_ENTRY;
+        uint16_t column = get16(e);
+        uint64_t count = get32(e+4);
+        uint64_t at = get64(e+8);
+        if (column >= SESSION_COLUMNS ||
+            get16(e+2) != sessionValueSize((SessionColumn)column) ||
+            at % 8 != 0 || at > indexOffset ||
+            count * get16(e+2) > indexOffset - at){
+            ok = false;
+            break;
+        }
+        chunks[column].push_back(e);
+    }
+    if (!ok){
+        munmap(map, length);
+        for (int c=0; c<SESSION_COLUMNS; ++c)
+            chunks[c].clear();
+        return false;
+    }
+
+    data = p;
+    size = length;
+    startTime = get64(p+8);
+    return true;
+}
+
+void SessionReader::close(){
+    if (data)
+        munmap(const_cast<unsigned char*>(data), size);
+    data = NULL;
+    size = 0;
+    startTime = 0;
+    for (int c=0; c<SESSION_COLUMNS; ++c)
+        chunks[c].clear();
+}
+
+size_t SessionReader::getChunkCount(SessionColumn column) const {
+    return column < SESSION_COLUMNS ? chunks[column].size() : 0;
+}
+
+bool SessionReader::getChunk(SessionColumn column, size_t i, SessionChunk& chunk) const {
+    if (i >= getChunkCount(column))
+        return false;
+    const unsigned char *e = chunks[column][i];
+    chunk.column = column;
+    chunk.count = get32(e+4);
+    chunk.data = data + get64(e+8);
+    chunk.firstMicros = get64(e+16);
+    chunk.lastMicros = get64(e+24);
+    chunk.min = (int64_t)get64(e+32);
+    chunk.max = (int64_t)get64(e+40);
+    return true;
+}
+
+size_t SessionReader::findChunk(SessionColumn column, uint64_t micros) const {
+    size_t lo = 0, hi = getChunkCount(column);
+    while (lo < hi){
+        size_t mid = lo + (hi - lo) / 2;
+        if (get64(chunks[column][mid] + 24) < micros)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+}  // namespace thinkgear
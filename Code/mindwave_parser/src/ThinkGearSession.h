@@ -0,0 +1,193 @@
+#ifndef THINKGEAR_SESSION_H_
+#define THINKGEAR_SESSION_H_
+
+/**
+ * @file ThinkGearSession.h
+ *
+ * Columnar store for decoded ThinkGear sessions.
+ *
+ * Each decoded value kind is kept in its own column, and each column is
+ * split into chunks that are written out when they fill up.  The index at
+ * the end of the file lists every chunk with its value count, time span
+ * and min/max, so a reader can go straight to the chunks of the columns
+ * (and times) it needs and never touch the others.  Chunk data is 8-byte
+ * aligned, so on little-endian hosts a mapped file can be read in place
+ * as typed arrays, except for the 3-byte band power columns; read those
+ * with SessionChunk::value().
+ *
+ * Columns:
+ *  - SESSION_RAW: int16 raw samples at 512 Hz.  Samples of a chunk are
+ *    evenly spaced between its first and last time; a new chunk starts
+ *    whenever the stream stalls.
+ *  - SESSION_DELTA .. SESSION_MID_GAMMA: 24-bit unsigned band powers, 3
+ *    bytes each, one per 0x83 DataRow, about 1 Hz.
+ *  - SESSION_ATTENTION, SESSION_MEDITATION, SESSION_POOR_SIGNAL: uint8.
+ *  - SESSION_SLOW_TIME: uint64 arrival time, in us since the session
+ *    started, of each entry of the 1 Hz columns above.  These columns
+ *    always hold the same number of values; each entry repeats the last
+ *    value of a field its packet did not carry.
+ *
+ * All integers are little-endian.
+ *
+ * File header, 32 bytes:
+ *   0  char[4]  "TGCS"
+ *   4  uint16   version (THINKGEAR_SESSION_VERSION)
+ *   6  uint16   number of columns
+ *   8  uint64   wall clock time the session started, in us since 1970
+ *  16  uint64   reserved, 0
+ *  24  uint64   reserved, 0
+ *
+ * Then the chunk data, then the index: one 48 byte entry per chunk,
+ *   0  uint16   column
+ *   2  uint16   size of one value in bytes
+ *   4  uint32   number of values
+ *   8  uint64   file offset of the values
+ *  16  uint64   time of the first value, in us since the session started
+ *  24  uint64   time of the last value
+ *  32  int64    smallest value
+ *  40  int64    largest value
+ *
+ * and finally a 16 byte trailer: uint64 file offset of the index, uint32
+ * number of index entries, char[4] "TGCE".  Chunks of a column appear in
+ * the index in time order.
+ */
+
+#include "ThinkGearStreamParser.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#define THINKGEAR_SESSION_VERSION      1
+
+namespace thinkgear {
+
+enum SessionColumn {
+    SESSION_RAW,
+    SESSION_DELTA,
+    SESSION_THETA,
+    SESSION_LOW_ALPHA,
+    SESSION_HIGH_ALPHA,
+    SESSION_LOW_BETA,
+    SESSION_HIGH_BETA,
+    SESSION_LOW_GAMMA,
+    SESSION_MID_GAMMA,
+    SESSION_ATTENTION,
+    SESSION_MEDITATION,
+    SESSION_POOR_SIGNAL,
+    SESSION_SLOW_TIME,
+    SESSION_COLUMNS
+};
+
+/** Bytes per value of each column. */
+size_t sessionValueSize(SessionColumn column);
+/** Short name of each column, e.g. "raw" or "attention". */
+const char *sessionColumnName(SessionColumn column);
+
+/** One chunk of a mapped session file; @c data points into the map. */
+struct SessionChunk {
+    SessionColumn column;
+    uint32_t count;
+    uint64_t firstMicros;
+    uint64_t lastMicros;
+    int64_t min;
+    int64_t max;
+    const void *data;
+
+    template <class T>
+    const T *values() const { return static_cast<const T*>(data); }
+    /** Value @c i, for any column, the 3-byte ones included. */
+    int64_t value(uint32_t i) const;
+};
+
+/**
+ * Writes decoded frames to a session file.  Each column buffers one chunk
+ * in memory, so addFrame() only allocates if the index outgrows the room
+ * open() reserves for it (1024 chunks).
+ */
+class SessionWriter {
+public:
+    enum {
+        RAW_CHUNK = 65536,          // raw samples per chunk, 128 s
+        SLOW_CHUNK = 4096,          // 1 Hz entries per chunk
+        RAW_STALL_MICROS = 250000   // gap that starts a new raw chunk
+    };
+
+    SessionWriter();
+    ~SessionWriter();
+
+    bool open(const char *path, uint64_t startTime);
+    /** Writes out pending chunks and the index.  Returns false on error. */
+    bool close();
+    bool isOpen() const { return file != NULL; }
+
+    /**
+     * Adds the values of one decoded Packet that arrived @c micros us after
+     * the session started.  Raw samples are taken to be 1/512 s apart, the
+     * last one arriving at @c micros.
+     */
+    bool addFrame(const ThinkGearFrame& frame, uint64_t micros);
+
+private:
+    SessionWriter(const SessionWriter&);
+    SessionWriter& operator=(const SessionWriter&);
+
+    struct Pending {
+        std::vector<unsigned char> bytes;
+        uint32_t count;
+        uint64_t firstMicros;
+        uint64_t lastMicros;
+        int64_t min;
+        int64_t max;
+    };
+
+    void add(SessionColumn column, int64_t value, uint64_t micros);
+    bool flushColumn(SessionColumn column);
+
+    FILE *file;
+    uint64_t offset;
+    bool failed;
+    Pending pending[SESSION_COLUMNS];
+    std::vector<unsigned char> index;
+    uint32_t indexEntries;
+    uint32_t eegPower[THINKGEAR_EEG_BANDS];
+    uint8_t attention, meditation, poorSignal;
+};
+
+/**
+ * Maps a session file read-only and hands out its chunks without copying.
+ */
+class SessionReader {
+public:
+    SessionReader();
+    ~SessionReader();
+
+    bool open(const char *path);
+    void close();
+    bool isOpen() const { return data != NULL; }
+
+    uint64_t getStartTime() const { return startTime; }
+
+    size_t getChunkCount(SessionColumn column) const;
+    /** Gets chunk @c i of @c column; returns false if there is none. */
+    bool getChunk(SessionColumn column, size_t i, SessionChunk& chunk) const;
+    /**
+     * Index of the first chunk of @c column whose last value is at or after
+     * @c micros, or getChunkCount() if there is none.
+     */
+    size_t findChunk(SessionColumn column, uint64_t micros) const;
+
+private:
+    SessionReader(const SessionReader&);
+    SessionReader& operator=(const SessionReader&);
+
+    const unsigned char *data;
+    size_t size;
+    uint64_t startTime;
+    // Index entries of each column, in time order
+    std::vector<const unsigned char*> chunks[SESSION_COLUMNS];
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_SESSION_H_ */
@@ -0,0 +1,235 @@
+#include "ThinkGearSimulator.h"
+#include <math.h>
+
+namespace thinkgear {
+
+namespace {
+
+// 0xD4 packets while in standby or scanning
+const uint64_t STANDBY_PERIOD = 250000;
+// The 1 Hz eSense and band power packet
+const uint64_t SLOW_PERIOD = 1000000;
+// Bursts start on 100 ms boundaries
+const uint64_t BURST_CHECK = 100000;
+
+// Typical ASIC_EEG_POWER values, delta to mid gamma
+const double BAND_POWER[8] = {
+    800000, 300000, 60000, 50000, 30000, 25000, 8000, 4000
+};
+
+// Raw signal: 10 Hz alpha, 6 Hz theta, 20 Hz beta and 50 Hz mains hum, in ADC counts
+const double TONE_HZ[4] = { 10, 6, 20, 50 };
+const double TONE_AMPLITUDE[4] = { 60, 30, 15, 10 };
+const double NOISE_AMPLITUDE = 20;
+
+const double TWO_PI = 6.283185307179586;
+
+}  // namespace
+
+HeadsetSimulator::HeadsetSimulator(uint16_t id, uint64_t seed)
+    : headsetId(id), rng(seed * 0x9E3779B97F4A7C15ULL + 1), connectMicros(100000),
+      state(STANDBY), started(false), commandSkip(0), nextStandby(0), connectAt(0),
+      streamStart(0), nextRaw(0), nextSlow(0), burstUntil(0), nextBurstCheck(0),
+      rawIndex(0), attention(50), meditation(50),
+      bytesOut(0), bytesDropped(0), bytesCorrupted(0), bursts(0) {
+    for (int i=0; i<4; ++i)
+        phase[i] = uniform() * TWO_PI;
+    pending.reserve(4096);
+}
+
+// xorshift64*
+uint64_t HeadsetSimulator::random(){
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return rng * 0x2545F4914F6CDD1DULL;
+}
+
+void HeadsetSimulator::start(uint64_t micros){
+    if (started)
+        return;
+    started = true;
+    nextStandby = micros;
+    nextBurstCheck = micros + BURST_CHECK;
+}
+
+void HeadsetSimulator::setConnected(uint64_t micros){
+    start(micros);
+    state = CONNECTED;
+    streamStart = nextRaw = nextSlow = micros;
+    rawIndex = 0;
+}
+
+void HeadsetSimulator::command(unsigned char byte, uint64_t micros){
+    start(micros);
+    if (commandSkip > 0){
+        commandSkip--;
+        return;
+    }
+    switch (byte){
+        case 0xC0:
+            // Connect to a given headset; any ID will do
+            commandSkip = 2;
+            // fall through
+        case 0xC2:
+            if (state == STANDBY){
+                state = SCANNING;
+                connectAt = micros + connectMicros;
+                nextStandby = micros;
+            }
+            break;
+        case 0xC1:
+            if (state != STANDBY){
+                dongle(0xD2);
+                state = STANDBY;
+                nextStandby = micros + STANDBY_PERIOD;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+uint64_t HeadsetSimulator::nextMicros() const {
+    uint64_t next;
+    if (state == CONNECTED)
+        next = nextRaw < nextSlow ? nextRaw : nextSlow;
+    else if (state == SCANNING && connectAt < nextStandby)
+        next = connectAt;
+    else
+        next = nextStandby;
+    if (!pending.empty() && burstUntil > next)
+        next = burstUntil;
+    return next;
+}
+
+size_t HeadsetSimulator::generate(uint64_t micros, std::vector<unsigned char>& out){
+    start(micros);
+
+    if (state == SCANNING && connectAt <= micros){
+        if (faults.notFoundRate > 0 && uniform() < faults.notFoundRate){
+            dongle(0xD1);
+            state = STANDBY;
+            nextStandby = connectAt + STANDBY_PERIOD;
+        } else {
+            dongle(0xD0);
+            setConnected(connectAt);
+        }
+    }
+    while (state != CONNECTED && nextStandby <= micros){
+        dongle(0xD4);
+        nextStandby += STANDBY_PERIOD;
+    }
+    while (state == CONNECTED){
+        if (nextSlow <= nextRaw && nextSlow <= micros){
+            slowPacket();
+            nextSlow += SLOW_PERIOD;
+        } else if (nextRaw <= micros){
+            rawPacket();
+            // 1953.125 us apart, without drift
+            nextRaw = streamStart + (rawIndex * 15625) / 8;
+        } else {
+            break;
+        }
+    }
+
+    while (nextBurstCheck <= micros){
+        if (faults.burstRate > 0 && micros >= burstUntil &&
+            uniform() < faults.burstRate * (BURST_CHECK * 1e-6)){
+            burstUntil = nextBurstCheck + faults.burstMillis * 1000ULL;
+            bursts++;
+        }
+        nextBurstCheck += BURST_CHECK;
+    }
+    if (micros < burstUntil || pending.empty())
+        return 0;
+    size_t n = pending.size();
+    out.insert(out.end(), pending.begin(), pending.end());
+    pending.clear();
+    return n;
+}
+
+void HeadsetSimulator::packet(const unsigned char *payload, size_t n){
+    unsigned char header[3] = { 0xAA, 0xAA, (unsigned char)n };
+    unsigned char sum = 0;
+    for (size_t i=0; i<n; ++i)
+        sum += payload[i];
+    unsigned char checksum = (unsigned char)~sum;
+
+    bool faulty = faults.dropRate > 0 || faults.corruptRate > 0;
+    for (size_t i=0; i<n+4; ++i){
+        unsigned char b = i < 3 ? header[i] : i < n+3 ? payload[i-3] : checksum;
+        bytesOut++;
+        if (faulty){
+            if (faults.dropRate > 0 && uniform() < faults.dropRate){
+                bytesDropped++;
+                continue;
+            }
+            if (faults.corruptRate > 0 && uniform() < faults.corruptRate){
+                b ^= (unsigned char)(1 << (random() & 7));
+                bytesCorrupted++;
+            }
+        }
+        pending.push_back(b);
+    }
+}
+
+void HeadsetSimulator::dongle(unsigned char code){
+    unsigned char p[4] = { code, 0, 0, 0 };
+    size_t n;
+    if (code == 0xD4){
+        p[1] = 1;
+        p[2] = state == SCANNING ? 1 : 0;
+        n = 3;
+    } else {
+        p[1] = 2;
+        p[2] = (unsigned char)(headsetId >> 8);
+        p[3] = (unsigned char)headsetId;
+        n = 4;
+    }
+    packet(p, n);
+}
+
+short HeadsetSimulator::sample(){
+    double t = rawIndex / 512.0;
+    double v = (uniform() * 2 - 1) * NOISE_AMPLITUDE;
+    for (int i=0; i<4; ++i)
+        v += TONE_AMPLITUDE[i] * sin(TWO_PI * TONE_HZ[i] * t + phase[i]);
+    return (short)lrint(v);
+}
+
+void HeadsetSimulator::rawPacket(){
+    short v = sample();
+    rawIndex++;
+    unsigned char p[4] = { 0x80, 2, (unsigned char)((v >> 8) & 0xFF), (unsigned char)(v & 0xFF) };
+    packet(p, sizeof(p));
+}
+
+void HeadsetSimulator::slowPacket(){
+    attention += (int)(random() % 17) - 8;
+    meditation += (int)(random() % 17) - 8;
+    attention = attention < 1 ? 1 : attention > 100 ? 100 : attention;
+    meditation = meditation < 1 ? 1 : meditation > 100 ? 100 : meditation;
+
+    unsigned char p[32];
+    size_t n = 0;
+    p[n++] = 0x02;
+    p[n++] = 0;
+    p[n++] = 0x83;
+    p[n++] = 24;
+    for (int b=0; b<8; ++b){
+        uint32_t v = (uint32_t)(BAND_POWER[b] * (0.5 + uniform()));
+        if (v > 0xFFFFFF)
+            v = 0xFFFFFF;
+        p[n++] = (unsigned char)(v >> 16);
+        p[n++] = (unsigned char)(v >> 8);
+        p[n++] = (unsigned char)v;
+    }
+    p[n++] = 0x04;
+    p[n++] = (unsigned char)attention;
+    p[n++] = 0x05;
+    p[n++] = (unsigned char)meditation;
+    packet(p, n);
+}
+
+}  // namespace thinkgear
@@ -0,0 +1,118 @@
+#ifndef THINKGEAR_SIMULATOR_H_
+#define THINKGEAR_SIMULATOR_H_
+
+/**
+ * @file ThinkGearSimulator.h
+ *
+ * Byte-level model of a MindWave dongle and headset, for exercising the
+ * parser and everything behind it without hardware.  tools/tgsim serves
+ * any number of these on pseudo-terminals.
+ *
+ * The dongle sends 0xD4 standby packets until the host writes 0xC2 (or
+ * 0xC0 and a headset ID), then 0xD0 once the headset is found.  The
+ * headset then streams 0x80 raw packets at 512 Hz and, once a second, one
+ * packet with 0x02 poor signal, 0x83 band powers, 0x04 attention and 0x05
+ * meditation.  0xC1 disconnects with 0xD2 and goes back to standby.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace thinkgear {
+
+/** Faults injected into the byte stream; all rates are 0 to 1. */
+struct SimulatorFaults {
+    double dropRate;        // chance each byte is lost
+    double corruptRate;     // chance each byte has one bit flipped
+    double burstRate;       // chance per second the link stalls...
+    uint32_t burstMillis;   // ...for this long, then delivers it all at once
+    double notFoundRate;    // chance a connect request ends in 0xD1
+
+    SimulatorFaults()
+        : dropRate(0), corruptRate(0), burstRate(0), burstMillis(200), notFoundRate(0) {}
+};
+
+class HeadsetSimulator {
+public:
+    enum State {
+        STANDBY,            // dongle waiting for 0xC2
+        SCANNING,           // connect requested, headset not found yet
+        CONNECTED           // streaming
+    };
+
+    /**
+     * @c seed picks the signal phases, eSense walk and fault pattern, so
+     * two simulators with the same seed produce the same bytes.
+     */
+    HeadsetSimulator(uint16_t headsetId, uint64_t seed);
+
+    void setFaults(const SimulatorFaults& f){ faults = f; }
+    /** How long a connect request takes to answer; 100 ms by default. */
+    void setConnectMicros(uint32_t micros){ connectMicros = micros; }
+    /** Starts out streaming, like a MindWave Mobile paired over Bluetooth. */
+    void setConnected(uint64_t micros);
+
+    /** Handles a command byte the host wrote at time @c micros. */
+    void command(unsigned char byte, uint64_t micros);
+
+    /**
+     * Appends to @c out every byte due by @c micros, after faults.  The
+     * first call sets the start of the stream.  Returns the bytes appended.
+     */
+    size_t generate(uint64_t micros, std::vector<unsigned char>& out);
+
+    /** When generate() next has something to do. */
+    uint64_t nextMicros() const;
+
+    State getState() const { return state; }
+    uint16_t getHeadsetId() const { return headsetId; }
+
+    /** Bytes generated, and how many of them the faults dropped or changed */
+    uint64_t getBytesOut() const { return bytesOut; }
+    uint64_t getBytesDropped() const { return bytesDropped; }
+    uint64_t getBytesCorrupted() const { return bytesCorrupted; }
+    uint32_t getBursts() const { return bursts; }
+
+private:
+    void start(uint64_t micros);
+    void packet(const unsigned char *payload, size_t n);
+    void rawPacket();
+    void slowPacket();
+    void dongle(unsigned char code);
+    short sample();
+    uint64_t random();
+    double uniform(){ return (random() >> 11) * (1.0 / 9007199254740992.0); }
+
+    uint16_t headsetId;
+    uint64_t rng;
+    SimulatorFaults faults;
+    uint32_t connectMicros;
+
+    State state;
+    bool started;
+    int commandSkip;        // ID bytes still to come after 0xC0
+    uint64_t nextStandby;
+    uint64_t connectAt;
+    uint64_t streamStart;
+    uint64_t nextRaw;
+    uint64_t nextSlow;
+    uint64_t burstUntil;
+    uint64_t nextBurstCheck;
+
+    // Signal model
+    uint64_t rawIndex;
+    double phase[4];
+    int attention;
+    int meditation;
+
+    std::vector<unsigned char> pending;     // generated, not yet delivered
+    uint64_t bytesOut;
+    uint64_t bytesDropped;
+    uint64_t bytesCorrupted;
+    uint32_t bursts;
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_SIMULATOR_H_ */
@@ -0,0 +1,254 @@
+#include "ThinkGearSpectrum.h"
+#include <math.h>
+#include <stdlib.h>
+#include <map>
+#include <mutex>
+#include <string>
+#ifdef THINKGEAR_HAVE_FFTW
+#include <fftw3.h>
+#endif
+
+namespace thinkgear {
+
+namespace {
+
+const size_t MIN_WINDOW = 8;
+const size_t MAX_WINDOW = 8192;
+
+// Guards the plan cache, and the FFTW planner, which is not thread-safe
+std::mutex planMutex;
+std::map<size_t, FftPlan*> plans;
+std::string wisdomFile;
+
+float *allocFloats(size_t n){
+#ifdef THINKGEAR_HAVE_FFTW
+    return fftwf_alloc_real(n);
+#else
+    void *p = NULL;
+    return posix_memalign(&p, 64, n * sizeof(float)) == 0 ? static_cast<float*>(p) : NULL;
+#endif
+}
+
+void freeFloats(float *p){
+#ifdef THINKGEAR_HAVE_FFTW
+    fftwf_free(p);
+#else
+    free(p);
+#endif
+}
+
+}  // namespace
+
+// A real to complex transform of n points: n floats in, n/2+1 interleaved
+// complex values out.  Made once per size and never freed; execute() may
+// run on any number of threads at once.
+struct FftPlan {
+    size_t n;
+#ifdef THINKGEAR_HAVE_FFTW
+    fftwf_plan plan;
+
+    explicit FftPlan(size_t n) : n(n) {
+        float *in = allocFloats(n);
+        float *out = allocFloats(n + 2);
+        plan = fftwf_plan_dft_r2c_1d((int)n, in, reinterpret_cast<fftwf_complex*>(out),
+                                     FFTW_MEASURE);
+        freeFloats(in);
+        freeFloats(out);
+        if (!wisdomFile.empty())
+            fftwf_export_wisdom_to_filename(wisdomFile.c_str());
+    }
+
+    // Buffers must come from allocFloats(), so they are aligned as planned
+    void execute(float *in, float *out) const {
+        fftwf_execute_dft_r2c(plan, in, reinterpret_cast<fftwf_complex*>(out));
+    }
+#else
+    // The n real points as n/2 complex ones, transformed with a radix-2
+    // FFT, then split into the spectrum of the real input
+    std::vector<uint32_t> reversed;     // bit reversal of n/2
+    std::vector<float> twiddle;         // e^(-2 pi i k/n), k < n/2, interleaved
+
+    explicit FftPlan(size_t n) : n(n), reversed(n/2), twiddle(n) {
+        size_t m = n/2;
+        int bits = 0;
+        while (((size_t)1 << bits) < m)
+            ++bits;
+        for (size_t i=0; i<m; ++i){
+            uint32_t r = 0;
+            for (int b=0; b<bits; ++b)
+                if (i & ((size_t)1 << b))
+                    r |= 1u << (bits - 1 - b);
+            reversed[i] = r;
+        }
+        for (size_t k=0; k<m; ++k){
+            double a = -2 * M_PI * k / n;
+            twiddle[2*k] = (float)cos(a);
+            twiddle[2*k+1] = (float)sin(a);
+        }
+    }
+
+    void execute(float *in, float *out) const {
+        size_t m = n/2;
+        for (size_t i=0; i<m; ++i){
+            out[2*reversed[i]] = in[2*i];
+            out[2*reversed[i]+1] = in[2*i+1];
+        }
+        // The n/2 point transform uses every other twiddle of the n point one
+        for (size_t len=2; len<=m; len*=2){
+            size_t half = len/2;
+            size_t step = 2 * (m/len);
+            for (size_t i=0; i<m; i+=len){
+                for (size_t j=0; j<half; ++j){
+                    float wr = twiddle[2*j*step], wi = twiddle[2*j*step+1];
+                    float *a = out + 2*(i+j);
+                    float *b = out + 2*(i+j+half);
+                    float tr = b[0]*wr - b[1]*wi;
+                    float ti = b[0]*wi + b[1]*wr;
+                    b[0] = a[0] - tr;
+                    b[1] = a[1] - ti;
+                    a[0] += tr;
+                    a[1] += ti;
+                }
+            }
+        }
+        // With Z the half size transform, E = (Z[k] + conj Z[m-k]) / 2 and
+        // O = -i (Z[k] - conj Z[m-k]) / 2: X[k] = E + W^k O and
+        // X[m-k] = conj(E - W^k O)
+        float z0r = out[0], z0i = out[1];
+        out[0] = z0r + z0i;
+        out[1] = 0;
+        out[2*m] = z0r - z0i;
+        out[2*m+1] = 0;
+        for (size_t k=1; k<=m/2; ++k){
+            float ar = out[2*k], ai = out[2*k+1];
+            float br = out[2*(m-k)], bi = -out[2*(m-k)+1];
+            float er = (ar + br) * 0.5f, ei = (ai + bi) * 0.5f;
+            float orr = (ai - bi) * 0.5f, oi = -(ar - br) * 0.5f;
+            float wr = twiddle[2*k], wi = twiddle[2*k+1];
+            float tr = wr*orr - wi*oi, ti = wr*oi + wi*orr;
+            out[2*k] = er + tr;
+            out[2*k+1] = ei + ti;
+            out[2*(m-k)] = er - tr;
+            out[2*(m-k)+1] = -(ei - ti);
+        }
+    }
+#endif
+};
+
+bool setFftWisdomFile(const char *path){
+#ifdef THINKGEAR_HAVE_FFTW
+    std::lock_guard<std::mutex> lock(planMutex);
+    wisdomFile = path;
+    fftwf_import_wisdom_from_filename(path);
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+Stft::Stft()
+    : plan(NULL), window(0), hop(0), frames(0), input(NULL), windowed(NULL), spectrum(NULL),
+      fed(0), nextIndex(0), sinceFrame(0), written(0) {
+}
+
+Stft::~Stft(){
+    release();
+}
+
+void Stft::release(){
+    freeFloats(input);
+    freeFloats(windowed);
+    freeFloats(spectrum);
+    input = windowed = spectrum = NULL;
+    plan = NULL;
+}
+
+bool Stft::setup(size_t window, size_t hop, size_t frames){
+    if (window < MIN_WINDOW || window > MAX_WINDOW || (window & (window-1)) || hop == 0)
+        return false;
+    release();
+    {
+        std::lock_guard<std::mutex> lock(planMutex);
+        FftPlan *&p = plans[window];
+        if (!p)
+            p = new FftPlan(window);
+        plan = p;
+    }
+    this->window = window;
+    this->hop = hop;
+    this->frames = frames > 0 ? frames : 1;
+    input = allocFloats(window);
+    windowed = allocFloats(window);
+    spectrum = allocFloats(window + 2);
+
+    // Periodic Hann, scaled so a sine's bin reads its amplitude
+    coefficients.resize(window);
+    double sum = 0;
+    for (size_t i=0; i<window; ++i){
+        coefficients[i] = (float)(0.5 - 0.5 * cos(2 * M_PI * i / window));
+        sum += coefficients[i];
+    }
+    for (size_t i=0; i<window; ++i)
+        coefficients[i] = (float)(coefficients[i] * 2 / sum);
+
+    magnitudes.assign(this->frames * getBins(), 0.0f);
+    frameEnds.assign(this->frames, 0);
+    written = 0;
+    reset();
+    return true;
+}
+
+void Stft::reset(){
+    fed = 0;
+    sinceFrame = 0;
+}
+
+size_t Stft::feed(const int16_t *samples, size_t count){
+    if (!plan)
+        return 0;
+    uint64_t before = written;
+    for (size_t i=0; i<count; ++i){
+        input[fed & (window-1)] = samples[i];
+        ++fed;
+        ++nextIndex;
+        if (++sinceFrame >= hop && fed >= window){
+            sinceFrame = 0;
+            compute();
+        }
+    }
+    return (size_t)(written - before);
+}
+
+// Transforms the last window samples into the next frame
+void Stft::compute(){
+    size_t start = fed & (window-1);
+    size_t tail = window - start;
+    for (size_t i=0; i<tail; ++i)
+        windowed[i] = input[start + i] * coefficients[i];
+    for (size_t i=tail; i<window; ++i)
+        windowed[i] = input[i - tail] * coefficients[i];
+    plan->execute(windowed, spectrum);
+
+    size_t bins = getBins();
+    float *out = &magnitudes[(written % frames) * bins];
+    for (size_t k=0; k<bins; ++k)
+        out[k] = sqrtf(spectrum[2*k]*spectrum[2*k] + spectrum[2*k+1]*spectrum[2*k+1]);
+    // 0 Hz and the top bin have no mirror image to share their energy with
+    out[0] *= 0.5f;
+    out[bins-1] *= 0.5f;
+    frameEnds[written % frames] = nextIndex;
+    ++written;
+}
+
+const float *Stft::getFrame(uint64_t n) const {
+    if (n >= written || written - n > frames)
+        return NULL;
+    return &magnitudes[(n % frames) * getBins()];
+}
+
+uint64_t Stft::getFrameEnd(uint64_t n) const {
+    return getFrame(n) ? frameEnds[n % frames] : 0;
+}
+
+}  // namespace thinkgear
@@ -0,0 +1,128 @@
+#ifndef THINKGEAR_SPECTRUM_H_
+#define THINKGEAR_SPECTRUM_H_
+
+/**
+ * @file ThinkGearSpectrum.h
+ *
+ * Short-time spectra of the 512 Hz raw stream: every @c hop samples, the
+ * last @c window samples are Hann windowed and transformed, and the
+ * magnitudes go into a ring of preallocated frames.
+ *
+ *     thinkgear::Stft stft;
+ *     stft.setup(256, 64);            // 0.5 s windows, 8 frames a second
+ *     stft.feed(history.raw);         // or feed(samples, count)
+ *     const float *m = stft.getFrame(stft.getFramesWritten() - 1);
+ *     // m[bin] is the amplitude at bin * stft.getBinHz()
+ *
+ * Built with THINKGEAR_HAVE_FFTW (make FFTW=1) the transforms are FFTW
+ * single precision r2c plans, made once per size and shared by every Stft;
+ * setFftWisdomFile() lets later runs skip the planning.  Otherwise a small
+ * built-in real FFT does the same job.  Window lengths must be powers of
+ * two from 8 to 8192 either way.
+ */
+
+#include "ThinkGearHistory.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Raw samples per second of every ThinkGear headset
+#define THINKGEAR_RAW_RATE 512
+
+namespace thinkgear {
+
+/**
+ * Imports FFTW wisdom from @c path, if it exists, and saves it back there
+ * whenever a new plan is made.  Call before the first Stft::setup().
+ * Returns false, doing nothing, without FFTW.
+ */
+bool setFftWisdomFile(const char *path);
+
+struct FftPlan;
+
+class Stft {
+public:
+    Stft();
+    ~Stft();
+
+    /**
+     * Allocates everything for @c window sample windows every @c hop
+     * samples, keeping the last @c frames spectra.  Returns false for a
+     * window that is not a power of two in range, or a hop of 0.  Starts
+     * over if called again.
+     */
+    bool setup(size_t window, size_t hop, size_t frames = 32);
+    bool isSetup() const { return plan != NULL; }
+
+    /** Forgets the samples fed so far; the frames stay. */
+    void reset();
+
+    /** Adds consecutive raw samples; returns the number of new frames. */
+    size_t feed(const int16_t *samples, size_t count);
+
+    /**
+     * Adds whatever @c ring has gained since the last call.  Samples the
+     * ring has already overwritten, or that were overwritten while being
+     * read, make it start over from the newest.
+     */
+    template <size_t N>
+    size_t feed(const HistoryRing<int16_t, N>& ring){
+        typename HistoryRing<int16_t, N>::Span s = ring.since(nextIndex);
+        if (s.start != nextIndex)
+            reset();
+        nextIndex = s.start;
+        size_t before = written;
+        feed(s.first, s.firstCount);
+        feed(s.second, s.secondCount);
+        if (!ring.isIntact(s)){
+            reset();
+            nextIndex = ring.getWritten();
+        }
+        return (size_t)(written - before);
+    }
+
+    size_t getWindow() const { return window; }
+    size_t getHop() const { return hop; }
+    /** Values per frame: window / 2 + 1, from 0 Hz up to 256 Hz */
+    size_t getBins() const { return window / 2 + 1; }
+    float getBinHz() const { return window ? (float)THINKGEAR_RAW_RATE / window : 0; }
+
+    /** Frames computed so far; frame n is available while n + frames > this. */
+    uint64_t getFramesWritten() const { return written; }
+    /**
+     * Amplitudes of frame @c n, in raw units (a full-scale sine of
+     * amplitude A reads about A in its bin), or NULL if it was overwritten
+     * or not computed yet.
+     */
+    const float *getFrame(uint64_t n) const;
+    /** Raw samples fed before the end of frame @c n, to line it up with the raw ring */
+    uint64_t getFrameEnd(uint64_t n) const;
+
+private:
+    Stft(const Stft&);
+    Stft& operator=(const Stft&);
+
+    void release();
+    void compute();
+
+    const FftPlan *plan;
+    size_t window;
+    size_t hop;
+    size_t frames;
+
+    float *input;               // last window samples, circular
+    float *windowed;            // one windowed frame, FFT input
+    float *spectrum;            // FFT output, interleaved complex
+    std::vector<float> coefficients;    // Hann window times the amplitude scale
+    uint64_t fed;               // samples since reset()
+    uint64_t nextIndex;         // stream index expected next, for feed(ring)
+    size_t sinceFrame;          // samples since the last frame
+
+    std::vector<float> magnitudes;      // frames * getBins(), circular
+    std::vector<uint64_t> frameEnds;
+    uint64_t written;
+};
+
+}  // namespace thinkgear
+
+#endif /* THINKGEAR_SPECTRUM_H_ */
@@ -24,6 +24,15 @@
  * library and not already included by this library's header
  */
 #include <stdio.h>
+#include <string.h>
+
+/* Vector versions of the bulk scanning primitives are only built for x86;
+ * everywhere else (including the AVR firmware) the scalar ones are used.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PARSER_X86_SIMD 1
+#include <immintrin.h>
+#endif
 
 /* Decoder states (Packet decoding) */
 #define PARSER_STATE_NULL           0x00  /* NULL state */
@@ -46,6 +55,20 @@ int
 parsePacketPayload( ThinkGearStreamParser *parser );
 int
 parseDataRow( ThinkGearStreamParser *parser, unsigned char *rowPtr );
+static unsigned char
+sumBytes( const unsigned char *bytes, size_t length, unsigned char sum );
+static const unsigned char *
+findSyncPair( const unsigned char *p, const unsigned char *end );
+static void
+resyncPayload( ThinkGearStreamParser *parser );
+static unsigned char
+rowKind( unsigned char extendedCodeLevel, unsigned char code );
+static int
+decodeDataRow( ThinkGearFrame *frame, unsigned char code,
+               unsigned char numBytes, const unsigned char *value );
+static void
+decodeRawRow( ThinkGearStreamParser *parser, unsigned char numBytes,
+              const unsigned char *value );
 
 /*
  * See header file for interface documentation.
@@ -79,6 +102,107 @@ THINKGEAR_initParser( ThinkGearStreamParser *parser,
     parser->handleDataValue = handleDataValueFunc;
     parser->customData = customData;
 
+    /* Plain parsers hand out each DataRow as-is */
+    parser->frame = NULL;
+    parser->handleFrame = NULL;
+
+    /* Failed Packets are dropped unless THINKGEAR_setResync() is called */
+    parser->resync = 0;
+    parser->replaying = 0;
+    parser->recovering = 0;
+
+    memset( &parser->stats, 0, sizeof(parser->stats) );
+
+    /* Raw samples only go to a ring if THINKGEAR_setRawRing() is called */
+    parser->rawRing = NULL;
+    parser->rawRingMask = 0;
+    parser->rawRingHead = 0;
+
+    return( 0 );
+}
+
+/*
+ * See header file for interface documentation.
+ */
+int
+THINKGEAR_initFrameParser( ThinkGearStreamParser *parser,
+                           ThinkGearFrame *frame,
+                           void (*handleFrameFunc)(
+                               const ThinkGearFrame *frame,
+                               void *customData),
+                           void (*handleDataValueFunc)(
+                               unsigned char extendedCodeLevel,
+                               unsigned char code, unsigned char numBytes,
+                               const unsigned char *value, void *customData),
+                           void *customData ) {
+
+    if( !parser ) return( -1 );
+    if( !frame ) return( -3 );
+
+    THINKGEAR_initParser( parser, PARSER_TYPE_PACKETS, handleDataValueFunc,
+                          customData );
+
+    memset( frame, 0, sizeof(*frame) );
+    parser->frame = frame;
+    parser->handleFrame = handleFrameFunc;
+
+    return( 0 );
+}
+
+/*
+ * See header file for interface documentation.
+ */
+int
+THINKGEAR_setResync( ThinkGearStreamParser *parser, unsigned char enable ) {
+
+    if( !parser ) return( -1 );
+
+    parser->resync = enable ? 1 : 0;
+
+    return( 0 );
+}
+
+/*
+ * See header file for interface documentation.
+ */
+int
+THINKGEAR_setRawRing( ThinkGearStreamParser *parser, int16_t *ring,
+                      uint16_t size ) {
+
+    if( !parser ) return( -1 );
+    if( ring && (size == 0 || (size & (size-1))) ) return( -2 );
+
+    parser->rawRing = ring;
+    parser->rawRingMask = ring ? (uint16_t)(size-1) : 0;
+    parser->rawRingHead = 0;
+
+    return( 0 );
+}
+
+/*
+ * See header file for interface documentation.
+ */
+int
+THINKGEAR_getStats( const ThinkGearStreamParser *parser,
+                    ThinkGearParserStats *stats ) {
+
+    if( !parser || !stats ) return( -1 );
+
+    *stats = parser->stats;
+
+    return( 0 );
+}
+
+/*
+ * See header file for interface documentation.
+ */
+int
+THINKGEAR_resetStats( ThinkGearStreamParser *parser ) {
+
+    if( !parser ) return( -1 );
+
+    memset( &parser->stats, 0, sizeof(parser->stats) );
+
     return( 0 );
 }
 
@@ -89,9 +213,16 @@ int
 THINKGEAR_parseByte( ThinkGearStreamParser *parser, unsigned char byte ) {
 
     int returnValue = 0;
+    uint32_t n;
 
     if( !parser ) return( -1 );
 
+    /* Bytes replayed by resyncPayload() were already counted */
+    if( !parser->replaying ) {
+        parser->stats.bytesIn++;
+        parser->stats.gapBytes++;
+    }
+
     /* Pick handling according to current state... */
     switch( parser->state ) {
 
@@ -99,6 +230,8 @@ THINKGEAR_parseByte( ThinkGearStreamParser *parser, unsigned char byte ) {
         case( PARSER_STATE_SYNC ):
             if( byte == PARSER_SYNC_BYTE ) {
                 parser->state = PARSER_STATE_SYNC_CHECK;
+            } else {
+                parser->stats.syncSkipped++;
             }
             break;
 
@@ -108,6 +241,9 @@ THINKGEAR_parseByte( ThinkGearStreamParser *parser, unsigned char byte ) {
                 parser->state = PARSER_STATE_PAYLOAD_LENGTH;
             } else {
                 parser->state = PARSER_STATE_SYNC;
+                parser->recovering = 0;
+                /* Both the lone SyncByte and this byte were noise */
+                parser->stats.syncSkipped += 2;
             }
             break;
 
@@ -116,8 +252,11 @@ THINKGEAR_parseByte( ThinkGearStreamParser *parser, unsigned char byte ) {
             parser->payloadLength = byte;
             if( parser->payloadLength > 170 ) {
                 parser->state = PARSER_STATE_SYNC;
+                parser->recovering = 0;
+                parser->stats.oversizeLength++;
                 returnValue = -3;
             } else if( parser->payloadLength == 170 ) {
+                parser->stats.oversizeLength++;
                 returnValue = -4;
             } else {
                 parser->payloadBytesReceived = 0;
@@ -141,8 +280,28 @@ THINKGEAR_parseByte( ThinkGearStreamParser *parser, unsigned char byte ) {
             parser->state = PARSER_STATE_SYNC;
             if( parser->chksum != ((~parser->payloadSum)&0xFF) ) {
                 returnValue = -2;
+                parser->recovering = 0;
+                parser->stats.checksumFailures++;
+                if( parser->resync && !parser->replaying ) {
+                    resyncPayload( parser );
+                }
             } else {
                 returnValue = 1;
+                if( parser->recovering ) {
+                    parser->stats.packetsRecovered++;
+                    parser->recovering = 0;
+                }
+                parser->stats.packetsOk++;
+
+                /* Everything but this Packet's own header, PLENGTH,
+                 * Payload[] and CHKSUM was lost or noise */
+                n = (uint32_t)parser->payloadLength + 4;
+                if( parser->stats.gapBytes > n &&
+                    parser->stats.gapBytes - n > parser->stats.maxGapBytes ) {
+                    parser->stats.maxGapBytes = parser->stats.gapBytes - n;
+                }
+                parser->stats.gapBytes = 0;
+
                 parsePacketPayload( parser );
             }
             break;
@@ -195,6 +354,342 @@ THINKGEAR_parseByte( ThinkGearStreamParser *parser, unsigned char byte ) {
     return( returnValue );
 }
 
+/**
+ * Counts @c n bytes that THINKGEAR_parseBuffer() consumed without going
+ * through THINKGEAR_parseByte().
+ */
+static void
+countBytes( ThinkGearStreamParser *parser, size_t n ) {
+
+    parser->stats.bytesIn += (uint32_t)n;
+    parser->stats.gapBytes += (uint32_t)n;
+}
+
+/*
+ * See header file for interface documentation.
+ */
+int
+THINKGEAR_parseBuffer( ThinkGearStreamParser *parser,
+                       const unsigned char *buffer, size_t length ) {
+
+    const unsigned char *p = buffer;
+    const unsigned char *end = buffer + length;
+    const unsigned char *sync;
+    size_t n = 0;
+    uint32_t packetsOk;
+
+    if( !parser ) return( -1 );
+    if( !buffer || !length ) return( 0 );
+
+    /* Counted from the stats, so Packets recovered by resync count too */
+    packetsOk = parser->stats.packetsOk;
+
+    while( p < end ) {
+
+        /* Only the hunt for SyncBytes and the Payload[] body are worth
+         * handling in bulk; every other state consumes a single byte.
+         */
+        switch( parser->state ) {
+
+            /* Skip straight past the next pair of SyncBytes.  The byte
+             * state machine always locks onto the first such pair, and
+             * a lone SyncByte at the very end leaves it in SYNC_CHECK.
+             */
+            case( PARSER_STATE_SYNC ):
+                sync = findSyncPair( p, end );
+                if( !sync ) {
+                    n = (size_t)(end - p);
+                    countBytes( parser, n );
+                    if( end[-1] == PARSER_SYNC_BYTE ) {
+                        parser->state = PARSER_STATE_SYNC_CHECK;
+                        n--;
+                    }
+                    parser->stats.syncSkipped += (uint32_t)n;
+                    p = end;
+                } else {
+                    countBytes( parser, (size_t)(sync+2 - p) );
+                    parser->stats.syncSkipped += (uint32_t)(sync - p);
+                    parser->state = PARSER_STATE_PAYLOAD_LENGTH;
+                    p = sync+2;
+                }
+                break;
+
+            /* Copy as much of the Payload[] as is available in one shot */
+            case( PARSER_STATE_PAYLOAD ):
+                n = (size_t)(parser->payloadLength -
+                             parser->payloadBytesReceived);
+                if( n == 0 ) {
+                    /* Zero-length Payload still swallows one byte */
+                    THINKGEAR_parseByte( parser, *p++ );
+                    break;
+                }
+                if( n > (size_t)(end - p) ) n = (size_t)(end - p);
+                countBytes( parser, n );
+                memcpy( parser->payload + parser->payloadBytesReceived, p, n );
+                parser->payloadSum = sumBytes( p, n, parser->payloadSum );
+                parser->payloadBytesReceived =
+                    (unsigned char)(parser->payloadBytesReceived + n);
+                if( parser->payloadBytesReceived >= parser->payloadLength ) {
+                    parser->state = PARSER_STATE_CHKSUM;
+                }
+                p += n;
+                break;
+
+            default:
+                THINKGEAR_parseByte( parser, *p++ );
+                break;
+        }
+    }
+
+    /* Keep lastByte consistent with byte-at-a-time parsing */
+    parser->lastByte = end[-1];
+
+    return( (int)(parser->stats.packetsOk - packetsOk) );
+}
+
+/**
+ * Called after a checksum failure.  When bytes are dropped on the link,
+ * the failed Packet's Payload[] often swallowed the header of the next
+ * Packet, so instead of discarding the buffered bytes, scan them (and the
+ * CHKSUM byte) for a pair of SyncBytes and replay everything after it
+ * through the state machine.
+ *
+ * Each replayed byte is stored at a lower payload[] index than the one
+ * it is read from, so the replay can run in place.  If a replayed Packet
+ * fails as well, its own bytes and the rest of the buffer are rescanned,
+ * which always shrinks the buffer, so this terminates without recursion.
+ */
+static void
+resyncPayload( ThinkGearStreamParser *parser ) {
+
+    unsigned int length = parser->payloadLength;
+    unsigned int i = 0;
+    unsigned int n;
+
+    parser->payload[length++] = parser->chksum;
+    parser->replaying = 1;
+
+    while( i+1 < length ) {
+
+        /* Hunt for a header */
+        if( parser->payload[i] != PARSER_SYNC_BYTE ||
+            parser->payload[i+1] != PARSER_SYNC_BYTE ) {
+            i++;
+            continue;
+        }
+
+        parser->stats.resyncs++;
+        parser->state = PARSER_STATE_PAYLOAD_LENGTH;
+        parser->recovering = 1;
+
+        for( i += 2; i < length; i++ ) {
+            if( THINKGEAR_parseByte( parser, parser->payload[i] ) == -2 ) {
+                break;
+            }
+        }
+        if( i >= length ) {
+            /* Everything was replayed; the parser carries on from here */
+            parser->replaying = 0;
+            return;
+        }
+
+        /* The replayed Packet failed too: rescan its bytes, then the rest */
+        n = parser->payloadLength;
+        parser->payload[n] = parser->chksum;
+        memmove( parser->payload + n+1, parser->payload + i+1, length - (i+1) );
+        length = n+1 + length - (i+1);
+        i = 0;
+    }
+
+    /* No header, but a trailing SyncByte may still start one */
+    if( parser->payload[length-1] == PARSER_SYNC_BYTE ) {
+        parser->state = PARSER_STATE_SYNC_CHECK;
+        parser->recovering = 1;
+    }
+    parser->replaying = 0;
+}
+
+/*
+ * Bulk scanning primitives.  Each has a scalar version that works
+ * everywhere, and on x86 SSE2 and AVX2 versions; the fastest one the CPU
+ * supports is picked the first time it is needed.
+ */
+
+/**
+ * Returns the sum of the @c length bytes at @c bytes.
+ */
+static unsigned int
+sumBytesScalar( const unsigned char *bytes, size_t length ) {
+
+    unsigned int total = 0;
+    size_t i;
+
+    for( i=0; i<length; i++ ) total += bytes[i];
+
+    return( total );
+}
+
+/**
+ * Returns the first position in [@c p, @c end) holding two consecutive
+ * SyncBytes, or NULL if there is none.
+ */
+static const unsigned char *
+findSyncPairScalar( const unsigned char *p, const unsigned char *end ) {
+
+    while( p < end ) {
+        p = memchr( p, PARSER_SYNC_BYTE, (size_t)(end - p) );
+        if( !p || p+1 >= end ) return( NULL );
+        if( p[1] == PARSER_SYNC_BYTE ) return( p );
+        /* p[1] is not a SyncByte, so it cannot start a pair either */
+        p += 2;
+    }
+
+    return( NULL );
+}
+
+#ifdef PARSER_X86_SIMD
+
+__attribute__((target("sse2")))
+static unsigned int
+sumBytesSse2( const unsigned char *bytes, size_t length ) {
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    size_t i = 0;
+
+    /* psadbw against zero adds up 8 bytes into each 64-bit lane */
+    for( ; i+16 <= length; i += 16 ) {
+        __m128i v = _mm_loadu_si128( (const __m128i *)(bytes+i) );
+        acc = _mm_add_epi64( acc, _mm_sad_epu8( v, zero ) );
+    }
+    acc = _mm_add_epi64( acc, _mm_unpackhi_epi64( acc, acc ) );
+
+    return( (unsigned int)_mm_cvtsi128_si32( acc ) +
+            sumBytesScalar( bytes+i, length-i ) );
+}
+
+__attribute__((target("sse2")))
+static const unsigned char *
+findSyncPairSse2( const unsigned char *p, const unsigned char *end ) {
+
+    __m128i sync = _mm_set1_epi8( (char)PARSER_SYNC_BYTE );
+
+    /* Compare each byte and its successor in one pass; needs 17 bytes */
+    while( end - p > 16 ) {
+        __m128i a = _mm_loadu_si128( (const __m128i *)p );
+        __m128i b = _mm_loadu_si128( (const __m128i *)(p+1) );
+        int mask = _mm_movemask_epi8(
+            _mm_and_si128( _mm_cmpeq_epi8( a, sync ),
+                           _mm_cmpeq_epi8( b, sync ) ) );
+        if( mask ) return( p + __builtin_ctz( (unsigned int)mask ) );
+        p += 16;
+    }
+
+    return( findSyncPairScalar( p, end ) );
+}
+
+__attribute__((target("avx2")))
+static unsigned int
+sumBytesAvx2( const unsigned char *bytes, size_t length ) {
+
+    __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    __m128i half;
+    unsigned int total;
+    size_t i = 0;
+
+    for( ; i+32 <= length; i += 32 ) {
+        __m256i v = _mm256_loadu_si256( (const __m256i *)(bytes+i) );
+        acc = _mm256_add_epi64( acc, _mm256_sad_epu8( v, zero ) );
+    }
+    half = _mm_add_epi64( _mm256_castsi256_si128( acc ),
+                          _mm256_extracti128_si256( acc, 1 ) );
+    half = _mm_add_epi64( half, _mm_unpackhi_epi64( half, half ) );
+    total = (unsigned int)_mm_cvtsi128_si32( half );
+
+    /* Leave the upper halves clean so later SSE code pays no penalty */
+    _mm256_zeroupper();
+
+    return( total + sumBytesScalar( bytes+i, length-i ) );
+}
+
+__attribute__((target("avx2")))
+static const unsigned char *
+findSyncPairAvx2( const unsigned char *p, const unsigned char *end ) {
+
+    __m256i sync = _mm256_set1_epi8( (char)PARSER_SYNC_BYTE );
+
+    while( end - p > 32 ) {
+        __m256i a = _mm256_loadu_si256( (const __m256i *)p );
+        __m256i b = _mm256_loadu_si256( (const __m256i *)(p+1) );
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+            _mm256_and_si256( _mm256_cmpeq_epi8( a, sync ),
+                              _mm256_cmpeq_epi8( b, sync ) ) );
+        if( mask ) {
+            _mm256_zeroupper();
+            return( p + __builtin_ctz( mask ) );
+        }
+        p += 32;
+    }
+    _mm256_zeroupper();
+
+    return( findSyncPairScalar( p, end ) );
+}
+
+#endif /* PARSER_X86_SIMD */
+
+/* The primitives in use; NULL until selectBulkOps() has run */
+static unsigned int
+(*sumBytesImpl)( const unsigned char *bytes, size_t length ) = NULL;
+static const unsigned char *
+(*findSyncPairImpl)( const unsigned char *p, const unsigned char *end ) = NULL;
+
+/**
+ * Picks the fastest bulk primitives this CPU supports.  Racing callers
+ * all store the same pointers, so no locking is needed.
+ */
+static void
+selectBulkOps( void ) {
+
+    sumBytesImpl = sumBytesScalar;
+    findSyncPairImpl = findSyncPairScalar;
+
+#ifdef PARSER_X86_SIMD
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx2" ) ) {
+        sumBytesImpl = sumBytesAvx2;
+        findSyncPairImpl = findSyncPairAvx2;
+    } else if( __builtin_cpu_supports( "sse2" ) ) {
+        sumBytesImpl = sumBytesSse2;
+        findSyncPairImpl = findSyncPairSse2;
+    }
+#endif
+}
+
+/**
+ * Returns @c sum plus the sum of the @c length bytes at @c bytes,
+ * modulo 256.
+ */
+static unsigned char
+sumBytes( const unsigned char *bytes, size_t length, unsigned char sum ) {
+
+    if( !sumBytesImpl ) selectBulkOps();
+
+    return( (unsigned char)(sum + sumBytesImpl( bytes, length )) );
+}
+
+/**
+ * Returns the first position in [@c p, @c end) holding two consecutive
+ * SyncBytes, or NULL if there is none.
+ */
+static const unsigned char *
+findSyncPair( const unsigned char *p, const unsigned char *end ) {
+
+    if( !findSyncPairImpl ) selectBulkOps();
+
+    return( findSyncPairImpl( p, end ) );
+}
+
 /**
  * Parses each row of data from the @c packet's Data[] block,
  * updating the fields of @c data as appropriate.
@@ -202,16 +697,25 @@ THINKGEAR_parseByte( ThinkGearStreamParser *parser, unsigned char byte ) {
 int
 parsePacketPayload( ThinkGearStreamParser *parser ) {
 
-    unsigned char i = 0;
+    unsigned int i = 0;
     unsigned char extendedCodeLevel = 0;
     unsigned char code = 0;
     unsigned char numBytes = 0;
+    ThinkGearFrame *frame = parser->frame;
+
+    /* Start a fresh frame; values not in this Packet keep their last value */
+    if( frame ) {
+        frame->present = 0;
+        frame->numRaw = 0;
+    }
 
     /* Parse all bytes from the payload[] */
     while( i < parser->payloadLength ) {
 
         /* Parse possible EXtended CODE bytes */
-        while( parser->payload[i] == PARSER_EXCODE_BYTE ) {
+        extendedCodeLevel = 0;
+        while( i < parser->payloadLength &&
+               parser->payload[i] == PARSER_EXCODE_BYTE ) {
             extendedCodeLevel++;
             i++;
         }
@@ -223,13 +727,162 @@ parsePacketPayload( ThinkGearStreamParser *parser ) {
         if( code >= 0x80 ) numBytes = parser->payload[i++];
         else               numBytes = 1;
 
-        /* Call the callback function to handle the DataRow value */
-        if( parser->handleDataValue ) {
+        /* Stop at a DataRow that would run past the end of the Payload */
+        if( i + numBytes > parser->payloadLength ) break;
+
+        parser->stats.rows[rowKind( extendedCodeLevel, code )]++;
+
+        /* Decode the DataRow into the frame, or else call the callback
+         * function to handle the DataRow value
+         */
+        if( extendedCodeLevel == 0 && code == PARSER_CODE_RAW_SIGNAL &&
+            numBytes >= 2 && !(numBytes & 1) &&
+            (frame || parser->rawRing) ) {
+            decodeRawRow( parser, numBytes, parser->payload+i );
+        } else if( frame && extendedCodeLevel == 0 &&
+            decodeDataRow( frame, code, numBytes, parser->payload+i ) ) {
+            /* Decoded */
+        } else if( parser->handleDataValue ) {
             parser->handleDataValue( extendedCodeLevel, code, numBytes,
                                      parser->payload+i, parser->customData );
         }
-        i = (unsigned char)(i + numBytes);
+        i += numBytes;
+    }
+
+    /* Hand the whole decoded Packet over in a single call */
+    if( frame && parser->handleFrame ) {
+        parser->handleFrame( frame, parser->customData );
     }
 
     return( 0 );
 }
+
+/**
+ * Returns the ThinkGearParserStats.rows[] index that counts DataRows with
+ * this @c code.
+ */
+static unsigned char
+rowKind( unsigned char extendedCodeLevel, unsigned char code ) {
+
+    if( extendedCodeLevel ) return( THINKGEAR_ROWS_EXTENDED );
+
+    switch( code ) {
+        case( PARSER_CODE_BATTERY ):        return( THINKGEAR_ROWS_BATTERY );
+        case( PARSER_CODE_POOR_QUALITY ):   return( THINKGEAR_ROWS_POOR_SIGNAL );
+        case( PARSER_CODE_ATTENTION ):      return( THINKGEAR_ROWS_ATTENTION );
+        case( PARSER_CODE_MEDITATION ):     return( THINKGEAR_ROWS_MEDITATION );
+        case( PARSER_CODE_BLINK_STRENGTH ): return( THINKGEAR_ROWS_BLINK );
+        case( PARSER_CODE_RAW_SIGNAL ):     return( THINKGEAR_ROWS_RAW );
+        case( PARSER_CODE_EEG_POWERS ):
+        case( PARSER_CODE_ASIC_EEG_POWER_INT ):
+                                            return( THINKGEAR_ROWS_EEG_POWER );
+        case( PARSER_CODE_HEADSET_CONNECTED ):
+        case( PARSER_CODE_HEADSET_NOT_FOUND ):
+        case( PARSER_CODE_HEADSET_DISCONNECTED ):
+        case( PARSER_CODE_REQUEST_DENIED ):
+        case( PARSER_CODE_DONGLE_STANDBY ):
+                                            return( THINKGEAR_ROWS_DONGLE );
+        default:                            return( THINKGEAR_ROWS_OTHER );
+    }
+}
+
+/**
+ * Decodes the 16-bit big-endian two's complement samples of a raw DataRow
+ * of even length @c numBytes into the raw ring and the frame, if set.
+ */
+static void
+decodeRawRow( ThinkGearStreamParser *parser, unsigned char numBytes,
+              const unsigned char *value ) {
+
+    ThinkGearFrame *frame = parser->frame;
+    int16_t *ring = parser->rawRing;
+    uint16_t mask = parser->rawRingMask;
+    uint16_t head = parser->rawRingHead;
+    const unsigned char *end = value + numBytes;
+    int16_t sample;
+
+    parser->stats.rawSamples += numBytes >> 1;
+
+    if( ring ) {
+        for( ; value < end; value += 2 ) {
+            ring[head++ & mask] = (int16_t)(((uint16_t)value[0] << 8) |
+                                            value[1]);
+        }
+        parser->rawRingHead = head;
+        value = end - numBytes;
+    }
+
+    if( frame ) {
+        for( ; value < end; value += 2 ) {
+            if( frame->numRaw >= THINKGEAR_FRAME_MAX_RAW ) break;
+            sample = (int16_t)(((uint16_t)value[0] << 8) | value[1]);
+            frame->raw[frame->numRaw++] = sample;
+        }
+        frame->present |= THINKGEAR_FRAME_RAW;
+    }
+}
+
+/**
+ * Decodes a single non-extended DataRow into the @c frame.
+ *
+ * @return 1 if the DataRow was decoded.
+ * @return 0 if the CODE or its length is not recognized.
+ */
+static int
+decodeDataRow( ThinkGearFrame *frame, unsigned char code,
+               unsigned char numBytes, const unsigned char *value ) {
+
+    unsigned char i;
+
+    switch( code ) {
+
+        case( PARSER_CODE_BATTERY ):
+            frame->battery = value[0];
+            frame->present |= THINKGEAR_FRAME_BATTERY;
+            return( 1 );
+
+        case( PARSER_CODE_POOR_QUALITY ):
+            frame->poorSignal = value[0];
+            frame->present |= THINKGEAR_FRAME_POOR_SIGNAL;
+            return( 1 );
+
+        case( PARSER_CODE_ATTENTION ):
+            frame->attention = value[0];
+            frame->present |= THINKGEAR_FRAME_ATTENTION;
+            return( 1 );
+
+        case( PARSER_CODE_MEDITATION ):
+            frame->meditation = value[0];
+            frame->present |= THINKGEAR_FRAME_MEDITATION;
+            return( 1 );
+
+        case( PARSER_CODE_BLINK_STRENGTH ):
+            frame->blinkStrength = value[0];
+            frame->present |= THINKGEAR_FRAME_BLINK;
+            return( 1 );
+
+        /* Eight 24-bit big-endian unsigned band powers */
+        case( PARSER_CODE_ASIC_EEG_POWER_INT ):
+            if( numBytes != 3*THINKGEAR_EEG_BANDS ) return( 0 );
+            for( i=0; i<THINKGEAR_EEG_BANDS; i++ ) {
+                frame->eegPower[i] = ((uint32_t)value[0] << 16) |
+                                     ((uint32_t)value[1] << 8) |
+                                      (uint32_t)value[2];
+                value += 3;
+            }
+            frame->present |= THINKGEAR_FRAME_EEG_POWER;
+            return( 1 );
+
+        case( PARSER_CODE_HEADSET_CONNECTED ):
+        case( PARSER_CODE_HEADSET_NOT_FOUND ):
+        case( PARSER_CODE_HEADSET_DISCONNECTED ):
+        case( PARSER_CODE_REQUEST_DENIED ):
+        case( PARSER_CODE_DONGLE_STANDBY ):
+            frame->dongleStatus = code;
+            frame->present |= THINKGEAR_FRAME_DONGLE;
+            return( 1 );
+
+        default:
+            return( 0 );
+    }
+}
@@ -1,108 +1,240 @@
 #include "ofxThinkgear.h"
+#include "ofUtils.h"
+#include <algorithm>
 
-void tgHandleDataValueFunc( unsigned char extendedCodeLevel, unsigned char code, unsigned char valueLength, const unsigned char *value, void *customData){
+// Time between raw samples at 512 Hz, in us
+static const double RAW_PERIOD_MICROS = 1e6 / 512;
+
+void tgHandleFrameFunc(const ThinkGearFrame& frame, uint64_t micros, void *customData){
     ofxThinkgear& tg = *reinterpret_cast<ofxThinkgear*>(customData);
-    if (extendedCodeLevel == 0){
-        switch (code) {
-            case 0x01:
-                tg.values.power = value[0] & 0xff;
-                ofNotifyEvent(tg.onPower, tg.values);
-                break;
-            case 0x02:
-                tg.values.poorSignal = value[0] & 0xff;
-                ofNotifyEvent(tg.onPoorSignal, tg.values);
-                break;
-            case 0x04:
-                tg.values.attention = value[0] & 0xff;
-                ofNotifyEvent(tg.onAttention, tg.values);
-                break;
-            case 0x05:
-                tg.values.meditation = value[0] & 0xff;
-                ofNotifyEvent(tg.onMeditation, tg.values);
-                break;
-            case 0x16:
-                tg.values.blinkStrength = value[0] & 0xff;
-                ofNotifyEvent(tg.onBlinkStrength, tg.values);
-            case( 0xd4 ):
-                // printf("Standby... autoconnecting\n");
-                ofNotifyEvent(tg.onConnecting, tg.values);
-                tg.device.writeByte(0xc2);
+    tg.dispatchFrame(&frame, micros + tg.clockOffset);
+}
+
+// Delivers a decoded packet as events, on the thread that calls update()
+void ofxThinkgear::dispatchFrame(const ThinkGearFrame *frame, unsigned long long micros){
+    if (frame->present & THINKGEAR_FRAME_BATTERY)
+        values.power = frame->battery;
+    if (frame->present & THINKGEAR_FRAME_POOR_SIGNAL)
+        values.poorSignal = frame->poorSignal;
+    if (frame->present & THINKGEAR_FRAME_ATTENTION)
+        values.attention = frame->attention;
+    if (frame->present & THINKGEAR_FRAME_MEDITATION)
+        values.meditation = frame->meditation;
+    if (frame->present & THINKGEAR_FRAME_BLINK)
+        values.blinkStrength = frame->blinkStrength;
+    unsigned long rawTotal = (unsigned long)history.raw.getWritten();
+    history.add(*frame, micros);
+    if (frame->present & THINKGEAR_FRAME_RAW){
+        size_t blockLimit = rawBlockSize ? rawBlockSize : THINKGEAR_RAW_HISTORY;
+        for (int i=0; i<frame->numRaw; ++i){
+            short sample = frame->raw[i];
+            if (rawBlockArgs.count == 0){
+                // The last sample of the packet arrived at micros
+                rawBlockArgs.startIndex = rawTotal + i;
+                rawBlockArgs.time = micros - (unsigned long long)((frame->numRaw - 1 - i) * RAW_PERIOD_MICROS);
+            }
+            rawBlock[rawBlockArgs.count++] = sample;
+            if (rawBlockArgs.count >= blockLimit)
+                flushRawBlock();
+        }
+        values.raw = frame->raw[frame->numRaw-1];
+        values.numRaw = frame->numRaw;
+    }
+    if (frame->present & THINKGEAR_FRAME_EEG_POWER){
+        values.eegDelta = frame->eegPower[EEG_DELTA];
+        values.eegTheta = frame->eegPower[EEG_THETA];
+        values.eegLowAlpha = frame->eegPower[EEG_LOW_ALPHA];
+        values.eegHighAlpha = frame->eegPower[EEG_HIGH_ALPHA];
+        values.eegLowBeta = frame->eegPower[EEG_LOW_BETA];
+        values.eegHighBeta = frame->eegPower[EEG_HIGH_BETA];
+        values.eegLowGamma = frame->eegPower[EEG_LOW_GAMMA];
+        values.eegMidGamma = frame->eegPower[EEG_MID_GAMMA];
+    }
+
+    // One event for everything the packet carried
+    values.changed = frame->present & ~THINKGEAR_FRAME_DONGLE;
+    if (values.changed)
+        ofNotifyEvent(onPacket, values);
+
+    if (legacyEvents){
+        if (values.changed & THINKGEAR_FRAME_BATTERY)
+            ofNotifyEvent(onPower, values);
+        if (values.changed & THINKGEAR_FRAME_POOR_SIGNAL)
+            ofNotifyEvent(onPoorSignal, values);
+        if (values.changed & THINKGEAR_FRAME_ATTENTION)
+            ofNotifyEvent(onAttention, values);
+        if (values.changed & THINKGEAR_FRAME_MEDITATION)
+            ofNotifyEvent(onMeditation, values);
+        if (values.changed & THINKGEAR_FRAME_BLINK)
+            ofNotifyEvent(onBlinkStrength, values);
+        if (values.changed & THINKGEAR_FRAME_RAW)
+            ofNotifyEvent(onRaw, values);
+        if (values.changed & THINKGEAR_FRAME_EEG_POWER)
+            ofNotifyEvent(onEeg, values);
+    }
+
+    // The dongle repeats its status several times a second; report changes
+    if ((frame->present & THINKGEAR_FRAME_DONGLE) && frame->dongleStatus != dongleStatus){
+        dongleStatus = frame->dongleStatus;
+        switch (frame->dongleStatus) {
+            case PARSER_CODE_DONGLE_STANDBY:
+                ofNotifyEvent(onConnecting, values);
                 break;
-            case( 0xd0 ):
-                ofNotifyEvent(tg.onReady, tg.values);
+            case PARSER_CODE_HEADSET_CONNECTED:
+                ofNotifyEvent(onReady, values);
                 break;
-            case( 0xd1 ):
+            case PARSER_CODE_HEADSET_NOT_FOUND:
                 {
                     ofMessage err("Headset not found");
-                    ofNotifyEvent(tg.onError, err);
+                    ofNotifyEvent(onError, err);
                 }
                 break;
-            case 0x80:
-                tg.values.raw = (value[0] << 8) | value[1];
-                break;
-            case 0x83:
-                {
-                    int pos = 0;
-                    tg.values.eegDelta = (value[pos] << 16) | (value[pos+1] << 8) | (value[pos+2]); pos += 3;
-                    tg.values.eegTheta = (value[pos] << 16) | (value[pos+1] << 8) | (value[pos+2]); pos += 3;
-                    tg.values.eegLowAlpha = (value[pos] << 16) | (value[pos+1] << 8) | (value[pos+2]); pos += 3;
-                    tg.values.eegHighAlpha = (value[pos] << 16) | (value[pos+1] << 8) | (value[pos+2]); pos += 3;
-                    tg.values.eegLowBeta = (value[pos] << 16) | (value[pos+1] << 8) | (value[pos+2]); pos += 3;
-                    tg.values.eegHighBeta = (value[pos] << 16) | (value[pos+1] << 8) | (value[pos+2]); pos += 3;
-                    tg.values.eegLowGamma = (value[pos] << 16) | (value[pos+1] << 8) | (value[pos+2]); pos += 3;
-                    tg.values.eegMidGamma = (value[pos] << 16) | (value[pos+1] << 8) | (value[pos+2]); pos += 3;
-                    ofNotifyEvent(tg.onEeg, tg.values);
-                    break;
-                }
-            /* Other [CODE]s */
             default:
-                printf( "EXCODE level: %d CODE: 0x%02X vLength: %d\n", extendedCodeLevel, code, valueLength );
-                printf( "Data value(s):" );
-                for( int i=0; i<valueLength; i++ ) printf( " %02X", value[i] & 0xFF );
-                printf( "\n" );
                 break;
         }
     }
 }
 
+ofxThinkgear::ofxThinkgear()
+    : isReady(false), legacyEvents(false), port(THINKGEAR_PORT), nextOpen(0), dongleStatus(0),
+      filterIndex(0), rawBlockSize(0) {
+    rawBlockArgs.samples = rawBlock;
+    rawBlockArgs.count = 0;
+    rawBlockArgs.startIndex = 0;
+    rawBlockArgs.time = 0;
+    clockOffset = (long long)ofGetElapsedTimeMicros() - (long long)thinkgear::Headset::nowMicros();
+    headset.setFrameCallback(tgHandleFrameFunc, this);
+    log = NULL;
+}
+
+// DataRows the frame decoder does not recognize go to stderr, off the
+// reading thread and sampled when they repeat, on a channel named after
+// the port.  Made when the port is first opened and again after setPort(),
+// while the headset is not reading, as it writes to the channel.
+void ofxThinkgear::openLog(){
+    if (log && log->getName() == port)
+        return;
+    headset.setLog(NULL);
+    thinkgear::AsyncLog::shared().removeChannel(log);
+    log = thinkgear::AsyncLog::shared().addChannel(port);
+    headset.setLog(log);
+}
+
+void ofxThinkgear::setRawBlockSize(size_t size){
+    rawBlockSize = size < THINKGEAR_RAW_HISTORY ? size : THINKGEAR_RAW_HISTORY;
+    if (rawBlockSize && rawBlockArgs.count >= rawBlockSize)
+        flushRawBlock();
+}
 
-ofxThinkgear::ofxThinkgear() : isReady(false) {
+void ofxThinkgear::flushRawBlock(){
+    if (rawBlockArgs.count == 0)
+        return;
+    ofNotifyEvent(onRawBlock, rawBlockArgs);
+    rawBlockArgs.count = 0;
 }
 
 ofxThinkgear::~ofxThinkgear(){
     close();
+    thinkgear::AsyncLog::shared().removeChannel(log);
 }
 
 void ofxThinkgear::close(){
-    if (isReady){
-        device.writeByte(0xC1);
-        device.flush();
-        device.close();
+    headset.close();
+    isReady = false;
+    dongleStatus = 0;
+}
+
+void ofxThinkgear::startThread(){
+    if (headset.isThreaded())
+        return;
+    openLog();
+    headset.startThread(port.c_str(), THINKGEAR_BAUD, THINKGEAR_RETRY_MILLIS);
+}
+
+bool ofxThinkgear::open(){
+    if (!headset.isThreaded() && !headset.isOpen()){
+        openLog();
+        headset.open(port.c_str(), THINKGEAR_BAUD);
     }
+    isReady = headset.isOpen();
+    return isReady;
 }
 
 void ofxThinkgear::update(){
-    if (!isReady){
-        if (device.setup(THINKGEAR_PORT, THINKGEAR_BAUD)){
-            device.flush();
-            THINKGEAR_initParser(&parser, PARSER_TYPE_PACKETS, tgHandleDataValueFunc, this);
-            isReady = true;
+    if (headset.isThreaded()){
+        isReady = headset.isOpen();
+        headset.drain();
+    } else {
+        if (!headset.isOpen() && ofGetElapsedTimeMillis() >= nextOpen){
+            open();
+            nextOpen = ofGetElapsedTimeMillis() + THINKGEAR_RETRY_MILLIS;
         }
+        // A lost device is closed by poll() and reopened on a later update()
+        isReady = headset.isOpen() && headset.poll(0) >= 0;
     }
-    if (!isReady)
-        return;
-    int n = device.available();
-    if (n > 0){
-        n = device.readBytes(buffer, min(n,512));
-        for (int i=0; i<n; ++i){
-            THINKGEAR_parseByte(&parser, buffer[i]);
+    if (rawBlockSize == 0)
+        flushRawBlock();
+    if (filter.isSetup())
+        filterRaw();
+    const thinkgear::HistoryRing<int16_t, THINKGEAR_RAW_HISTORY>& raw =
+        filter.isSetup() ? filtered : history.raw;
+    if (spectrum.isSetup())
+        spectrum.feed(raw);
+    // Only the newest powers matter when several updates were due at once
+    if (bands.isSetup() && bands.feed(raw)){
+        hostEeg.feed(bands.getPowers());
+        ofNotifyEvent(onHostEeg, hostEeg);
+    }
+}
+
+void ofxThinkgear::setFilter(const std::vector<thinkgear::Biquad>& stages){
+    filter.setup(stages, 1);
+    filterIndex = history.raw.getWritten();
+}
+
+// Runs the raw samples received since the last call through the filter
+void ofxThinkgear::filterRaw(){
+    thinkgear::HistoryRing<int16_t, THINKGEAR_RAW_HISTORY>::Span s = history.raw.since(filterIndex);
+    const int16_t *runs[2] = { s.first, s.second };
+    size_t counts[2] = { s.firstCount, s.secondCount };
+    int16_t out[256];
+    for (int r=0; r<2; ++r){
+        for (size_t done=0; done<counts[r]; done+=sizeof(out)/sizeof(out[0])){
+            size_t n = std::min(counts[r] - done, sizeof(out)/sizeof(out[0]));
+            filter.process(0, runs[r] + done, out, n);
+            filtered.push(out, n);
         }
     }
+    filterIndex = s.end();
+}
+
+ThinkGearParserStats ofxThinkgear::getStats() const {
+    return headset.getStats();
+}
+
+thinkgear::ConnectionStats ofxThinkgear::getConnectionStats() const {
+    return headset.getConnectionStats();
+}
+
+size_t ofxThinkgear::getRawSamples(short *out, size_t count) const {
+    return history.raw.newest(count).copyTo(out);
+}
+
+bool ofxThinkgear::startRecording(const string& path){
+    return headset.startRecording(path.c_str());
+}
+
+void ofxThinkgear::stopRecording(){
+    headset.stopRecording();
+}
+
+bool ofxThinkgear::isRecording() const {
+    return headset.isRecording();
 }
 
 void ofxThinkgear::flush(){
     if (isReady)
-        device.flush();	
+        headset.flush();
 }
 
 std::ostream& operator<<( std::ostream& stream, const EegDataPart& p){
@@ -1,10 +1,13 @@
 #ifndef _OFX_THINKGEAR_
 #define _OFX_THINKGEAR_
 
-#include "ofSerial.h"
 #include "ofEvents.h"
-#include "ThinkGearStreamParser.h"
-#include <list>
+#include "ThinkGearHeadset.h"
+#include "ThinkGearHistory.h"
+#include "ThinkGearSpectrum.h"
+#include "ThinkGearBands.h"
+#include "ThinkGearFilter.h"
+#include "ThinkGearEeg.h"
 
 #ifdef TARGET_LINUX
 #define THINKGEAR_PORT "/dev/ttyUSB0"
@@ -12,11 +15,20 @@
 #ifdef TARGET_OSX
 #define THINKGEAR_PORT "/dev/tty.MindWave"
 #endif
-#define THINKGEAR_BAUD 115200
+#define THINKGEAR_BAUD THINKGEAR_DEFAULT_BAUD
+// Time between attempts to open a missing device from update()
+#define THINKGEAR_RETRY_MILLIS 500
+// Raw samples kept by ofxThinkgear; 8 seconds at 512 Hz, must be a power of two
+#define THINKGEAR_RAW_HISTORY 4096
+// Band power and eSense values kept, one a second; must be a power of two
+#define THINKGEAR_SLOW_HISTORY 16
 
 class ofxThinkgearEventArgs : public ofEventArgs {
 public:
-    short raw;
+    // THINKGEAR_FRAME_* bits of the fields the last packet updated
+    unsigned int changed;
+    short raw;                  // newest raw sample
+    unsigned char numRaw;       // raw samples in the last packet
     unsigned char power;
     unsigned char poorSignal;
     unsigned char blinkStrength;
@@ -32,122 +44,37 @@ public:
     unsigned int eegMidGamma;
 };
 
-enum EEG_KIND {
-    EEG_DELTA,
-    EEG_THETA,
-    EEG_LOW_ALPHA,
-    EEG_HIGH_ALPHA,
-    EEG_LOW_BETA,
-    EEG_HIGH_BETA,
-    EEG_LOW_GAMMA,
-    EEG_MID_GAMMA
-};
-
-class EegDataPart {
+// A contiguous run of raw samples, see ofxThinkgear::onRawBlock
+class ofxThinkgearRawBlockArgs : public ofEventArgs {
 public:
-    EEG_KIND kind;
-    unsigned int value;
-    unsigned int previousValue;
-    float ratio;
-    float previousRatio;
-    
-    EegDataPart(EEG_KIND k) : kind(k) {
-        value = 0;
-        ratio = 0;
-        previousValue = 0;
-        previousRatio = 0;
-    }
-    
-    void feed(unsigned int v, unsigned long int total){
-        previousRatio = ratio;
-        previousValue = value;
-        value = v;
-        ratio = (float)v / (float)total;
-    }
+    const short *samples;       // valid only during the event
+    size_t count;
+    unsigned long startIndex;   // stream index of samples[0]
+    unsigned long long time;    // estimated arrival of samples[0], ofGetElapsedTimeMicros()
 };
 
-class EegData {
-public:
-    std::list<EegDataPart*> data;
-    typedef std::list<EegDataPart*>::iterator iterator;
-    typedef std::list<EegDataPart*>::const_iterator const_iterator;
-    
-    EegDataPart delta;
-    EegDataPart theta;
-    EegDataPart lowAlpha;
-    EegDataPart highAlpha;
-    EegDataPart lowBeta;
-    EegDataPart highBeta;
-    EegDataPart lowGamma;
-    EegDataPart midGamma;
-    
-    EegData() : 
-        delta(EEG_DELTA),
-        theta(EEG_THETA),
-        lowAlpha(EEG_LOW_ALPHA),
-        highAlpha(EEG_HIGH_ALPHA),
-        lowBeta(EEG_LOW_BETA),
-        highBeta(EEG_HIGH_BETA),
-        lowGamma(EEG_LOW_GAMMA),
-        midGamma(EEG_MID_GAMMA)
-    {
-        data.push_back(&delta);
-        data.push_back(&theta);
-        data.push_back(&lowAlpha);
-        data.push_back(&highAlpha);
-        data.push_back(&lowBeta);
-        data.push_back(&highBeta);
-        data.push_back(&lowGamma);
-        data.push_back(&midGamma);
-    }
-        
-    void feed(ofxThinkgearEventArgs& owner){
-        data.clear();
-        unsigned long int total 
-        = owner.eegDelta
-        + owner.eegTheta
-        + owner.eegLowAlpha
-        + owner.eegHighAlpha
-        + owner.eegLowBeta
-        + owner.eegHighBeta
-        + owner.eegLowGamma
-        + owner.eegMidGamma;
-        if (total > 0){
-            delta.feed(owner.eegDelta, total);
-            theta.feed(owner.eegTheta, total);
-            lowAlpha.feed(owner.eegLowAlpha, total);
-            highAlpha.feed(owner.eegHighAlpha, total);
-            lowBeta.feed(owner.eegLowBeta, total);
-            highBeta.feed(owner.eegHighBeta, total);
-            lowGamma.feed(owner.eegLowGamma, total);
-            midGamma.feed(owner.eegMidGamma, total);
-            data.sort(compare);
-        }
-    }
-    
-    iterator begin(){ return data.begin(); }
-    iterator end(){ return data.end(); }
-    const_iterator begin() const { return data.begin(); }
-    const_iterator end() const { return data.end(); }
-
-    static int compare(const EegDataPart* a, const EegDataPart* b){
-        if (a->value == b->value)
-            return 0;
-        if (a->value > b->value)
-            return -1;
-        return 1;
-    }
-    
-private:
-};
+// Defined here, where ofxThinkgearEventArgs is complete
+inline void EegData::feed(ofxThinkgearEventArgs& owner){
+    unsigned int power[8] = {
+        owner.eegDelta, owner.eegTheta, owner.eegLowAlpha, owner.eegHighAlpha,
+        owner.eegLowBeta, owner.eegHighBeta, owner.eegLowGamma, owner.eegMidGamma
+    };
+    feed(power);
+}
 
 std::ostream& operator<<(std::ostream&, const EegDataPart&);
 
+// openFrameworks events over thinkgear::Headset (see ThinkGearHeadset.h),
+// which does the serial I/O, parsing and threading
 class ofxThinkgear {
 public:
-    ofSerial device;
     ofxThinkgearEventArgs values;
     bool isReady;
+    // Fired once per packet; values.changed tells which fields it updated
+    ofEvent<ofxThinkgearEventArgs> onPacket;
+    // Per-field events, only fired after setLegacyEvents(true) or
+    // addEventListener().  onConnecting, onReady and onError always fire,
+    // once each time the dongle reports standby, connected or not found.
     ofEvent<ofxThinkgearEventArgs> onRaw;
     ofEvent<ofxThinkgearEventArgs> onPower;
     ofEvent<ofxThinkgearEventArgs> onPoorSignal;
@@ -158,17 +85,94 @@ public:
     ofEvent<ofxThinkgearEventArgs> onConnecting;
     ofEvent<ofxThinkgearEventArgs> onReady;
     ofEvent<ofMessage> onError;
+    // All raw samples, a block at a time; see setRawBlockSize()
+    ofEvent<ofxThinkgearRawBlockArgs> onRawBlock;
+    // The eight bands computed from the raw samples, see setHostBands()
+    EegData hostEeg;
+    ofEvent<EegData> onHostEeg;
 
     ofxThinkgear();
     ~ofxThinkgear();
 
     void flush();
     void update();
+    // Opens the port now; update() does this too while not ready, at most
+    // every THINKGEAR_RETRY_MILLIS.  For several devices at once, or to
+    // keep all opening off this thread, see ThinkGearManager.h.
     bool open();
+    // Device to read instead of THINKGEAR_PORT; takes effect on the next
+    // open, which also renames its lines in the log
+    void setPort(const string& path){ port = path; }
+    const string& getPort() const { return port; }
     void close();
 
+    // Opens, reads and parses the device on a background thread from now
+    // on, so a slow frame cannot starve or overrun the serial port.
+    // update() then only delivers the packets decoded since the last call,
+    // still on the calling thread.  Call before the first update().
+    void startThread();
+    bool isThreaded() const { return headset.isThreaded(); }
+    // Packets thrown away because update() was not called for over
+    // THINKGEAR_FRAME_QUEUE packets (about 2 seconds)
+    unsigned long getDroppedFrames() const { return headset.getDroppedFrames(); }
+
+    // Link health counters of the parser; all zero until the device opens
+    ThinkGearParserStats getStats() const;
+    // Dongle handshake state and time to connect, see ThinkGearConnection.h
+    thinkgear::ConnectionStats getConnectionStats() const;
+
+    typedef thinkgear::History<THINKGEAR_RAW_HISTORY, THINKGEAR_SLOW_HISTORY> History;
+    // The last seconds of raw samples, band powers and eSense values, as
+    // of the last update(), to read in place (see ThinkGearHistory.h).
+    // Other threads may read it too, checking isIntact() on their spans.
+    const History& getHistory() const { return history; }
+    // Filters the raw samples before the spectrum and host bands, e.g. with
+    // thinkgear::mainsChain(50) (see ThinkGearFilter.h); an empty list
+    // turns filtering off.  The filtered samples go to a ring of their own
+    // whose stream indices count from this call.
+    void setFilter(const std::vector<thinkgear::Biquad>& stages);
+    const thinkgear::HistoryRing<int16_t, THINKGEAR_RAW_HISTORY>& getFilteredRaw() const {
+        return filtered;
+    }
+    // Short-time spectra of the raw samples: from now on update() transforms
+    // the last window samples every hop samples (see ThinkGearSpectrum.h).
+    // Returns false if the window is not a power of two from 8 to 8192.
+    bool setSpectrum(size_t window, size_t hop, size_t frames = 32){
+        return spectrum.setup(window, hop, frames);
+    }
+    const thinkgear::Stft& getSpectrum() const { return spectrum; }
+    // Computes the eight EEG bands from the raw samples every hop samples
+    // (32 is 16 times a second) over the last window samples, feeds them to
+    // hostEeg and fires onHostEeg, from update(); see ThinkGearBands.h
+    bool setHostBands(size_t hop, size_t window = 512){ return bands.setup(hop, window); }
+    const thinkgear::BandBank& getHostBands() const { return bands; }
+    // Copies up to count of the newest raw samples, oldest first, into out.
+    // Returns the number copied, at most THINKGEAR_RAW_HISTORY.
+    size_t getRawSamples(short *out, size_t count) const;
+    // onRawBlock fires every size samples, or once per update() with all
+    // samples received since the last one if size is 0 (the default).
+    // Blocks are at most THINKGEAR_RAW_HISTORY samples.
+    void setRawBlockSize(size_t size);
+
+    void setLegacyEvents(bool enable){ legacyEvents = enable; }
+    bool getLegacyEvents() const { return legacyEvents; }
+    size_t getRawBlockSize() const { return rawBlockSize; }
+
+    // Raw samples delivered so far, modulo 65536
+    unsigned short getRawCount() const { return (unsigned short)history.raw.getWritten(); }
+
+    // The device itself, e.g. for writeByte() or setAutoConnect()
+    thinkgear::Headset& getHeadset(){ return headset; }
+
+    // Records every byte read from the device, with arrival times, to a
+    // capture file (see ThinkGearCapture.h) until stopRecording() or close()
+    bool startRecording(const string& path);
+    void stopRecording();
+    bool isRecording() const;
+
     template <class ListenerClass>
 	void addEventListener(ListenerClass * listener){
+		legacyEvents = true;
 		ofAddListener(onRaw,listener,&ListenerClass::onThinkgearRaw);
 		ofAddListener(onPower,listener,&ListenerClass::onThinkgearPower);
 		ofAddListener(onPoorSignal,listener,&ListenerClass::onThinkgearPoorSignal);
@@ -196,8 +200,31 @@ public:
 	}
 
 private:
-    ThinkGearStreamParser parser;
-    unsigned char buffer[512];
+    bool legacyEvents;
+
+    friend void tgHandleFrameFunc(const ThinkGearFrame& frame, uint64_t micros, void *customData);
+
+    void dispatchFrame(const ThinkGearFrame *frame, unsigned long long micros);
+    void flushRawBlock();
+    void filterRaw();
+    void openLog();
+
+    thinkgear::Headset headset;
+    thinkgear::LogChannel *log;         // named after port; NULL until opened
+    string port;
+    unsigned long long nextOpen;        // ofGetElapsedTimeMillis()
+    unsigned char dongleStatus;         // last 0xD0-0xD4 code delivered
+    // ofGetElapsedTimeMicros() minus Headset::nowMicros()
+    long long clockOffset;
+    History history;
+    thinkgear::Stft spectrum;
+    thinkgear::BandBank bands;
+    thinkgear::FilterBank filter;
+    thinkgear::HistoryRing<int16_t, THINKGEAR_RAW_HISTORY> filtered;
+    uint64_t filterIndex;               // next raw stream index to filter
+    short rawBlock[THINKGEAR_RAW_HISTORY];
+    size_t rawBlockSize;
+    ofxThinkgearRawBlockArgs rawBlockArgs;
 };
 
 #endif
\ No newline at end of file
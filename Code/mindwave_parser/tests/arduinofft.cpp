@@ -0,0 +1,417 @@
+/*
+ * arduinofft: checks ThinkGearArduinoFft, the host model of the robot's
+ * ArduinoFFT, against what FFT.h's own assembly computes, for FFT_N 16 to
+ * 256.  Fixed inputs go through window(), reorder() and run() (the
+ * butterflies), and magLog(), magLin(), magLin8() and magOctave() take
+ * both the inputs and the transforms, magLin8() for every SCALE FFT.h
+ * has a branch for and two more, magOctave() for OCT_NORM 0 and 1.  Every
+ * output value must be the assembly's: the digests of each must match the
+ * golden ones below.
+ *
+ *   arduinofft [-g]
+ *
+ *   -g  prints the golden digests instead of checking them; only in a
+ *       build with ARDUINOFFT_EMULATOR, where they come from the assembly
+ *
+ * The golden digests come from an emulator of FFT.h's AVR instructions
+ * that avrfft.py writes; make arduinofft-golden builds it and prints them
+ * again.  Includes the model's source, ARDUINOFFT_SOURCE, so make check
+ * can also build it with an error planted and see that it fails.
+ *
+ * Build and run with the Makefile in the parent directory: make check
+ */
+
+#ifndef ARDUINOFFT_SOURCE
+#define ARDUINOFFT_SOURCE "ThinkGearArduinoFft.cpp"
+#endif
+#include ARDUINOFFT_SOURCE
+#include "fuzzstream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using thinkgear::ArduinoFft;
+
+namespace {
+
+// What is checked, and what FFT.h's assembly gives for it: FNV-1a over
+// every output value of the inputs of digests()
+struct Golden {
+    unsigned n;
+    const char *what;
+    unsigned option;            // SCALE for lin8, OCT_NORM for octave
+    uint64_t digest;
+};
+
+const Golden GOLDEN[] = {
+    { 16, "run", 0, 0xfad1914956925212ULL },
+    { 16, "log", 0, 0xb78518632e1aeb2fULL },
+    { 16, "lin", 0, 0x3d99ef5d605efc05ULL },
+    { 16, "lin8", 1, 0x3ed184677d8f89b7ULL },
+    { 16, "lin8", 2, 0x63a2ee2aaa60b584ULL },
+    { 16, "lin8", 4, 0x968e7a8852d3bac5ULL },
+    { 16, "lin8", 7, 0x565c564ccb050707ULL },
+    { 16, "lin8", 128, 0x47657145a6e44730ULL },
+    { 16, "lin8", 200, 0x8bd734eb067646e8ULL },
+    { 16, "lin8", 256, 0xacf25a559fa4d23dULL },
+    { 16, "octave", 0, 0x697d6206d23887d2ULL },
+    { 16, "octave", 1, 0x40320c1a821726ffULL },
+    { 32, "run", 0, 0xf83fa319c717c350ULL },
+    { 32, "log", 0, 0x5352f6c0238ae8efULL },
+    { 32, "lin", 0, 0x6b32195ef9fdda1dULL },
+    { 32, "lin8", 1, 0x58611ca9793fa8fbULL },
+    { 32, "lin8", 2, 0x6749ad58a69641e7ULL },
+    { 32, "lin8", 4, 0x09c437cdf9dc6641ULL },
+    { 32, "lin8", 7, 0x8bd588fb103fad5eULL },
+    { 32, "lin8", 128, 0x073272ef2e796fedULL },
+    { 32, "lin8", 200, 0xac59b4665cef9a6fULL },
+    { 32, "lin8", 256, 0x6384894a6ab78bccULL },
+    { 32, "octave", 0, 0x7a9d805c19500f1dULL },
+    { 32, "octave", 1, 0xa9067e7651c10e24ULL },
+    { 64, "run", 0, 0x0bea94ea974fe938ULL },
+    { 64, "log", 0, 0xcb8b2fe98e142277ULL },
+    { 64, "lin", 0, 0x4231bfd87aecd4d0ULL },
+    { 64, "lin8", 1, 0xc8705811cfc98c22ULL },
+    { 64, "lin8", 2, 0xd4654d90aefa0a3dULL },
+    { 64, "lin8", 4, 0x0bb2bd23e72b3dbcULL },
+    { 64, "lin8", 7, 0x6d9a0652d25fda19ULL },
+    { 64, "lin8", 128, 0xc6ec33749ad55babULL },
+    { 64, "lin8", 200, 0xbeb5819e852be972ULL },
+    { 64, "lin8", 256, 0x5ca69f9b494b0e86ULL },
+    { 64, "octave", 0, 0x6f0b23e08f4484c3ULL },
+    { 64, "octave", 1, 0x1f2983ab92011f9eULL },
+    { 128, "run", 0, 0x527ea7b537c6703bULL },
+    { 128, "log", 0, 0x50a85825b1d3de74ULL },
+    { 128, "lin", 0, 0xdeca5dce8db50edaULL },
+    { 128, "lin8", 1, 0xd05fcd7e6c827fabULL },
+    { 128, "lin8", 2, 0x20217eedda356b33ULL },
+    { 128, "lin8", 4, 0x07f34cb7dec53ba2ULL },
+    { 128, "lin8", 7, 0xc60d2943bbb8f725ULL },
+    { 128, "lin8", 128, 0xde337e085795df42ULL },
+    { 128, "lin8", 200, 0x249d45bcdaf1b594ULL },
+    { 128, "lin8", 256, 0x183aaa832c840321ULL },
+    { 128, "octave", 0, 0xe73b376d8d18c2a8ULL },
+    { 128, "octave", 1, 0xf22b1838aa6d2f53ULL },
+    { 256, "run", 0, 0xce49f05795924c05ULL },
+    { 256, "log", 0, 0xdf12f4de4677ee06ULL },
+    { 256, "lin", 0, 0xb42b3b84218abd02ULL },
+    { 256, "lin8", 1, 0x6956052e2f59d922ULL },
+    { 256, "lin8", 2, 0xba171c58ea778b45ULL },
+    { 256, "lin8", 4, 0xee2c4f447a1afe6eULL },
+    { 256, "lin8", 7, 0x1c885d3fb40131dcULL },
+    { 256, "lin8", 128, 0x9285c6b596f22c07ULL },
+    { 256, "lin8", 200, 0xd167cc6e1da46199ULL },
+    { 256, "lin8", 256, 0xb17a11e29ee020c3ULL },
+    { 256, "octave", 0, 0x3e890275cb09d379ULL },
+    { 256, "octave", 1, 0x1a8175a63672f260ULL },
+};
+
+const unsigned SIZES[] = { 16, 32, 64, 128, 256 };
+const unsigned SCALES[] = { 1, 2, 4, 7, 128, 200, 256 };
+const size_t SCALE_COUNT = sizeof(SCALES) / sizeof(SCALES[0]);
+
+// Transforms per call: one whole group of THINKGEAR_ARDUINO_LANES and
+// part of another
+const size_t BATCH = 7;
+// Batches per FFT_N, cycling through the kinds of input
+const int BATCHES = 100;
+
+// One FFT.h build per call, be it the model or the assembly
+class Fft {
+public:
+    virtual ~Fft(){}
+    /** window(), reorder() and run(), or only run() if not @c full */
+    virtual void transform(int16_t *input, size_t count, bool full) = 0;
+    virtual void magLog(const int16_t *input, uint8_t *out, size_t count) = 0;
+    virtual void magLin(const int16_t *input, uint16_t *out, size_t count) = 0;
+    virtual void magLin8(const int16_t *input, uint8_t *out, size_t count, unsigned scale) = 0;
+    virtual void magOctave(const int16_t *input, uint8_t *out, size_t count, bool normalize) = 0;
+};
+
+class ModelFft : public Fft {
+public:
+    explicit ModelFft(size_t n){ fft.setup(n); }
+    void transform(int16_t *input, size_t count, bool full){
+        if (full){
+            fft.window(input, count);
+            fft.reorder(input, count);
+        }
+        fft.run(input, count);
+    }
+    void magLog(const int16_t *input, uint8_t *out, size_t count){
+        fft.magLog(input, out, count);
+    }
+    void magLin(const int16_t *input, uint16_t *out, size_t count){
+        fft.magLin(input, out, count);
+    }
+    void magLin8(const int16_t *input, uint8_t *out, size_t count, unsigned scale){
+        fft.magLin8(input, out, count, scale);
+    }
+    void magOctave(const int16_t *input, uint8_t *out, size_t count, bool normalize){
+        fft.magOctave(input, out, count, normalize);
+    }
+
+private:
+    ArduinoFft fft;
+};
+
+#ifdef ARDUINOFFT_EMULATOR
+
+// One emulated build of FFT.h, from avrfft.py
+struct AvrFft {
+    unsigned n, scale, norm;
+    void (*init)(void);
+    uint8_t *(*data)(void);
+    void (*window)(void);
+    void (*reorder)(void);
+    void (*run)(void);
+    void (*magLog)(void);
+    void (*magLin)(void);
+    void (*magLin8)(void);
+    void (*magOctave)(void);
+};
+
+#include "avrfft.h"
+
+const size_t AVR_FFT_COUNT = sizeof(AVR_FFTS) / sizeof(AVR_FFTS[0]);
+
+// Where FFT.h's arrays are in the emulated data memory
+const size_t AVR_INPUT = 0x100, AVR_LOG = 0x1000, AVR_LIN = 0x1200, AVR_LIN8 = 0x1400,
+    AVR_OCTAVE = 0x1600;
+
+// The assembly, one transform at a time in the build that has what is
+// asked for
+class AvrEmulator : public Fft {
+public:
+    explicit AvrEmulator(size_t n) : n(n) {
+        for (size_t i=0; i<AVR_FFT_COUNT; ++i)
+            if (AVR_FFTS[i].n == n)
+                AVR_FFTS[i].init();
+    }
+    void transform(int16_t *input, size_t count, bool full){
+        const AvrFft& avr = find(0, 0, false);
+        for (size_t t=0; t<count; ++t, input += 2 * n){
+            memcpy(avr.data() + AVR_INPUT, input, 4 * n);
+            if (full){
+                avr.window();
+                avr.reorder();
+            }
+            avr.run();
+            memcpy(input, avr.data() + AVR_INPUT, 4 * n);
+        }
+    }
+    void magLog(const int16_t *input, uint8_t *out, size_t count){
+        const AvrFft& avr = find(0, 0, false);
+        for (size_t t=0; t<count; ++t, input += 2 * n, out += n / 2){
+            memcpy(avr.data() + AVR_INPUT, input, 4 * n);
+            avr.magLog();
+            memcpy(out, avr.data() + AVR_LOG, n / 2);
+        }
+    }
+    void magLin(const int16_t *input, uint16_t *out, size_t count){
+        const AvrFft& avr = find(0, 0, false);
+        for (size_t t=0; t<count; ++t, input += 2 * n, out += n / 2){
+            memcpy(avr.data() + AVR_INPUT, input, 4 * n);
+            avr.magLin();
+            memcpy(out, avr.data() + AVR_LIN, n);
+        }
+    }
+    void magLin8(const int16_t *input, uint8_t *out, size_t count, unsigned scale){
+        const AvrFft& avr = find(scale, 0, false);
+        for (size_t t=0; t<count; ++t, input += 2 * n, out += n / 2){
+            memcpy(avr.data() + AVR_INPUT, input, 4 * n);
+            avr.magLin8();
+            memcpy(out, avr.data() + AVR_LIN8, n / 2);
+        }
+    }
+    void magOctave(const int16_t *input, uint8_t *out, size_t count, bool normalize){
+        const AvrFft& avr = find(0, normalize, true);
+        size_t octaves = 0;
+        while ((2u << octaves) <= n)
+            octaves++;
+        for (size_t t=0; t<count; ++t, input += 2 * n, out += octaves){
+            memcpy(avr.data() + AVR_INPUT, input, 4 * n);
+            avr.magOctave();
+            memcpy(out, avr.data() + AVR_OCTAVE, octaves);
+        }
+    }
+
+private:
+    // The build for this FFT_N with SCALE @c scale, unless 0, and with
+    // OCT_NORM @c norm if @c byNorm
+    const AvrFft& find(unsigned scale, unsigned norm, bool byNorm) const {
+        for (size_t i=0; i<AVR_FFT_COUNT; ++i)
+            if (AVR_FFTS[i].n == n && (scale == 0 || AVR_FFTS[i].scale == scale) &&
+                (!byNorm || AVR_FFTS[i].norm == norm))
+                return AVR_FFTS[i];
+        fprintf(stderr, "arduinofft: avrfft.py wrote no FFT_N %u build for that\n", (unsigned)n);
+        exit(1);
+    }
+
+    size_t n;
+};
+
+#endif /* ARDUINOFFT_EMULATOR */
+
+template <class T>
+void mix(uint64_t& digest, const std::vector<T>& values){
+    for (size_t i=0; i<values.size(); ++i)
+        digest = (digest ^ (uint64_t)values[i]) * 0x100000001b3ULL;
+}
+
+// BATCH inputs of one kind: full-scale noise, noise the size of raw
+// samples, a square wave on noise, complex noise, or values of every
+// magnitude in both parts
+void fill(Random& rnd, int kind, size_t n, std::vector<int16_t>& in){
+    for (size_t t=0; t<BATCH; ++t){
+        unsigned period = 2 + rnd.below((unsigned)n);
+        for (size_t i=0; i<n; ++i){
+            int16_t re, im = 0;
+            int16_t noise = (int16_t)rnd.next();
+            if (kind == 0)
+                re = noise;
+            else if (kind == 1)
+                re = (int16_t)((int)rnd.below(1025) - 512);
+            else if (kind == 2)
+                re = (int16_t)((i % period < period / 2 ? 2000 : -2000) + (int)rnd.below(201) - 100);
+            else if (kind == 3){
+                re = noise;
+                im = (int16_t)rnd.next();
+            } else {
+                re = (int16_t)(noise >> rnd.below(16));
+                im = (int16_t)((int16_t)rnd.next() >> rnd.below(16));
+            }
+            in[(t * n + i) * 2] = re;
+            in[(t * n + i) * 2 + 1] = im;
+        }
+    }
+}
+
+// Digests of everything @c fft gives for FFT_N @c n, in the order of
+// GOLDEN: run, log, lin, lin8 for each of SCALES, octave for OCT_NORM 0
+// and 1
+std::vector<Golden> digests(Fft& fft, unsigned n, unsigned long& values){
+    std::vector<Golden> out;
+    const uint64_t FNV_BASIS = 0xcbf29ce484222325ULL;
+    Golden run = { n, "run", 0, FNV_BASIS }, log = { n, "log", 0, FNV_BASIS },
+        lin = { n, "lin", 0, FNV_BASIS };
+    std::vector<Golden> lin8, octave;
+    for (size_t s=0; s<SCALE_COUNT; ++s){
+        Golden g = { n, "lin8", SCALES[s], FNV_BASIS };
+        lin8.push_back(g);
+    }
+    for (unsigned norm=0; norm<2; ++norm){
+        Golden g = { n, "octave", norm, FNV_BASIS };
+        octave.push_back(g);
+    }
+
+    size_t octaves = 0;
+    while ((2u << octaves) <= n)
+        octaves++;
+    Random rnd(n);
+    std::vector<int16_t> in(BATCH * 2 * n), transformed;
+    std::vector<uint8_t> bytes(BATCH * n / 2), octaveBytes(BATCH * octaves);
+    std::vector<uint16_t> words(BATCH * n / 2);
+    for (int b=0; b<BATCHES; ++b){
+        int kind = b % 5;
+        fill(rnd, kind, n, in);
+        transformed = in;
+        // Complex noise has no window; the rest goes through like runFFT()
+        fft.transform(&transformed[0], BATCH, kind != 3);
+        mix(run.digest, transformed);
+        values += transformed.size();
+
+        // The magnitudes of the inputs reach every branch of the lookups
+        const int16_t *inputs[] = { &in[0], &transformed[0] };
+        for (int i=0; i<2; ++i){
+            fft.magLog(inputs[i], &bytes[0], BATCH);
+            mix(log.digest, bytes);
+            fft.magLin(inputs[i], &words[0], BATCH);
+            mix(lin.digest, words);
+            for (size_t s=0; s<SCALE_COUNT; ++s){
+                fft.magLin8(inputs[i], &bytes[0], BATCH, SCALES[s]);
+                mix(lin8[s].digest, bytes);
+            }
+            for (unsigned norm=0; norm<2; ++norm){
+                fft.magOctave(inputs[i], &octaveBytes[0], BATCH, norm != 0);
+                mix(octave[norm].digest, octaveBytes);
+            }
+            values += bytes.size() * (2 + SCALE_COUNT) + octaveBytes.size() * 2;
+        }
+    }
+    out.push_back(run);
+    out.push_back(log);
+    out.push_back(lin);
+    out.insert(out.end(), lin8.begin(), lin8.end());
+    out.insert(out.end(), octave.begin(), octave.end());
+    return out;
+}
+
+int usage(){
+    fprintf(stderr, "usage: arduinofft [-g]\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    bool golden = false;
+    for (int i=1; i<argc; ++i){
+        if (strcmp(argv[i], "-g") == 0)
+            golden = true;
+        else
+            return usage();
+    }
+
+    std::vector<Golden> computed;
+    unsigned long values = 0;
+    for (size_t i=0; i<sizeof(SIZES) / sizeof(SIZES[0]); ++i){
+        std::vector<Golden> d;
+        if (golden){
+#ifdef ARDUINOFFT_EMULATOR
+            AvrEmulator avr(SIZES[i]);
+            d = digests(avr, SIZES[i], values);
+#else
+            fprintf(stderr, "arduinofft: -g needs a build with the emulator: make arduinofft-golden\n");
+            return 2;
+#endif
+        } else {
+            ModelFft model(SIZES[i]);
+            d = digests(model, SIZES[i], values);
+        }
+        computed.insert(computed.end(), d.begin(), d.end());
+    }
+
+    if (golden){
+        for (size_t i=0; i<computed.size(); ++i)
+            printf("    { %u, \"%s\", %u, 0x%016llxULL },\n", computed[i].n, computed[i].what,
+                   computed[i].option, (unsigned long long)computed[i].digest);
+        return 0;
+    }
+
+    int failures = 0;
+    size_t goldenCount = sizeof(GOLDEN) / sizeof(GOLDEN[0]);
+    if (goldenCount != computed.size()){
+        fprintf(stderr, "arduinofft: %u golden digests for %u checks; make arduinofft-golden\n",
+                (unsigned)goldenCount, (unsigned)computed.size());
+        return 1;
+    }
+    for (size_t i=0; i<computed.size(); ++i){
+        const Golden& g = GOLDEN[i];
+        const Golden& c = computed[i];
+        if (g.n != c.n || strcmp(g.what, c.what) != 0 || g.option != c.option || g.digest != c.digest){
+            fprintf(stderr, "arduinofft: FFT_N %u %s", c.n, c.what);
+            if (strcmp(c.what, "lin8") == 0)
+                fprintf(stderr, " with SCALE %u", c.option);
+            else if (strcmp(c.what, "octave") == 0)
+                fprintf(stderr, " with OCT_NORM %u", c.option);
+            fprintf(stderr, " differs from FFT.h's assembly\n");
+            failures++;
+        }
+    }
+    if (failures)
+        return 1;
+    printf("arduinofft: %lu values of FFT_N 16 to 256, %u SCALEs and OCT_NORM 0 and 1 "
+           "the same as FFT.h's assembly\n", values, (unsigned)SCALE_COUNT);
+    return 0;
+}
@@ -0,0 +1,229 @@
+#!/usr/bin/env python3
+#
+# avrfft.py: turns the inline AVR assembly of ArduinoFFT's FFT.h into C,
+# one statement per instruction on emulated registers, flags and memory,
+# so arduinofft.cpp can check ThinkGearArduinoFft against the code the
+# robot really runs.  Only the instructions FFT.h uses are known.
+#
+#   avrfft.py FFT.h folder
+#
+# Writes one avr_N_SCALE.c per FFT_N and SCALE that arduinofft.cpp checks,
+# OCT_NORM alternating from one SCALE to the next so every FFT_N has both,
+# and avrfft.h listing them.  Each file defines avr_N_SCALE_init(), which
+# copies the tables to program memory, avr_N_SCALE_data(), its data memory,
+# and avr_N_SCALE_fft_run() and the rest of FFT.h's functions.  Data memory
+# has fft_input at 0x100 and the outputs after it, at DATA below.
+#
+# Run through the Makefile in the parent directory: make arduinofft-golden
+
+import os, re, subprocess, sys, tempfile
+
+SIZES = [16, 32, 64, 128, 256]
+# Every branch FFT.h has for SCALE, and two that take the general one
+SCALES = [1, 2, 4, 7, 128, 200, 256]
+
+DATA = {'fft_input': 0x100, 'fft_log_out': 0x1000, 'fft_lin_out': 0x1200,
+        'fft_lin_out8': 0x1400, 'fft_oct_out': 0x1600}
+PROG = {'_wk_constants': 0x100, '_reorder_table': 0x1000, '_log_table': 0x1400,
+        '_lin_table': 0x1800, '_lin_table8': 0x2000, '_window_func': 0x2800}
+SYMBOLS = dict(DATA, **PROG)
+
+# Stands in for avr-libc's header; static keeps each variant's tables apart
+PGMSPACE = '''#include <stdint.h>
+#define PROGMEM static
+typedef int16_t prog_int16_t;
+typedef uint8_t prog_uint8_t;
+'''
+
+# The value of an operand such as lo8(fft_input + 2) or 0x7e
+def value(e):
+    for name in sorted(SYMBOLS, key=len, reverse=True):
+        e = re.sub(r'\b%s\b' % name, str(SYMBOLS[name]), e)
+    e = e.replace('/', '//').replace('lo8', '_lo').replace('hi8', '_hi')
+    return eval(e, {'_lo': lambda x: x & 0xff, '_hi': lambda x: (x >> 8) & 0xff})
+
+def register(a):
+    return int(a.strip()[1:])
+
+# The instructions of one asm function, as ('label', name) and
+# ('ins', op, operands)
+def instructions(body):
+    text = ''
+    for a in re.finditer(r'asm volatile \((.*?)\);', body, re.S):
+        for t in re.finditer(r'"((?:[^"\\]|\\.)*)"|(:)', a.group(1)):
+            if t.group(2):
+                break
+            text += t.group(1)
+    items = []
+    for line in (l.strip() for l in text.split('\\n')):
+        if not line:
+            continue
+        if re.match(r'^\d+:$', line):
+            items.append(('label', line[:-1]))
+            continue
+        op, _, args = line.partition(' ')
+        items.append(('ins', op, [x.strip() for x in args.split(',')] if args.strip() else []))
+    return items
+
+# C for one instruction; goto targets are 'I<n>' for instruction n and
+# 'L<n>' for the label at n
+def translate(op, a, branch, skip):
+    if op in ('push', 'pop'):
+        return ''
+    if op in ('breq', 'brne', 'brsh', 'brlo', 'brcs', 'brcc'):
+        condition = {'breq': 'Z', 'brne': '!Z', 'brsh': '!C', 'brlo': 'C', 'brcs': 'C', 'brcc': '!C'}[op]
+        return 'if (%s) goto %s;' % (condition, branch)
+    if op == 'rjmp':
+        return 'goto %s;' % branch
+    if op == 'clr':
+        return 'r[%d]=0; Z=1;' % register(a[0])
+    if op == 'ldi':
+        return 'r[%d]=%d;' % (register(a[0]), value(a[1]) & 0xff)
+    if op == 'mov':
+        return 'r[%d]=r[%d];' % (register(a[0]), register(a[1]))
+    if op == 'movw':
+        d, s = register(a[0]), register(a[1])
+        return 'r[%d]=r[%d]; r[%d]=r[%d];' % (d, s, d+1, s+1)
+    if op in ('ld', 'ldd', 'lpm', 'st', 'std'):
+        load = op in ('ld', 'ldd', 'lpm')
+        reg, ptr = (a[0], a[1]) if load else (a[1], a[0])
+        memory = 'pmem' if op == 'lpm' else 'dmem'
+        p = ptr.replace(' ', '')
+        base = {'x': 26, 'y': 28, 'z': 30}[p.strip('-+')[0]]
+        offset = 0
+        displaced = re.match(r'^([xyz])\+(\d+)$', p)
+        if displaced:
+            offset, p = int(displaced.group(2)), displaced.group(1)
+        pointer = '((r[%d]<<8)|r[%d])' % (base+1, base)
+        pre = 'setp(%d,%s-1);' % (base, pointer) if p.startswith('-') else ''
+        post = 'setp(%d,%s+1);' % (base, pointer) if p.endswith('+') and not displaced else ''
+        cell = '%s[(%s+%d)&0xffff]' % (memory, pointer, offset)
+        move = 'r[%d]=%s;' % (register(reg), cell) if load else '%s=r[%d];' % (cell, register(reg))
+        return pre + move + post
+    if op in ('add', 'adc', 'sub', 'sbc', 'cp', 'cpc', 'subi', 'sbci', 'cpi', 'and', 'or', 'andi', 'ori'):
+        d = register(a[0])
+        if op in ('add', 'adc', 'sub', 'sbc', 'cp', 'cpc', 'and', 'or'):
+            s = 'r[%d]' % register(a[1])
+        else:
+            s = str(value(a[1]) & 0xff)
+        if op in ('add', 'adc'):
+            carry = 'C' if op == 'adc' else '0'
+            return '{int t=r[%d]+%s+%s; C=t>>8; r[%d]=t&0xff; Z=r[%d]==0;}' % (d, s, carry, d, d)
+        if op in ('and', 'or', 'andi', 'ori'):
+            o = '&' if op in ('and', 'andi') else '|'
+            return 'r[%d]=r[%d]%s%s; Z=r[%d]==0;' % (d, d, o, s, d)
+        # sbc, cpc and sbci only clear Z, so a multi-byte compare works
+        carry = op in ('sbc', 'cpc', 'sbci')
+        store = 'r[%d]=t;' % d if op not in ('cp', 'cpc', 'cpi') else ''
+        return '{int t=r[%d]-%s-%s; C=t<0; t&=0xff; %s Z=%s;}' % (
+            d, s, 'C' if carry else '0', store, '(t==0)&&Z' if carry else '(t==0)')
+    if op == 'adiw':
+        d = register(a[0])
+        return '{int t=((r[%d]<<8)|r[%d])+%d; C=t>>16; setp(%d,t); Z=(t&0xffff)==0;}' % (
+            d+1, d, value(a[1]), d)
+    d = register(a[0])
+    if op == 'dec':
+        return 'r[%d]--; Z=r[%d]==0;' % (d, d)
+    if op == 'tst':
+        return 'Z=r[%d]==0;' % d
+    if op == 'neg':
+        return 'r[%d]=(-r[%d])&0xff; C=r[%d]!=0; Z=r[%d]==0;' % ((d,)*4)
+    if op == 'swap':
+        return 'r[%d]=((r[%d]<<4)|(r[%d]>>4))&0xff;' % ((d,)*3)
+    if op == 'asr':
+        return 'C=r[%d]&1; r[%d]=(r[%d]>>1)|(r[%d]&0x80); Z=r[%d]==0;' % ((d,)*5)
+    if op == 'lsr':
+        return 'C=r[%d]&1; r[%d]>>=1; Z=r[%d]==0;' % ((d,)*3)
+    if op == 'ror':
+        return '{int o=C; C=r[%d]&1; r[%d]=(r[%d]>>1)|(o<<7); Z=r[%d]==0;}' % ((d,)*4)
+    if op == 'lsl':
+        return 'C=r[%d]>>7; r[%d]=(r[%d]<<1)&0xff; Z=r[%d]==0;' % ((d,)*4)
+    if op == 'rol':
+        return '{int o=C; C=r[%d]>>7; r[%d]=((r[%d]<<1)|o)&0xff; Z=r[%d]==0;}' % ((d,)*4)
+    if op in ('mul', 'muls', 'mulsu', 'fmul', 'fmuls', 'fmulsu'):
+        s = register(a[1])
+        x = '(int8_t)r[%d]' % d if op in ('muls', 'mulsu', 'fmuls', 'fmulsu') else 'r[%d]' % d
+        y = '(int8_t)r[%d]' % s if op in ('muls', 'fmuls') else 'r[%d]' % s
+        if op.startswith('f'):
+            return '{int p=(%s)*(%s); C=(p>>15)&1; p=(p<<1)&0xffff; mulres(p); Z=p==0;}' % (x, y)
+        return '{int p=((%s)*(%s))&0xffff; C=(p>>15)&1; mulres(p); Z=p==0;}' % (x, y)
+    if op in ('sbrc', 'sbrs'):
+        return 'if (%s((r[%d]>>%d)&1)) goto %s;' % ('!' if op == 'sbrc' else '', d, value(a[1]), skip)
+    raise ValueError('unknown instruction ' + op)
+
+def function(tag, name, items):
+    labels = [(i, it[1]) for i, it in enumerate(items) if it[0] == 'label']
+    # Local labels: 1f is the next 1: after, 1b the last one before
+    def target(i, ref):
+        n, direction = ref[:-1], ref[-1]
+        if direction == 'f':
+            return 'L%d' % [p for p, k in labels if k == n and p > i][0]
+        return 'L%d' % [p for p, k in labels if k == n and p < i][-1]
+    def following(i):
+        return next((j for j in range(i+1, len(items)) if items[j][0] == 'ins'), len(items))
+    out = ['void %s_%s(void){' % (tag, name)]
+    for i, it in enumerate(items):
+        if it[0] == 'label':
+            out.append('L%d:;' % i)
+            continue
+        _, op, a = it
+        branch = target(i, a[-1]) if op.startswith('br') or op == 'rjmp' else None
+        out.append('I%d:; %s' % (i, translate(op, a, branch, 'I%d' % following(following(i)))))
+    out.append('I%d:; }' % len(items))
+    return out
+
+def variant(header, stubs, n, scale, norm):
+    tag = 'avr_%d_%d' % (n, scale)
+    pp = subprocess.check_output([os.environ.get('CC', 'cc'), '-E', '-P', '-x', 'c',
+        '-I' + stubs, '-I' + os.path.dirname(os.path.abspath(header)),
+        '-DFFT_N=%d' % n, '-DSCALE=%d' % scale, '-DOCT_NORM=%d' % norm,
+        '-DLOG_OUT=1', '-DLIN_OUT=1', '-DLIN_OUT8=1', '-DOCTAVE=1', '-DWINDOW=1',
+        header]).decode()
+    first = pp.index('static inline void')
+    # The data arrays live in dmem instead
+    declarations = re.sub(r'^\s*(int|uint8_t|uint16_t) fft_\w+\[[^\]]*\];', '', pp[:first], flags=re.M)
+    out = ['/* FFT_N %d, SCALE %d, OCT_NORM %d; written by avrfft.py */' % (n, scale, norm),
+           '#include <string.h>', declarations,
+           'static uint8_t r[32], dmem[65536], pmem[65536];',
+           'static int C, Z;',
+           'static void setp(int i, int v){ r[i]=v&0xff; r[i+1]=(v>>8)&0xff; }',
+           'static void mulres(int p){ r[0]=p&0xff; r[1]=(p>>8)&0xff; }']
+    for m in re.finditer(r'static inline void (\w+)\(void\) \{(.*?)\n\}', pp[first:], re.S):
+        out += function(tag, m.group(1), instructions(m.group(2)))
+    out.append('void %s_init(void){' % tag)
+    for name in sorted(PROG, key=PROG.get):
+        out.append('  memcpy(pmem + %d, %s, sizeof(%s));' % (PROG[name], name, name))
+    out.append('}')
+    out.append('uint8_t *%s_data(void){ return dmem; }' % tag)
+    return tag, '\n'.join(out) + '\n'
+
+FUNCTIONS = ['init', 'data', 'fft_window', 'fft_reorder', 'fft_run',
+             'fft_mag_log', 'fft_mag_lin', 'fft_mag_lin8', 'fft_mag_octave']
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: avrfft.py FFT.h folder')
+    header, folder = sys.argv[1], sys.argv[2]
+    stubs = tempfile.mkdtemp()
+    os.mkdir(os.path.join(stubs, 'avr'))
+    with open(os.path.join(stubs, 'avr', 'pgmspace.h'), 'w') as f:
+        f.write(PGMSPACE)
+    listing = ['/* The emulated FFT.h builds; written by avrfft.py */', 'extern "C" {']
+    table = ['static const AvrFft AVR_FFTS[] = {']
+    for n in SIZES:
+        for i, scale in enumerate(SCALES):
+            norm = i & 1
+            tag, source = variant(header, stubs, n, scale, norm)
+            with open(os.path.join(folder, tag + '.c'), 'w') as f:
+                f.write(source)
+            listing.append('uint8_t *%s_data(void);' % tag)
+            listing += ['void %s_%s(void);' % (tag, name) for name in FUNCTIONS if name != 'data']
+            table.append('    { %d, %d, %d, %s },' % (n, scale, norm,
+                         ', '.join('%s_%s' % (tag, name) for name in FUNCTIONS)))
+    os.remove(os.path.join(stubs, 'avr', 'pgmspace.h'))
+    os.rmdir(os.path.join(stubs, 'avr'))
+    os.rmdir(stubs)
+    with open(os.path.join(folder, 'avrfft.h'), 'w') as f:
+        f.write('\n'.join(listing + ['}'] + table + ['};']) + '\n')
+
+main()
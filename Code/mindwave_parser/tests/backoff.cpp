@@ -0,0 +1,153 @@
+/*
+ * backoff: checks how HeadsetManager (ThinkGearManager.h) retries devices
+ * it cannot open.  A path that exists but is no tty, as good as one that
+ * fails with EACCES or EBUSY, must be retried after min, 2*min, 4*min ...
+ * up to max, however often the manager rescans; a path that was absent
+ * must be opened by the first rescan after it appears, long before its
+ * backoff ends.
+ *
+ *   backoff
+ *
+ * Uses a temporary folder, a regular file and a pseudo-terminal; takes
+ * about two seconds.
+ *
+ * Build and run with the Makefile in the parent directory: make check
+ */
+
+#include "ThinkGearManager.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+using thinkgear::Headset;
+using thinkgear::HeadsetManager;
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char *what){
+    if (!ok){
+        fprintf(stderr, "backoff: %s\n", what);
+        failures++;
+    }
+}
+
+void sleepMillis(unsigned ms){
+    usleep(ms * 1000);
+}
+
+// The retry time set after each failed open of @c device over @c millis
+std::vector<uint64_t> watchRetries(const HeadsetManager& m, size_t device, unsigned millis){
+    std::vector<uint64_t> retries;
+    uint64_t end = Headset::nowMicros() + millis * 1000ULL;
+    while (Headset::nowMicros() < end){
+        thinkgear::DeviceStatus s = m.getStatus(device);
+        // The retry time is set just after the count goes up; keep the
+        // last one seen for each count
+        if (s.failures > 0){
+            retries.resize(s.failures);
+            retries[s.failures - 1] = s.retryMicros;
+        }
+        sleepMillis(1);
+    }
+    return retries;
+}
+
+// The schedule: min, then doubling up to max, with rescans every 10 ms
+void checkSchedule(const std::string& file){
+    const uint32_t MIN = 50, MAX = 400;
+    HeadsetManager m;
+    m.setBackoff(MIN, MAX);
+    m.addPorts((file + "*").c_str(), THINKGEAR_DEFAULT_BAUD, 10);
+    check(m.getDeviceCount() == 1, "the regular file was not added");
+    uint64_t started = Headset::nowMicros();
+    m.start(1);
+    std::vector<uint64_t> retries = watchRetries(m, 0, 1500);
+    m.stop();
+
+    // Failures at about 0, 50, 150, 350, 750 and 1150 ms
+    if (retries.size() < 5 || retries.size() > 7){
+        fprintf(stderr, "backoff: %u failed opens in 1.5 s, not 6\n", (unsigned)retries.size());
+        failures++;
+        return;
+    }
+    // Each wait is measured from the retry it follows, which is late by
+    // however long the worker took to get to it
+    uint64_t expected = MIN;
+    for (size_t i=0; i<retries.size(); ++i){
+        double wait = (retries[i] - (i ? retries[i-1] : started)) * 1e-3;
+        if (wait < expected || wait > expected + 30){
+            fprintf(stderr, "backoff: wait %u was %.0f ms, not %llu\n",
+                    (unsigned)i + 1, wait, (unsigned long long)expected);
+            failures++;
+        }
+        expected = expected * 2 < MAX ? expected * 2 : MAX;
+    }
+}
+
+// A path that shows up is opened at the next rescan; one that is there
+// but fails keeps backing off
+void checkRescan(const std::string& folder, const std::string& file){
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0){
+        fprintf(stderr, "backoff: no pseudo-terminal, skipping the rescan check\n");
+        if (master >= 0)
+            close(master);
+        return;
+    }
+    std::string link = folder + "/ttyLater";
+
+    HeadsetManager m;
+    m.setBackoff(2000, 8000);
+    size_t later = m.addPort(link.c_str());
+    size_t broken = m.addPort(file.c_str());
+    m.addPorts((folder + "/none*").c_str(), THINKGEAR_DEFAULT_BAUD, 10);
+    m.start(1);
+    sleepMillis(50);
+    check(m.getStatus(later).failures == 1, "the absent path was not tried");
+    check(m.getStatus(broken).failures == 1, "the regular file was not tried");
+
+    check(symlink(ptsname(master), link.c_str()) == 0, "could not link the pseudo-terminal");
+    uint64_t end = Headset::nowMicros() + 500000;
+    while (Headset::nowMicros() < end && m.getStatus(later).state == thinkgear::DEVICE_MISSING)
+        sleepMillis(1);
+    check(m.getStatus(later).state != thinkgear::DEVICE_MISSING,
+          "a path that appeared was not opened before its backoff ended");
+    check(m.getStatus(broken).failures == 1,
+          "a path that exists but fails to open was retried by a rescan");
+    m.stop();
+    unlink(link.c_str());
+    close(master);
+}
+
+}  // namespace
+
+int main(){
+    char folder[] = "/tmp/backoffXXXXXX";
+    if (!mkdtemp(folder)){
+        perror("backoff: mkdtemp");
+        return 1;
+    }
+    std::string file = std::string(folder) + "/ttyFile";
+    FILE *f = fopen(file.c_str(), "w");
+    if (!f){
+        perror("backoff: fopen");
+        return 1;
+    }
+    fclose(f);
+
+    checkSchedule(file);
+    checkRescan(folder, file);
+
+    unlink(file.c_str());
+    rmdir(folder);
+    if (failures)
+        return 1;
+    printf("backoff: retries follow the schedule; rescans only hurry paths that were absent\n");
+    return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * bandcheck: checks the band powers BandBank (ThinkGearBands.h) keeps
+ * with its sliding DFT against a direct Hann-windowed DFT of the same
+ * last window samples, at every update of a long stream, for windows of
+ * 256 to 4096 samples.  Every band power must be within 0.5 of the direct
+ * one, so only the rounding to an integer may differ, however long the
+ * running sums have been sliding.
+ *
+ *   bandcheck [-s seconds] [-S seed]
+ *
+ *   -s seconds  raw samples fed per window length, in seconds (300)
+ *   -S seed     seed for the signal (1)
+ *
+ * The signal is a sine in every band, their amplitudes and frequencies
+ * wandering, on noise, in the range of real raw samples.
+ *
+ * Build and run with the Makefile in the parent directory: make check
+ */
+
+#include "ThinkGearBands.h"
+#include "ThinkGearSpectrum.h"
+#include "fuzzstream.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using thinkgear::BAND_LIMITS;
+using thinkgear::BandBank;
+
+namespace {
+
+// Largest difference allowed from the direct DFT: the rounding to an
+// integer, and a hair for the sums' drift when that lands on a half
+const double TOLERANCE = 0.5 + 1e-6;
+
+double uniform(Random& rnd){
+    return (double)(rnd.next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Raw samples with a sine in each band, each drifting in frequency and
+// amplitude, over noise
+void makeSignal(Random& rnd, size_t count, std::vector<int16_t>& out){
+    double hz[THINKGEAR_EEG_BANDS], amplitude[THINKGEAR_EEG_BANDS], phase[THINKGEAR_EEG_BANDS];
+    for (int b=0; b<THINKGEAR_EEG_BANDS; ++b){
+        hz[b] = BAND_LIMITS[b][0] + uniform(rnd) * (BAND_LIMITS[b][1] - BAND_LIMITS[b][0]);
+        amplitude[b] = 20 + uniform(rnd) * 200;
+        phase[b] = 0;
+    }
+    out.resize(count);
+    for (size_t i=0; i<count; ++i){
+        double v = (uniform(rnd) * 2 - 1) * 30;
+        for (int b=0; b<THINKGEAR_EEG_BANDS; ++b){
+            phase[b] += 2 * M_PI * hz[b] / THINKGEAR_RAW_RATE;
+            v += amplitude[b] * sin(phase[b]);
+            if (rnd.chance(256)){
+                hz[b] += (uniform(rnd) - 0.5) * 0.2;
+                hz[b] = hz[b] < BAND_LIMITS[b][0] ? BAND_LIMITS[b][0] :
+                        hz[b] > BAND_LIMITS[b][1] ? BAND_LIMITS[b][1] : hz[b];
+                amplitude[b] *= 0.9 + uniform(rnd) * 0.2;
+            }
+        }
+        out[i] = (int16_t)lrint(v);
+    }
+}
+
+// The bins of each band: those whose centre is in it, else the nearest
+// to its middle
+void bandBins(size_t window, std::vector<int> bins[THINKGEAR_EEG_BANDS]){
+    double binHz = (double)THINKGEAR_RAW_RATE / window;
+    for (int b=0; b<THINKGEAR_EEG_BANDS; ++b){
+        bins[b].clear();
+        for (int k=1; k<(int)window/2; ++k)
+            if (k * binHz >= BAND_LIMITS[b][0] && k * binHz <= BAND_LIMITS[b][1])
+                bins[b].push_back(k);
+        if (bins[b].empty())
+            bins[b].push_back((int)floor((BAND_LIMITS[b][0] + BAND_LIMITS[b][1]) / 2 / binHz + 0.5));
+    }
+}
+
+// A direct DFT of one window length: the Hann window and e^(-2 pi i m / window)
+struct Dft {
+    size_t window;
+    std::vector<double> hann, cosine, sine;
+
+    explicit Dft(size_t window) : window(window), hann(window), cosine(window), sine(window) {
+        for (size_t n=0; n<window; ++n){
+            hann[n] = 0.5 - 0.5 * cos(2 * M_PI * n / window);
+            cosine[n] = cos(-2 * M_PI * n / window);
+            sine[n] = sin(-2 * M_PI * n / window);
+        }
+    }
+
+    // Band powers of the window samples ending at @c end, straight from
+    // their Hann-windowed DFT, amplitudes scaled like Stft's
+    void powers(const int16_t *samples, size_t end, const std::vector<int> bins[THINKGEAR_EEG_BANDS],
+                double out[THINKGEAR_EEG_BANDS]) const {
+        const int16_t *x = samples + end - window;
+        double scale = 4.0 / window;
+        for (int b=0; b<THINKGEAR_EEG_BANDS; ++b){
+            out[b] = 0;
+            for (size_t j=0; j<bins[b].size(); ++j){
+                double re = 0, im = 0;
+                for (size_t n=0; n<window; ++n){
+                    size_t m = (bins[b][j] * n) & (window - 1);
+                    re += x[n] * hann[n] * cosine[m];
+                    im += x[n] * hann[n] * sine[m];
+                }
+                out[b] += (re*re + im*im) * scale * scale;
+            }
+        }
+    }
+};
+
+int usage(){
+    fprintf(stderr, "usage: bandcheck [-s seconds] [-S seed]\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    unsigned seconds = 300;
+    uint64_t seed = 1;
+    for (int i=1; i<argc; ++i){
+        if (strcmp(argv[i], "-s") == 0 && i+1 < argc)
+            seconds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-S") == 0 && i+1 < argc)
+            seed = strtoull(argv[++i], NULL, 10);
+        else
+            return usage();
+    }
+    if (seconds == 0)
+        return usage();
+
+    Random rnd(seed);
+    std::vector<int16_t> signal;
+    size_t count = (size_t)seconds * THINKGEAR_RAW_RATE;
+    makeSignal(rnd, count, signal);
+
+    unsigned long failures = 0, updates = 0;
+    double worst = 0;
+    for (size_t window=256; window<=4096; window*=2){
+        if (window > count)
+            break;
+        // Fewer checks for the longer windows, each of which costs more
+        size_t hop = window / 8 + 1;
+        BandBank bank;
+        bank.setup(hop, window);
+        std::vector<int> bins[THINKGEAR_EEG_BANDS];
+        bandBins(window, bins);
+        Dft dft(window);
+        // One sample at a time, so every update can be checked
+        for (size_t i=0; i<count; ++i){
+            if (bank.feed(&signal[i], 1) == 0)
+                continue;
+            double expected[THINKGEAR_EEG_BANDS];
+            dft.powers(&signal[0], i + 1, bins, expected);
+            for (int b=0; b<THINKGEAR_EEG_BANDS; ++b){
+                double e = fabs(bank.getPowers()[b] - expected[b]);
+                if (e > worst)
+                    worst = e;
+                if (e > TOLERANCE && failures++ < 10)
+                    fprintf(stderr, "bandcheck: window %u, sample %lu, band %d is %u, not %.2f\n",
+                            (unsigned)window, (unsigned long)i + 1, b,
+                            (unsigned)bank.getPowers()[b], expected[b]);
+            }
+            updates++;
+        }
+        if (bank.getUpdates() != (count - window) / hop + 1){
+            fprintf(stderr, "bandcheck: window %u updated %lu times, not %lu\n",
+                    (unsigned)window, (unsigned long)bank.getUpdates(),
+                    (unsigned long)((count - window) / hop + 1));
+            failures++;
+        }
+    }
+    if (failures)
+        return 1;
+    printf("bandcheck: %lu updates over %u s, every band within %.4f of a direct Hann DFT\n",
+           updates, seconds, worst);
+    return 0;
+}
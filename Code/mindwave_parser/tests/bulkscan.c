@@ -0,0 +1,214 @@
+/*
+ * bulkscan: checks every version of THINKGEAR_parseBuffer()'s bulk
+ * primitives this CPU can run (scalar, and on x86 SSE2 and AVX2) against
+ * the scalar one: the SyncByte pair scan at every length and alignment
+ * around the vector widths, with pairs, lone SyncBytes and runs of them
+ * at every position, and the Payload[] checksum.  Then parses the same
+ * streams with each version and checks parseBuffer() still matches
+ * parseByte().
+ *
+ *   bulkscan
+ *
+ * Includes the parser's source to reach its static functions, so it is
+ * C and links nothing else.
+ *
+ * Build and run with the Makefile in the parent directory: make check
+ */
+
+#include "ThinkGearStreamParser.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Longest buffer tried, in bytes past the alignment offset */
+#define MAX_LENGTH 200
+/* Stream parsed with each version */
+#define STREAM_BYTES (1 << 20)
+
+typedef struct {
+    const char *name;
+    unsigned int (*sum)( const unsigned char *bytes, size_t length );
+    const unsigned char *(*find)( const unsigned char *p, const unsigned char *end );
+} BulkOps;
+
+static uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+/* xorshift64* */
+static unsigned int
+below( unsigned int n ) {
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return (unsigned int)((rng * 0x2545F4914F6CDD1DULL) >> 33) % n;
+}
+
+static int failures = 0;
+
+static void
+fail( const BulkOps *ops, const char *what, size_t offset, size_t length ) {
+    if( failures++ < 10 ) {
+        fprintf( stderr, "bulkscan: %s %s differs from scalar at offset %lu, length %lu\n",
+                 ops->name, what, (unsigned long)offset, (unsigned long)length );
+    }
+}
+
+/* Fills @c n bytes with noise that holds no SyncByte */
+static void
+noise( unsigned char *p, size_t n ) {
+    size_t i;
+    for( i=0; i<n; i++ ) {
+        p[i] = (unsigned char)below( 256 );
+        if( p[i] == PARSER_SYNC_BYTE ) p[i] = 0x55;
+    }
+}
+
+static void
+checkScan( const BulkOps *ops ) {
+
+    static unsigned char buffer[64 + MAX_LENGTH + 64];
+    size_t offset, length, at, run;
+
+    for( offset=0; offset<32; offset++ ) {
+        unsigned char *p = buffer + offset;
+        for( length=0; length<=MAX_LENGTH; length++ ) {
+            /* Nothing, then a pair, a lone SyncByte or a run at every position */
+            noise( p, length );
+            if( ops->find( p, p+length ) != findSyncPairScalar( p, p+length ) )
+                fail( ops, "sync scan", offset, length );
+            for( at=0; at<length; at++ ) {
+                for( run=1; run<=3 && at+run<=length; run++ ) {
+                    noise( p, length );
+                    memset( p+at, PARSER_SYNC_BYTE, run );
+                    if( ops->find( p, p+length ) != findSyncPairScalar( p, p+length ) )
+                        fail( ops, "sync scan", offset, length );
+                }
+            }
+            /* Dense SyncBytes: pairs anywhere, often */
+            for( at=0; at<length; at++ )
+                p[at] = below( 3 ) ? (unsigned char)below( 256 ) : PARSER_SYNC_BYTE;
+            if( ops->find( p, p+length ) != findSyncPairScalar( p, p+length ) )
+                fail( ops, "sync scan", offset, length );
+
+            for( at=0; at<length; at++ ) p[at] = (unsigned char)below( 256 );
+            if( ops->sum( p, length ) != sumBytesScalar( p, length ) )
+                fail( ops, "checksum", offset, length );
+        }
+    }
+}
+
+/* The packets parsed: rows hashed as they are handed out */
+static uint64_t rowHash;
+
+static void
+hashRow( unsigned char extendedCodeLevel, unsigned char code, unsigned char numBytes,
+         const unsigned char *value, void *customData ) {
+    unsigned char i;
+    (void)customData;
+    rowHash = (rowHash ^ (uint64_t)((extendedCodeLevel << 16) | (code << 8) | numBytes)) *
+              0x100000001B3ULL;
+    for( i=0; i<numBytes; i++ ) rowHash = (rowHash ^ value[i]) * 0x100000001B3ULL;
+}
+
+/* Packets of random rows, some with a bad checksum, between runs of noise */
+static void
+makeStream( unsigned char *out, size_t length ) {
+    size_t at = 0, n, i;
+    unsigned char sum;
+    while( at + 4 + 169 < length ) {
+        if( below( 4 ) == 0 ) {
+            n = below( 48 );
+            for( i=0; i<n; i++ )
+                out[at++] = below( 4 ) ? (unsigned char)below( 256 ) : PARSER_SYNC_BYTE;
+            continue;
+        }
+        n = below( 8 ) ? 4 : below( 170 );
+        out[at++] = PARSER_SYNC_BYTE;
+        out[at++] = PARSER_SYNC_BYTE;
+        out[at++] = (unsigned char)n;
+        sum = 0;
+        for( i=0; i<n; i++ ) {
+            /* Mostly raw rows: 0x80 0x02 high low */
+            out[at] = n == 4 ? (unsigned char)(i == 0 ? 0x80 : i == 1 ? 2 : below( 256 )) :
+                               (unsigned char)below( 256 );
+            sum = (unsigned char)(sum + out[at++]);
+        }
+        out[at++] = below( 16 ) ? (unsigned char)~sum : (unsigned char)below( 256 );
+    }
+    while( at < length ) out[at++] = (unsigned char)below( 256 );
+}
+
+static void
+checkParse( const BulkOps *ops, const unsigned char *stream ) {
+
+    static ThinkGearStreamParser byByte, byBuffer;
+    uint64_t byteHash, bufferHash;
+    size_t at, n;
+    int resync;
+
+    for( resync=0; resync<2; resync++ ) {
+        THINKGEAR_initParser( &byByte, PARSER_TYPE_PACKETS, hashRow, NULL );
+        THINKGEAR_setResync( &byByte, (unsigned char)resync );
+        rowHash = 0xCBF29CE484222325ULL;
+        for( at=0; at<STREAM_BYTES; at++ ) THINKGEAR_parseByte( &byByte, stream[at] );
+        byteHash = rowHash;
+
+        THINKGEAR_initParser( &byBuffer, PARSER_TYPE_PACKETS, hashRow, NULL );
+        THINKGEAR_setResync( &byBuffer, (unsigned char)resync );
+        rowHash = 0xCBF29CE484222325ULL;
+        sumBytesImpl = ops->sum;
+        findSyncPairImpl = ops->find;
+        for( at=0; at<STREAM_BYTES; at+=n ) {
+            n = 1 + below( 700 );
+            if( n > STREAM_BYTES - at ) n = STREAM_BYTES - at;
+            THINKGEAR_parseBuffer( &byBuffer, stream+at, n );
+        }
+        bufferHash = rowHash;
+
+        if( byteHash != bufferHash ||
+            memcmp( &byByte.stats, &byBuffer.stats, sizeof(byByte.stats) ) != 0 ) {
+            fprintf( stderr, "bulkscan: %s parseBuffer() differs from parseByte(), resync %s\n",
+                     ops->name, resync ? "on" : "off" );
+            failures++;
+        }
+    }
+}
+
+int
+main( void ) {
+
+    BulkOps ops[3];
+    int count = 0, i;
+    unsigned char *stream;
+
+    ops[count].name = "scalar";
+    ops[count].sum = sumBytesScalar;
+    ops[count++].find = findSyncPairScalar;
+#ifdef PARSER_X86_SIMD
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "sse2" ) ) {
+        ops[count].name = "SSE2";
+        ops[count].sum = sumBytesSse2;
+        ops[count++].find = findSyncPairSse2;
+    }
+    if( __builtin_cpu_supports( "avx2" ) ) {
+        ops[count].name = "AVX2";
+        ops[count].sum = sumBytesAvx2;
+        ops[count++].find = findSyncPairAvx2;
+    }
+#endif
+
+    stream = malloc( STREAM_BYTES );
+    if( !stream ) return( 1 );
+    makeStream( stream, STREAM_BYTES );
+    for( i=0; i<count; i++ ) {
+        checkScan( &ops[i] );
+        checkParse( &ops[i], stream );
+    }
+    free( stream );
+    if( failures ) return( 1 );
+
+    printf( "bulkscan:" );
+    for( i=0; i<count; i++ ) printf( " %s", ops[i].name );
+    printf( " scan, checksum and parse the same\n" );
+    return( 0 );
+}
@@ -0,0 +1,118 @@
+/*
+ * eegrank: checks the band ranking EegData::feed() (ThinkGearEeg.h)
+ * builds with its sorting network against std::sort with
+ * EegData::compare.  Starting from every one of the 8! orders the last
+ * feed() can leave, with all powers different and with all equal, and
+ * then from the order random powers leave, with ties and without.  Every
+ * part's rank and ratio must match its place and share too.
+ *
+ *   eegrank [-n feeds] [-S seed]
+ *
+ *   -n feeds  random feeds after the exhaustive ones (1000000)
+ *   -S seed   seed for the random powers (1)
+ *
+ * Build and run with the Makefile in the parent directory: make check
+ */
+
+#include "ThinkGearEeg.h"
+#include "fuzzstream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+namespace {
+
+unsigned long failures = 0;
+
+// Feeds @c power and compares the ranking with std::sort's
+bool check(EegData& eeg, const unsigned int *power){
+    eeg.feed(power);
+
+    std::array<EegDataPart*, 8> expected;
+    EegDataPart *parts[8] = {
+        &eeg.delta, &eeg.theta, &eeg.lowAlpha, &eeg.highAlpha,
+        &eeg.lowBeta, &eeg.highBeta, &eeg.lowGamma, &eeg.midGamma
+    };
+    std::copy(parts, parts + 8, expected.begin());
+    std::sort(expected.begin(), expected.end(), EegData::compare);
+
+    unsigned long total = 0;
+    for (int i=0; i<8; ++i)
+        total += power[i];
+    bool ok = eeg.data == expected;
+    for (int i=0; i<8; ++i){
+        if (eeg.data[i]->rank != i || parts[i]->value != power[i] ||
+            parts[i]->ratio != (total ? (float)power[i] / (float)total : 0.0f))
+            ok = false;
+    }
+    if (!ok && failures++ < 10){
+        fprintf(stderr, "eegrank: powers");
+        for (int i=0; i<8; ++i)
+            fprintf(stderr, " %u", power[i]);
+        fprintf(stderr, " ranked");
+        for (int i=0; i<8; ++i)
+            fprintf(stderr, " %d", (int)eeg.data[i]->kind);
+        fprintf(stderr, "\n");
+    }
+    return ok;
+}
+
+int usage(){
+    fprintf(stderr, "usage: eegrank [-n feeds] [-S seed]\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    unsigned long feeds = 1000000;
+    uint64_t seed = 1;
+    for (int i=1; i<argc; ++i){
+        if (strcmp(argv[i], "-n") == 0 && i+1 < argc)
+            feeds = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-S") == 0 && i+1 < argc)
+            seed = strtoull(argv[++i], NULL, 10);
+        else
+            return usage();
+    }
+
+    // Every order the network can start from, with distinct and equal powers
+    static const unsigned int distinct[8] = { 7000, 300, 52000, 9, 810000, 44, 16777215, 2600 };
+    static const unsigned int equal[8] = { 5, 5, 5, 5, 5, 5, 5, 5 };
+    int order[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    unsigned long orders = 0;
+    do {
+        for (int pass=0; pass<2; ++pass){
+            EegData eeg;
+            EegDataPart *parts[8] = {
+                &eeg.delta, &eeg.theta, &eeg.lowAlpha, &eeg.highAlpha,
+                &eeg.lowBeta, &eeg.highBeta, &eeg.lowGamma, &eeg.midGamma
+            };
+            for (int i=0; i<8; ++i)
+                eeg.data[i] = parts[order[i]];
+            check(eeg, pass ? equal : distinct);
+        }
+        orders++;
+    } while (std::next_permutation(order, order + 8));
+
+    // Random 24-bit powers, each feed starting from the last one's order;
+    // small ranges give ties, zeros give a total of 0
+    Random rnd(seed);
+    EegData eeg;
+    for (unsigned long n=0; n<feeds; ++n){
+        unsigned int power[8];
+        unsigned range = rnd.chance(4) ? 1 + rnd.below(4) : 1 << 24;
+        for (int i=0; i<8; ++i)
+            power[i] = rnd.chance(64) ? 0 : rnd.below(range);
+        check(eeg, power);
+    }
+
+    if (failures){
+        fprintf(stderr, "eegrank: %lu rankings differ from std::sort\n", failures);
+        return 1;
+    }
+    printf("eegrank: %lu starting orders and %lu random feeds ranked as std::sort does\n",
+           orders, feeds);
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * fftcheck: checks the real FFT behind Stft (FftPlan in
+ * ThinkGearSpectrum.cpp, the built-in one or FFTW's) against a naive DFT
+ * in double precision, for every window length from 8 to 1024.  Every bin
+ * must be within 7e-6 of the DFT, relative to the largest bin.
+ *
+ *   fftcheck [-t trials] [-S seed]
+ *
+ *   -t trials  inputs per length, half noise, half a strong sine on weak
+ *              noise (16)
+ *   -S seed    seed for the inputs (1)
+ *
+ * Includes the spectrum source to reach FftPlan, which it keeps private.
+ *
+ * Build and run with the Makefile in the parent directory: make check
+ */
+
+#include "ThinkGearSpectrum.cpp"
+#include "fuzzstream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using thinkgear::FftPlan;
+
+namespace {
+
+// Largest error the transform may make, relative to the largest bin
+const double TOLERANCE = 7e-6;
+
+// A uniform value in [-1, 1)
+double uniform(Random& rnd){
+    return (double)(rnd.next() >> 11) * (2.0 / 9007199254740992.0) - 1;
+}
+
+// The worst relative error of @c plan over @c trials inputs
+double worstError(const FftPlan& plan, Random& rnd, int trials){
+    size_t n = plan.n;
+    std::vector<float> in(n), scratch(n), out(n + 2);
+    double worst = 0;
+    for (int t=0; t<trials; ++t){
+        double hz = 1 + rnd.below((unsigned)(n/2 - 1)) + uniform(rnd) * 0.5;
+        for (size_t i=0; i<n; ++i){
+            in[i] = (float)uniform(rnd);
+            if (t & 1)
+                in[i] = (float)(in[i] * 0.01 + 1000 * sin(2 * M_PI * hz * i / n));
+        }
+        scratch = in;
+        plan.execute(&scratch[0], &out[0]);
+
+        double largest = 0, error = 0;
+        for (size_t k=0; k<=n/2; ++k){
+            double re = 0, im = 0;
+            for (size_t j=0; j<n; ++j){
+                double a = -2 * M_PI * (double)((k * j) % n) / n;
+                re += in[j] * cos(a);
+                im += in[j] * sin(a);
+            }
+            double m = hypot(re, im), e = hypot(out[2*k] - re, out[2*k+1] - im);
+            if (m > largest)
+                largest = m;
+            if (e > error)
+                error = e;
+        }
+        if (error / largest > worst)
+            worst = error / largest;
+    }
+    return worst;
+}
+
+int usage(){
+    fprintf(stderr, "usage: fftcheck [-t trials] [-S seed]\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    int trials = 16;
+    uint64_t seed = 1;
+    for (int i=1; i<argc; ++i){
+        if (strcmp(argv[i], "-t") == 0 && i+1 < argc)
+            trials = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-S") == 0 && i+1 < argc)
+            seed = strtoull(argv[++i], NULL, 10);
+        else
+            return usage();
+    }
+    if (trials <= 0)
+        return usage();
+
+    Random rnd(seed);
+    int failures = 0;
+    double worst = 0;
+    for (size_t n=8; n<=1024; n*=2){
+        FftPlan plan(n);
+        double e = worstError(plan, rnd, trials);
+        if (e > TOLERANCE){
+            fprintf(stderr, "fftcheck: %u points are off by %.2g of the largest bin\n",
+                    (unsigned)n, e);
+            failures++;
+        }
+        if (e > worst)
+            worst = e;
+    }
+    if (failures)
+        return 1;
+    printf("fftcheck: 8 to 1024 points within %.2g of a naive DFT (tolerance %.0e)\n",
+           worst, TOLERANCE);
+    return 0;
+}
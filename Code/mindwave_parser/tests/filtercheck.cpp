@@ -0,0 +1,141 @@
+/*
+ * filtercheck: checks FilterBank (ThinkGearFilter.h).  The vector path,
+ * every headset of a group at once, must give exactly the floats the
+ * one-channel path does, for a number of headsets that leaves the last
+ * group part empty and blocks of every size.  Then mainsChain() must
+ * take a mains tone of amplitude 200 down to below 0.1 and leave an 8 Hz
+ * alpha tone as it was.
+ *
+ *   filtercheck [-c channels] [-S seed]
+ *
+ *   -c channels  headsets in the bank (100)
+ *   -S seed      seed for the samples and block sizes (1)
+ *
+ * Build and run with the Makefile in the parent directory: make check
+ */
+
+#include "ThinkGearFilter.h"
+#include "ThinkGearSpectrum.h"
+#include "fuzzstream.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using thinkgear::Biquad;
+using thinkgear::FilterBank;
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char *what){
+    if (!ok){
+        fprintf(stderr, "filtercheck: %s\n", what);
+        failures++;
+    }
+}
+
+// The vector and the one-channel path over the same random samples, in
+// blocks of random length, some longer than the bank's own blocks
+void checkPaths(const std::vector<Biquad>& chain, size_t channels, Random& rnd){
+    const size_t SAMPLES = 8 * THINKGEAR_RAW_RATE;
+    std::vector<std::vector<int16_t> > in(channels, std::vector<int16_t>(SAMPLES));
+    std::vector<std::vector<float> > grouped(channels, std::vector<float>(SAMPLES));
+    std::vector<std::vector<float> > scalar(channels, std::vector<float>(SAMPLES));
+    for (size_t c=0; c<channels; ++c)
+        for (size_t i=0; i<SAMPLES; ++i)
+            in[c][i] = (int16_t)((int)rnd.below(4096) - 2048);
+
+    FilterBank byGroup, byChannel;
+    byGroup.setup(chain, channels);
+    byChannel.setup(chain, channels);
+    std::vector<const int16_t*> inputs(channels);
+    std::vector<float*> outputs(channels);
+    for (size_t at=0; at<SAMPLES; ){
+        size_t n = 1 + rnd.below(rnd.chance(4) ? 700 : 64);
+        if (n > SAMPLES - at)
+            n = SAMPLES - at;
+        for (size_t c=0; c<channels; ++c){
+            inputs[c] = &in[c][at];
+            outputs[c] = &grouped[c][at];
+            byChannel.process(c, &in[c][at], &scalar[c][at], n);
+        }
+        byGroup.process(&inputs[0], &outputs[0], n);
+        at += n;
+    }
+    for (size_t c=0; c<channels; ++c){
+        if (memcmp(&grouped[c][0], &scalar[c][0], SAMPLES * sizeof(float)) != 0){
+            fprintf(stderr, "filtercheck: headset %u differs between the vector and scalar paths\n",
+                    (unsigned)c);
+            failures++;
+            return;
+        }
+    }
+}
+
+// Amplitude at @c hz of one channel's output over the last second of
+// @c seconds of a sine of amplitude 200 at @c hz: a whole number of Hz,
+// so it falls in one DFT bin and rounding the input to raw samples does
+// not count
+double amplitudeAfter(const std::vector<Biquad>& chain, int hz, int seconds){
+    FilterBank bank;
+    bank.setup(chain, 1);
+    std::vector<int16_t> in(THINKGEAR_RAW_RATE);
+    std::vector<float> out(THINKGEAR_RAW_RATE);
+    for (int s=0; s<seconds; ++s){
+        for (size_t i=0; i<in.size(); ++i)
+            in[i] = (int16_t)lrint(200 * sin(2 * M_PI * hz * i / THINKGEAR_RAW_RATE));
+        bank.process(0, &in[0], &out[0], in.size());
+    }
+    double re = 0, im = 0;
+    for (size_t i=0; i<out.size(); ++i){
+        double a = 2 * M_PI * hz * i / THINKGEAR_RAW_RATE;
+        re += out[i] * cos(a);
+        im += out[i] * sin(a);
+    }
+    return 2 * hypot(re, im) / out.size();
+}
+
+int usage(){
+    fprintf(stderr, "usage: filtercheck [-c channels] [-S seed]\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    size_t channels = 100;
+    uint64_t seed = 1;
+    for (int i=1; i<argc; ++i){
+        if (strcmp(argv[i], "-c") == 0 && i+1 < argc)
+            channels = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-S") == 0 && i+1 < argc)
+            seed = strtoull(argv[++i], NULL, 10);
+        else
+            return usage();
+    }
+    if (channels == 0)
+        return usage();
+
+    Random rnd(seed);
+    checkPaths(thinkgear::mainsChain(50), channels, rnd);
+    checkPaths(thinkgear::bandChain(2), channels, rnd);
+
+    // Ten seconds lets the 0.5 Hz high-pass settle
+    double hum50 = amplitudeAfter(thinkgear::mainsChain(50), 50, 10);
+    double hum60 = amplitudeAfter(thinkgear::mainsChain(60), 60, 10);
+    double harmonic = amplitudeAfter(thinkgear::mainsChain(50), 100, 10);
+    double alpha = amplitudeAfter(thinkgear::mainsChain(50), 8, 10);
+    check(hum50 < 0.1, "mainsChain(50) leaves too much of a 50 Hz tone");
+    check(hum60 < 0.1, "mainsChain(60) leaves too much of a 60 Hz tone");
+    check(harmonic < 0.1, "mainsChain(50) leaves too much of its 100 Hz harmonic");
+    check(alpha > 198 && alpha < 202, "mainsChain(50) changes an 8 Hz tone");
+
+    if (failures)
+        return 1;
+    printf("filtercheck: %u headsets the same by group and by channel; a 200 amplitude tone "
+           "at 50 Hz leaves %.2g, at 60 Hz %.2g, at 100 Hz %.2g, at 8 Hz %.1f\n",
+           (unsigned)channels, hum50, hum60, harmonic, alpha);
+    return 0;
+}
@@ -0,0 +1,144 @@
+#ifndef THINKGEAR_TESTS_FUZZSTREAM_H_
+#define THINKGEAR_TESTS_FUZZSTREAM_H_
+
+/*
+ * Damaged ThinkGear byte streams for the parser tests: valid packets of
+ * random DataRows (extended CODEs, raw rows of any length, band powers,
+ * dongle codes), packets with a bad checksum, an oversize PLENGTH or a row
+ * running past the end, runs of noise and SyncBytes, and dropped and
+ * flipped bytes; or a HeadsetSimulator stream with faults.
+ */
+
+#include "ThinkGearSimulator.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace {
+
+// About how long each generated stream is
+const size_t STREAM_BYTES = 1 << 20;
+
+// xorshift64*, so a seed gives the same streams everywhere
+struct Random {
+    uint64_t state;
+    explicit Random(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+    uint64_t next(){
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+    unsigned below(unsigned n){ return (unsigned)(next() % n); }
+    bool chance(unsigned inN){ return below(inN) == 0; }
+};
+
+// One DataRow of a random kind, or nothing if it would not fit in @c room
+inline void addRow(Random& rnd, std::vector<unsigned char>& payload, size_t room){
+    std::vector<unsigned char> row;
+    unsigned levels = rnd.chance(8) ? 1 + rnd.below(3) : 0;
+    row.insert(row.end(), levels, 0x55);
+    unsigned char code;
+    unsigned length;
+    switch (rnd.below(8)){
+        case 0: case 1: case 2:
+            code = 0x80;
+            length = rnd.chance(4) ? rnd.below(40) : 2;
+            break;
+        case 3:
+            code = 0x83;
+            length = rnd.chance(8) ? rnd.below(30) : 24;
+            break;
+        case 4:
+            code = (unsigned char)(0xD0 + rnd.below(5));
+            length = rnd.below(3);
+            break;
+        case 5:
+            code = (unsigned char)(0x80 + rnd.below(0x7F));
+            length = rnd.below(20);
+            break;
+        default:
+            code = (unsigned char)(1 + rnd.below(0x54));
+            length = 1;
+            break;
+    }
+    row.push_back(code);
+    if (code >= 0x80)
+        row.push_back((unsigned char)length);
+    for (unsigned i=0; i<length; ++i)
+        row.push_back((unsigned char)rnd.next());
+    if (row.size() <= room)
+        payload.insert(payload.end(), row.begin(), row.end());
+}
+
+inline void addPacket(Random& rnd, std::vector<unsigned char>& out){
+    std::vector<unsigned char> payload;
+    size_t limit = rnd.chance(16) ? 169 : 1 + rnd.below(40);
+    for (unsigned rows = rnd.below(6); rows > 0; --rows)
+        addRow(rnd, payload, limit - payload.size());
+    // Now and then a row that claims to run past the end
+    if (rnd.chance(32) && payload.size() + 2 <= limit){
+        payload.push_back(0x80);
+        payload.push_back(0xFF);
+    }
+    unsigned char sum = 0;
+    for (size_t i=0; i<payload.size(); ++i)
+        sum = (unsigned char)(sum + payload[i]);
+    out.push_back(0xAA);
+    out.push_back(0xAA);
+    out.push_back((unsigned char)payload.size());
+    out.insert(out.end(), payload.begin(), payload.end());
+    out.push_back(rnd.chance(16) ? (unsigned char)rnd.next() : (unsigned char)~sum);
+}
+
+// Packets mixed with noise and damage, about @c bytes long
+inline void makeStream(Random& rnd, size_t bytes, std::vector<unsigned char>& out){
+    out.clear();
+    while (out.size() < bytes){
+        switch (rnd.below(16)){
+            case 0:
+                for (unsigned n = rnd.below(64); n > 0; --n)
+                    out.push_back(rnd.chance(4) ? 0xAA : (unsigned char)rnd.next());
+                break;
+            case 1:
+                out.push_back(0xAA);
+                out.push_back(0xAA);
+                out.push_back((unsigned char)(170 + rnd.below(86)));
+                break;
+            case 2:
+                out.insert(out.end(), 1 + rnd.below(5), 0xAA);
+                break;
+            default:
+                addPacket(rnd, out);
+                break;
+        }
+    }
+    // Drop and flip bytes here and there
+    std::vector<unsigned char> damaged;
+    damaged.reserve(out.size());
+    for (size_t i=0; i<out.size(); ++i){
+        if (rnd.chance(400))
+            continue;
+        unsigned char b = out[i];
+        if (rnd.chance(400))
+            b ^= (unsigned char)(1 << rnd.below(8));
+        damaged.push_back(b);
+    }
+    out.swap(damaged);
+}
+
+inline void makeSimulatedStream(uint64_t seed, size_t bytes, std::vector<unsigned char>& out){
+    thinkgear::HeadsetSimulator sim(1, seed);
+    thinkgear::SimulatorFaults faults;
+    faults.dropRate = 1.0 / 300;
+    faults.corruptRate = 1.0 / 3000;
+    sim.setFaults(faults);
+    sim.setConnected(0);
+    out.clear();
+    for (uint64_t micros = 0; out.size() < bytes; micros += 100000)
+        sim.generate(micros, out);
+}
+
+}  // namespace
+
+#endif /* THINKGEAR_TESTS_FUZZSTREAM_H_ */
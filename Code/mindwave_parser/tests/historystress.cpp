@@ -0,0 +1,197 @@
+/*
+ * historystress: runs HistoryRing (ThinkGearHistory.h) flat out with one
+ * writer and several reader threads and fails on any value a reader is
+ * told is intact that is torn, or that the writer had already
+ * overwritten.
+ *
+ *   historystress [-n millions] [-r readers]
+ *
+ *   -n millions  values pushed through the ring, in millions (8)
+ *   -r readers   reader threads (3)
+ *
+ * First, on one thread, a span must be intact exactly until the writer
+ * overwrites its oldest value, a value or a whole run at a time.  Then
+ * across threads: every value is several words all derived from its
+ * sequence number, so a half-written one shows.  The writer pushes single
+ * values and runs that wrap the ring; readers take spans of random length
+ * with newest() and since() and check every value of each span
+ * isIntact() accepts.
+ *
+ * Build and run with the Makefile in the parent directory: make check
+ */
+
+#include "ThinkGearHistory.h"
+#include "fuzzstream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// A value that is only whole if all its words agree
+struct Value {
+    uint64_t seq;
+    uint64_t words[3];
+
+    void set(uint64_t s){
+        seq = s;
+        words[0] = ~s;
+        words[1] = s * 0x9E3779B97F4A7C15ULL;
+        words[2] = s ^ 0x5555555555555555ULL;
+    }
+    bool whole() const {
+        return words[0] == ~seq && words[1] == seq * 0x9E3779B97F4A7C15ULL &&
+               words[2] == (seq ^ 0x5555555555555555ULL);
+    }
+};
+
+std::atomic<int> failures(0);
+
+void fail(const char *what, uint64_t seq){
+    if (failures.fetch_add(1) < 10)
+        fprintf(stderr, "historystress: %s at value %llu\n", what, (unsigned long long)seq);
+}
+
+typedef thinkgear::HistoryRing<Value, 1024> History;
+
+// Single values and runs of up to twice the ring, which wrap it
+void write(History& history, uint64_t count, std::atomic<bool>& done){
+    Random rnd(1);
+    std::vector<Value> run(2 * History::capacity());
+    for (uint64_t s=history.getWritten(), end=s+count; s<end; ){
+        if (rnd.chance(2)){
+            Value v;
+            v.set(s++);
+            history.push(v);
+        } else {
+            size_t n = 1 + rnd.below(rnd.chance(64) ? run.size() : 64);
+            for (size_t i=0; i<n; ++i)
+                run[i].set(s + i);
+            history.push(&run[0], n);
+            s += n;
+        }
+    }
+    done.store(true);
+}
+
+struct ReadCounts {
+    unsigned long intact;
+    unsigned long torn;
+};
+
+void read(const History& history, unsigned seed, const std::atomic<bool>& done,
+          ReadCounts& counts){
+    Random rnd(seed);
+    std::vector<Value> copy(History::capacity());
+    uint64_t lastEnd = 0, from = 0;
+    counts.intact = counts.torn = 0;
+    while (!done.load() && failures.load(std::memory_order_relaxed) == 0){
+        History::Span s = rnd.chance(2) ? history.since(from) :
+                          history.newest(1 + rnd.below(History::capacity()));
+        size_t n = s.copyTo(&copy[0]);
+        if (!history.isIntact(s)){
+            counts.torn++;
+            continue;
+        }
+        counts.intact++;
+        if (s.end() < lastEnd)
+            fail("HistoryRing span ended before an earlier one", s.end());
+        lastEnd = s.end();
+        from = s.end();
+        for (size_t i=0; i<n; ++i){
+            if (!copy[i].whole()){
+                fail("HistoryRing passed a torn value as intact", s.start + i);
+                break;
+            }
+            if (copy[i].seq != s.start + i){
+                fail("HistoryRing passed an overwritten value as intact", s.start + i);
+                break;
+            }
+        }
+    }
+}
+
+// On one thread, where nothing races: a span must be intact exactly
+// while none of its values has been overwritten, however far the writer
+// got past it, a value or a run at a time
+void checkLaps(History& history){
+    std::vector<Value> run(2 * History::capacity());
+    uint64_t s = history.getWritten();
+    const size_t sizes[] = { 1, 7, History::capacity() / 2, History::capacity() };
+    for (size_t size : sizes){
+        for (size_t lap=0; lap <= History::capacity() + 2; ++lap){
+            for (int runs=0; runs<2; ++runs){
+                History::Span span = history.newest(size);
+                for (size_t n=0; n<lap; ){
+                    size_t k = runs ? lap - n : 1;
+                    for (size_t i=0; i<k; ++i)
+                        run[i].set(s + i);
+                    history.push(&run[0], k);
+                    s += k;
+                    n += k;
+                }
+                bool unchanged = true;
+                for (size_t i=0; i<span.size(); ++i)
+                    unchanged = unchanged && span[i].whole() && span[i].seq == span.start + i;
+                if (history.isIntact(span) != unchanged)
+                    fail(unchanged ? "HistoryRing called an untouched span torn" :
+                                     "HistoryRing called an overwritten span intact", span.start);
+            }
+        }
+    }
+}
+
+int usage(){
+    fprintf(stderr, "usage: historystress [-n millions] [-r readers]\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    uint64_t count = 8;
+    unsigned readers = 3;
+    for (int i=1; i<argc; ++i){
+        if (strcmp(argv[i], "-n") == 0 && i+1 < argc)
+            count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i+1 < argc)
+            readers = atoi(argv[++i]);
+        else
+            return usage();
+    }
+    if (count == 0 || readers == 0)
+        return usage();
+    count *= 1000000;
+
+    static History history;
+    std::vector<Value> fill(History::capacity());
+    for (size_t i=0; i<fill.size(); ++i)
+        fill[i].set(i);
+    history.push(&fill[0], fill.size());
+    checkLaps(history);
+    if (failures)
+        return 1;
+
+    std::atomic<bool> done(false);
+    std::vector<ReadCounts> counts(readers);
+    std::vector<std::thread> threads;
+    for (unsigned r=0; r<readers; ++r)
+        threads.push_back(std::thread(read, std::cref(history), r + 2, std::cref(done),
+                                      std::ref(counts[r])));
+    write(history, count, done);
+    unsigned long intact = 0, torn = 0;
+    for (unsigned r=0; r<readers; ++r){
+        threads[r].join();
+        intact += counts[r].intact;
+        torn += counts[r].torn;
+    }
+    if (failures)
+        return 1;
+    printf("historystress: %llu values written; %lu spans intact and right, %lu caught torn\n",
+           (unsigned long long)count, intact, torn);
+    return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * parsefuzz: feeds the same noisy byte streams to THINKGEAR_parseByte(),
+ * one byte at a time, and to THINKGEAR_parseBuffer(), in chunks of random
+ * size, and fails unless both hand out the same DataRows and frames, fill
+ * the raw ring the same way and end with the same counters and state.
+ *
+ *   parsefuzz [-n rounds] [-S seed]
+ *
+ *   -n rounds  streams to try, about 1 MB each (16)
+ *   -S seed    first seed; round r uses seed + r (1)
+ *
+ * The streams are generated packets and noise or, every other one, a
+ * HeadsetSimulator with faults (see fuzzstream.h).  Every stream is
+ * parsed with resync off and on, by a DataRow parser and by a frame
+ * parser.
+ *
+ * Build and run with the Makefile in the parent directory: make check
+ */
+
+#include "ThinkGearStreamParser.h"
+#include "fuzzstream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+const uint16_t RING_SIZE = 1024;
+
+// Everything a parser handed out, folded into a hash
+struct Output {
+    uint64_t hash;
+    uint64_t calls;
+    int16_t ring[RING_SIZE];
+
+    void add(const void *data, size_t n){
+        const unsigned char *p = static_cast<const unsigned char*>(data);
+        for (size_t i=0; i<n; ++i)
+            hash = (hash ^ p[i]) * 0x100000001B3ULL;
+    }
+};
+
+void handleDataValue(unsigned char extendedCodeLevel, unsigned char code, unsigned char numBytes,
+                     const unsigned char *value, void *customData){
+    Output& o = *static_cast<Output*>(customData);
+    unsigned char head[3] = { extendedCodeLevel, code, numBytes };
+    o.add(head, 3);
+    o.add(value, numBytes);
+    o.calls++;
+}
+
+void handleFrame(const ThinkGearFrame *frame, void *customData){
+    Output& o = *static_cast<Output*>(customData);
+    o.add(frame, sizeof(*frame));
+    o.calls++;
+}
+
+struct Run {
+    ThinkGearStreamParser parser;
+    ThinkGearFrame frame;
+    Output out;
+    long packets;
+};
+
+void start(Run& r, bool frames, bool resync){
+    memset(&r, 0, sizeof(r));
+    r.out.hash = 0xCBF29CE484222325ULL;
+    if (frames)
+        THINKGEAR_initFrameParser(&r.parser, &r.frame, handleFrame, handleDataValue, &r.out);
+    else
+        THINKGEAR_initParser(&r.parser, PARSER_TYPE_PACKETS, handleDataValue, &r.out);
+    THINKGEAR_setResync(&r.parser, resync);
+    THINKGEAR_setRawRing(&r.parser, r.out.ring, RING_SIZE);
+}
+
+bool same(const Run& a, const Run& b){
+    return a.out.hash == b.out.hash && a.out.calls == b.out.calls &&
+           a.packets == b.packets &&
+           memcmp(a.out.ring, b.out.ring, sizeof(a.out.ring)) == 0 &&
+           a.parser.rawRingHead == b.parser.rawRingHead &&
+           memcmp(&a.parser.stats, &b.parser.stats, sizeof(a.parser.stats)) == 0 &&
+           a.parser.state == b.parser.state && a.parser.lastByte == b.parser.lastByte &&
+           a.parser.recovering == b.parser.recovering;
+}
+
+int usage(){
+    fprintf(stderr, "usage: parsefuzz [-n rounds] [-S seed]\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    unsigned rounds = 16;
+    uint64_t seed = 1;
+    for (int i=1; i<argc; ++i){
+        if (strcmp(argv[i], "-n") == 0 && i+1 < argc)
+            rounds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-S") == 0 && i+1 < argc)
+            seed = strtoull(argv[++i], NULL, 10);
+        else
+            return usage();
+    }
+
+    static Run byByte, byBuffer;
+    std::vector<unsigned char> stream;
+    unsigned long long bytes = 0, packets = 0;
+    for (unsigned r=0; r<rounds; ++r){
+        Random rnd(seed + r);
+        if (r & 1)
+            makeSimulatedStream(seed + r, STREAM_BYTES, stream);
+        else
+            makeStream(rnd, STREAM_BYTES, stream);
+
+        for (int config=0; config<4; ++config){
+            bool frames = config & 1, resync = (config & 2) != 0;
+            // parseBuffer() counts Packets recovered by resync, which
+            // parseByte() hands out while returning -2 for the failed one
+            start(byByte, frames, resync);
+            for (size_t i=0; i<stream.size(); ++i)
+                THINKGEAR_parseByte(&byByte.parser, stream[i]);
+            byByte.packets = byByte.parser.stats.packetsOk;
+
+            start(byBuffer, frames, resync);
+            for (size_t at=0; at<stream.size(); ){
+                // Mostly read()-sized chunks, sometimes single bytes
+                size_t n = rnd.chance(8) ? 1 + rnd.below(3) : 1 + rnd.below(700);
+                if (n > stream.size() - at)
+                    n = stream.size() - at;
+                byBuffer.packets += THINKGEAR_parseBuffer(&byBuffer.parser, &stream[at], n);
+                at += n;
+            }
+
+            if (!same(byByte, byBuffer)){
+                fprintf(stderr, "parsefuzz: seed %llu, %s parser, resync %s: parseBuffer() "
+                        "differs from parseByte()\n", (unsigned long long)(seed + r),
+                        frames ? "frame" : "DataRow", resync ? "on" : "off");
+                return 1;
+            }
+            bytes += stream.size();
+            packets += byByte.parser.stats.packetsOk;
+        }
+    }
+    printf("parsefuzz: %u streams, %.1f MB and %llu packets parsed both ways, no differences\n",
+           rounds, bytes / 1e6, packets);
+    return 0;
+}
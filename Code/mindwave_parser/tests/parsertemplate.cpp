@@ -0,0 +1,200 @@
+/*
+ * parsertemplate: checks thinkgear::Parser (ThinkGearParser.h) against
+ * the C parser.  A Parser without a CODE list must hand out exactly the
+ * DataRows THINKGEAR_initParser()'s callback gets, byte by byte and in
+ * chunks, with resync off and on; one with a list must hand out only the
+ * listed (level, CODE) pairs, and nothing else.
+ *
+ *   parsertemplate [-n rounds] [-S seed]
+ *
+ *   -n rounds  streams to try, about 1 MB each (8)
+ *   -S seed    first seed; round r uses seed + r (1)
+ *
+ * Build and run with the Makefile in the parent directory: make check
+ */
+
+#include "ThinkGearParser.h"
+#include "ThinkGearStreamParser.h"
+#include "fuzzstream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using thinkgear::extendedCode;
+
+namespace {
+
+// The DataRows a parser handed out, folded into a hash
+struct Rows {
+    uint64_t hash;
+    uint64_t count;
+
+    Rows() : hash(0xCBF29CE484222325ULL), count(0) {}
+    void add(unsigned char extendedCodeLevel, unsigned char code, unsigned char numBytes,
+             const unsigned char *value){
+        unsigned char head[3] = { extendedCodeLevel, code, numBytes };
+        for (int i=0; i<3; ++i)
+            hash = (hash ^ head[i]) * 0x100000001B3ULL;
+        for (int i=0; i<numBytes; ++i)
+            hash = (hash ^ value[i]) * 0x100000001B3ULL;
+        count++;
+    }
+    bool operator==(const Rows& o) const { return hash == o.hash && count == o.count; }
+};
+
+struct Collect {
+    Rows rows;
+    void operator()(unsigned char extendedCodeLevel, unsigned char code, unsigned char numBytes,
+                    const unsigned char *value){
+        rows.add(extendedCodeLevel, code, numBytes, value);
+    }
+};
+
+// The list FilteredParser takes, for the C side to filter by hand
+bool listed(unsigned char extendedCodeLevel, unsigned char code){
+    unsigned c = extendedCode(extendedCodeLevel, code);
+    return c == PARSER_CODE_RAW_SIGNAL || c == PARSER_CODE_ASIC_EEG_POWER_INT ||
+           c == extendedCode(1, PARSER_CODE_RAW_SIGNAL);
+}
+
+typedef thinkgear::Parser<Collect> AllParser;
+typedef thinkgear::Parser<Collect, PARSER_CODE_RAW_SIGNAL, PARSER_CODE_ASIC_EEG_POWER_INT,
+                          extendedCode(1, PARSER_CODE_RAW_SIGNAL)> FilteredParser;
+
+struct Reference {
+    Rows all;
+    Rows filtered;
+};
+
+void handleDataValue(unsigned char extendedCodeLevel, unsigned char code, unsigned char numBytes,
+                     const unsigned char *value, void *customData){
+    Reference& r = *static_cast<Reference*>(customData);
+    r.all.add(extendedCodeLevel, code, numBytes, value);
+    if (listed(extendedCodeLevel, code))
+        r.filtered.add(extendedCodeLevel, code, numBytes, value);
+}
+
+int failures = 0;
+
+void check(bool ok, const char *what){
+    if (!ok){
+        fprintf(stderr, "parsertemplate: %s\n", what);
+        failures++;
+    }
+}
+
+// One packet with a raw row behind an EXCODE byte, a plain raw row and an
+// attention row
+void checkExtendedRows(){
+    const unsigned char payload[] = {
+        0x55, 0x80, 0x02, 0x12, 0x34,
+        0x80, 0x02, 0x56, 0x78,
+        0x04, 0x40
+    };
+    std::vector<unsigned char> packet(2, 0xAA);
+    packet.push_back(sizeof(payload));
+    unsigned char sum = 0;
+    for (size_t i=0; i<sizeof(payload); ++i){
+        packet.push_back(payload[i]);
+        sum = (unsigned char)(sum + payload[i]);
+    }
+    packet.push_back((unsigned char)~sum);
+
+    thinkgear::Parser<Collect, PARSER_CODE_RAW_SIGNAL> rawOnly;
+    check(rawOnly.parse(&packet[0], packet.size()) == 1, "raw-only parser missed the packet");
+    Rows expected;
+    expected.add(0, 0x80, 2, payload + 7);
+    check(rawOnly.getHandler().rows == expected,
+          "raw-only parser was handed something besides the level 0 raw row");
+
+    thinkgear::Parser<Collect, extendedCode(1, PARSER_CODE_RAW_SIGNAL)> extendedOnly;
+    extendedOnly.parse(&packet[0], packet.size());
+    Rows expectedExtended;
+    expectedExtended.add(1, 0x80, 2, payload + 3);
+    check(extendedOnly.getHandler().rows == expectedExtended,
+          "extended raw parser was handed something besides the level 1 raw row");
+
+    AllParser all;
+    all.parse(&packet[0], packet.size());
+    check(all.getHandler().rows.count == 3, "parser without a list skipped rows");
+}
+
+int usage(){
+    fprintf(stderr, "usage: parsertemplate [-n rounds] [-S seed]\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    unsigned rounds = 8;
+    uint64_t seed = 1;
+    for (int i=1; i<argc; ++i){
+        if (strcmp(argv[i], "-n") == 0 && i+1 < argc)
+            rounds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-S") == 0 && i+1 < argc)
+            seed = strtoull(argv[++i], NULL, 10);
+        else
+            return usage();
+    }
+
+    checkExtendedRows();
+
+    static ThinkGearStreamParser c;
+    static AllParser all;
+    static FilteredParser filtered, byByte;
+    std::vector<unsigned char> stream;
+    unsigned long long rows = 0;
+    for (unsigned r=0; r<rounds; ++r){
+        Random rnd(seed + r);
+        if (r & 1)
+            makeSimulatedStream(seed + r, STREAM_BYTES, stream);
+        else
+            makeStream(rnd, STREAM_BYTES, stream);
+
+        for (int resync=0; resync<2; ++resync){
+            Reference ref;
+            THINKGEAR_initParser(&c, PARSER_TYPE_PACKETS, handleDataValue, &ref);
+            THINKGEAR_setResync(&c, resync);
+            all = AllParser();
+            filtered = FilteredParser();
+            byByte = FilteredParser();
+            all.setResync(resync);
+            filtered.setResync(resync);
+            byByte.setResync(resync);
+
+            long cPackets = 0, packets = 0;
+            for (size_t at=0; at<stream.size(); ){
+                size_t n = 1 + rnd.below(700);
+                if (n > stream.size() - at)
+                    n = stream.size() - at;
+                cPackets += THINKGEAR_parseBuffer(&c, &stream[at], n);
+                packets += all.parse(&stream[at], n);
+                filtered.parse(&stream[at], n);
+                at += n;
+            }
+            for (size_t i=0; i<stream.size(); ++i)
+                byByte.parseByte(stream[i]);
+
+            check(all.getHandler().rows == ref.all && packets == cPackets,
+                  "parse() without a list differs from the C parser");
+            check(cPackets == (long)c.stats.packetsOk,
+                  "parseBuffer() did not count every Packet, recovered ones included");
+            check(filtered.getHandler().rows == ref.filtered,
+                  "parse() with a list differs from the filtered C parser");
+            check(byByte.getHandler().rows == ref.filtered,
+                  "parseByte() differs from the filtered C parser");
+            if (failures){
+                fprintf(stderr, "parsertemplate: on seed %llu, resync %s\n",
+                        (unsigned long long)(seed + r), resync ? "on" : "off");
+                return 1;
+            }
+            rows += ref.all.count;
+        }
+    }
+    if (failures)
+        return 1;
+    printf("parsertemplate: %u streams, %llu DataRows, same as the C parser\n", rounds, rows);
+    return 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * readerstall: checks that a threaded Headset (ThinkGearHeadset.h) keeps
+ * every packet while the application is slow to drain() it.  A
+ * HeadsetSimulator streams in real time into a pseudo-terminal, like
+ * tools/tgsim, the Headset reads it with startThread(), and the main
+ * thread only drains every 200 ms.  Every raw sample the simulator sent
+ * must reach the frame callback, in order, and getDroppedFrames() must
+ * stay 0.
+ *
+ *   readerstall [-s seconds] [-d millis] [-S seed]
+ *
+ *   -s seconds  how long the simulator streams (3)
+ *   -d millis   sleep between drain() calls (200)
+ *   -S seed     simulator seed (1)
+ *
+ * Build and run with the Makefile in the parent directory: make check
+ */
+
+#include "ThinkGearHeadset.h"
+#include "ThinkGearSimulator.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <functional>
+#include <thread>
+#include <vector>
+
+using thinkgear::Headset;
+using thinkgear::HeadsetSimulator;
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char *what){
+    if (!ok){
+        fprintf(stderr, "readerstall: %s\n", what);
+        failures++;
+    }
+}
+
+// Streams the simulator into @c master as its bytes fall due, keeping a
+// copy of all of them in @c sent
+void stream(int master, uint64_t seed, uint64_t micros, std::vector<unsigned char>& sent){
+    HeadsetSimulator sim(1, seed);
+    uint64_t start = Headset::nowMicros();
+    sim.setConnected(start);
+    std::vector<unsigned char> out;
+    for (uint64_t now = start; now < start + micros; now = Headset::nowMicros()){
+        out.clear();
+        sim.generate(now, out);
+        sent.insert(sent.end(), out.begin(), out.end());
+        for (size_t at=0; at<out.size(); ){
+            ssize_t w = write(master, &out[at], out.size() - at);
+            if (w <= 0){
+                perror("readerstall: write");
+                return;
+            }
+            at += (size_t)w;
+        }
+        uint64_t next = sim.nextMicros();
+        now = Headset::nowMicros();
+        if (next > now)
+            usleep((useconds_t)(next - now));
+    }
+}
+
+// The raw samples the frame callback was handed
+void collect(const ThinkGearFrame& frame, uint64_t micros, void *customData){
+    (void)micros;
+    std::vector<int16_t>& samples = *(std::vector<int16_t>*)customData;
+    if (frame.present & THINKGEAR_FRAME_RAW)
+        samples.insert(samples.end(), frame.raw, frame.raw + frame.numRaw);
+}
+
+// The same, for the samples parsed straight from the bytes sent
+void collectSent(const ThinkGearFrame *frame, void *customData){
+    collect(*frame, 0, customData);
+}
+
+int usage(){
+    fprintf(stderr, "usage: readerstall [-s seconds] [-d millis] [-S seed]\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    unsigned seconds = 3, millis = 200;
+    uint64_t seed = 1;
+    for (int i=1; i<argc; ++i){
+        if (strcmp(argv[i], "-s") == 0 && i+1 < argc)
+            seconds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i+1 < argc)
+            millis = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-S") == 0 && i+1 < argc)
+            seed = strtoull(argv[++i], NULL, 10);
+        else
+            return usage();
+    }
+    if (seconds == 0)
+        return usage();
+
+    // A raw slave kept open, as tgsim does, so nothing is echoed or lost
+    // between the Headset's opens
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    const char *name = master >= 0 && grantpt(master) == 0 && unlockpt(master) == 0 ?
+                       ptsname(master) : NULL;
+    int slave = name ? open(name, O_RDWR | O_NOCTTY) : -1;
+    struct termios tio;
+    if (slave < 0 || tcgetattr(slave, &tio) != 0){
+        fprintf(stderr, "readerstall: no pseudo-terminal, skipping\n");
+        return 0;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    std::vector<int16_t> received;
+    Headset h;
+    h.setAutoConnect(false);
+    h.setFrameCallback(collect, &received);
+    check(h.startThread(name, THINKGEAR_DEFAULT_BAUD, 10), "startThread() failed");
+    // Opening flushes the port, so only stream once it is open
+    for (int i=0; i<100 && !h.isOpen(); ++i)
+        usleep(10000);
+    check(h.isOpen(), "the reader thread did not open the pseudo-terminal");
+
+    std::vector<unsigned char> sent;
+    std::thread writer(stream, master, seed, seconds * 1000000ULL, std::ref(sent));
+    size_t drains = 0, most = 0;
+    for (uint64_t end = Headset::nowMicros() + seconds * 1000000ULL + 300000;
+         Headset::nowMicros() < end; ){
+        size_t n = h.drain();
+        if (n > most)
+            most = n;
+        drains++;
+        usleep(millis * 1000);
+    }
+    writer.join();
+    usleep(100000);
+    h.drain();
+    check(h.getDroppedFrames() == 0, "packets were dropped between drain() calls");
+    h.close();
+
+    std::vector<int16_t> expected;
+    ThinkGearStreamParser parser;
+    ThinkGearFrame frame;
+    THINKGEAR_initFrameParser(&parser, &frame, collectSent, NULL, &expected);
+    THINKGEAR_parseBuffer(&parser, sent.empty() ? NULL : &sent[0], sent.size());
+
+    check(expected.size() >= seconds * 500, "the simulator sent too few raw samples");
+    if (received.size() != expected.size()){
+        fprintf(stderr, "readerstall: %lu raw samples arrived of %lu sent\n",
+                (unsigned long)received.size(), (unsigned long)expected.size());
+        failures++;
+    }
+    for (size_t i=0; i<received.size() && i<expected.size(); ++i){
+        if (received[i] != expected[i]){
+            fprintf(stderr, "readerstall: raw sample %lu is %d, not %d\n",
+                    (unsigned long)i, received[i], expected[i]);
+            failures++;
+            break;
+        }
+    }
+    close(slave);
+    close(master);
+
+    if (failures)
+        return 1;
+    printf("readerstall: %lu raw samples in order through %lu drain() calls %u ms apart, "
+           "up to %lu packets each, none dropped\n", (unsigned long)received.size(),
+           (unsigned long)drains, millis, (unsigned long)most);
+    return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * ringstress: runs SpscRing (ThinkGearRing.h) flat out between a
+ * producer and a consumer thread and fails on any value that arrives
+ * torn, out of order or twice.
+ *
+ *   ringstress [-n millions]
+ *
+ *   -n millions  values pushed through the ring, in millions (8)
+ *
+ * Every value is several words all derived from its sequence number, so a
+ * half-written one shows.  The consumer must get every value, in order.
+ *
+ * Build and run with the Makefile in the parent directory: make check
+ */
+
+#include "ThinkGearRing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+namespace {
+
+// A value that is only whole if all its words agree
+struct Value {
+    uint64_t seq;
+    uint64_t words[3];
+
+    void set(uint64_t s){
+        seq = s;
+        words[0] = ~s;
+        words[1] = s * 0x9E3779B97F4A7C15ULL;
+        words[2] = s ^ 0x5555555555555555ULL;
+    }
+    bool whole() const {
+        return words[0] == ~seq && words[1] == seq * 0x9E3779B97F4A7C15ULL &&
+               words[2] == (seq ^ 0x5555555555555555ULL);
+    }
+};
+
+std::atomic<int> failures(0);
+
+void fail(const char *what, uint64_t seq){
+    if (failures.fetch_add(1) < 10)
+        fprintf(stderr, "ringstress: %s at value %llu\n", what, (unsigned long long)seq);
+}
+
+typedef thinkgear::SpscRing<Value, 64> Queue;
+
+// Alternates push() with tryPushSlot()/commitPush()
+void produce(Queue& queue, uint64_t count){
+    for (uint64_t s=0; s<count; ){
+        if (s & 1){
+            Value *slot = queue.tryPushSlot();
+            if (!slot){
+                std::this_thread::yield();
+                continue;
+            }
+            slot->set(s);
+            queue.commitPush();
+        } else {
+            Value v;
+            v.set(s);
+            if (!queue.push(v)){
+                std::this_thread::yield();
+                continue;
+            }
+        }
+        ++s;
+    }
+}
+
+// Alternates pop() with front()/popFront()
+void consume(Queue& queue, uint64_t count){
+    for (uint64_t s=0; s<count && failures.load(std::memory_order_relaxed) == 0; ){
+        Value v;
+        if (s & 1){
+            const Value *oldest = queue.front();
+            if (!oldest){
+                std::this_thread::yield();
+                continue;
+            }
+            v = *oldest;
+            queue.popFront();
+        } else if (!queue.pop(v)){
+            std::this_thread::yield();
+            continue;
+        }
+        if (!v.whole())
+            fail("SpscRing handed out a torn value", s);
+        else if (v.seq != s)
+            fail("SpscRing handed out a value out of order", s);
+        ++s;
+    }
+}
+
+int usage(){
+    fprintf(stderr, "usage: ringstress [-n millions]\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    uint64_t count = 8;
+    for (int i=1; i<argc; ++i){
+        if (strcmp(argv[i], "-n") == 0 && i+1 < argc)
+            count = atoi(argv[++i]);
+        else
+            return usage();
+    }
+    if (count == 0)
+        return usage();
+    count *= 1000000;
+
+    static Queue queue;
+    std::thread producer(produce, std::ref(queue), count);
+    consume(queue, count);
+    if (failures)
+        exit(1);    // the producer may be stuck on a full ring
+    producer.join();
+    printf("ringstress: %llu values through SpscRing in order\n", (unsigned long long)count);
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * tgarduino: runs the raw samples of a capture file (see
+ * ThinkGearCapture.h) through the host model of the robot's ArduinoFFT
+ * (see ThinkGearArduinoFft.h) and prints what the robot would have sent
+ * for each transform, in its own serial format:
+ *
+ *   fft_input=[ ... ];      the real parts after fft_run()
+ *   fft_lin_out=[ ... ];    or fft_log_out, fft_lin_out8, fft_oct_out
+ *
+ * so the output can be compared line for line with a log of the robot.
+ *
+ *   tgarduino [-n fft_n] [-h hop] [-o lin|log|lin8|octave] [-S scale]
+ *             [-W] [-q] capture.tgc
+ *
+ *   -n fft_n   FFT_N, 16 to 256 (128, as on the robot)
+ *   -h hop     samples between transforms (fft_n)
+ *   -o output  the fft_mag_ function to run (lin)
+ *   -S scale   SCALE for lin8 (1)
+ *   -W         skip fft_window(), as a sketch built with WINDOW 0
+ *   -q         print only how many transforms a second were computed
+ *
+ * Build with the Makefile in the parent directory: make tools
+ */
+
+#include "ThinkGearArduinoFft.h"
+#include "ThinkGearCapture.h"
+#include "ThinkGearStreamParser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+namespace {
+
+// Transforms computed per call
+const size_t BATCH = 1024;
+
+void handleFrame(const ThinkGearFrame *frame, void *customData){
+    std::vector<int16_t>& samples = *static_cast<std::vector<int16_t>*>(customData);
+    samples.insert(samples.end(), frame->raw, frame->raw + frame->numRaw);
+}
+
+void handleDataValue(unsigned char, unsigned char, unsigned char,
+                     const unsigned char *, void *){
+}
+
+template <class T>
+void printArray(const char *name, const T *values, size_t count, size_t stride){
+    printf("%s=[ ", name);
+    for (size_t i=0; i<count; ++i)
+        printf("%d ", (int)values[i * stride]);
+    printf("];\r\n");
+}
+
+int usage(){
+    fprintf(stderr, "usage: tgarduino [-n fft_n] [-h hop] [-o lin|log|lin8|octave] "
+            "[-S scale] [-W] [-q] capture.tgc\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    size_t n = 128, hop = 0;
+    const char *output = "lin";
+    unsigned scale = 1;
+    bool windowed = true, quiet = false;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; ++arg){
+        if (strcmp(argv[arg], "-n") == 0 && arg+1 < argc)
+            n = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-h") == 0 && arg+1 < argc)
+            hop = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-o") == 0 && arg+1 < argc)
+            output = argv[++arg];
+        else if (strcmp(argv[arg], "-S") == 0 && arg+1 < argc)
+            scale = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-W") == 0)
+            windowed = false;
+        else if (strcmp(argv[arg], "-q") == 0)
+            quiet = true;
+        else
+            return usage();
+    }
+    thinkgear::ArduinoFft fft;
+    bool known = strcmp(output, "lin") == 0 || strcmp(output, "log") == 0 ||
+                 strcmp(output, "lin8") == 0 || strcmp(output, "octave") == 0;
+    if (arg + 1 != argc || !fft.setup(n) || !known || scale < 1 || scale > 256)
+        return usage();
+    if (hop == 0)
+        hop = n;
+
+    thinkgear::CaptureReader reader;
+    if (!reader.open(argv[arg])){
+        fprintf(stderr, "%s: not a capture file\n", argv[arg]);
+        return 1;
+    }
+    static ThinkGearStreamParser parser;
+    static ThinkGearFrame frame;
+    std::vector<int16_t> samples;
+    THINKGEAR_initFrameParser(&parser, &frame, handleFrame, handleDataValue, &samples);
+    THINKGEAR_setResync(&parser, 1);
+    thinkgear::CaptureChunk chunk;
+    while (reader.next(chunk))
+        THINKGEAR_parseBuffer(&parser, chunk.bytes, chunk.numBytes);
+
+    size_t total = samples.size() < n ? 0 : (samples.size() - n) / hop + 1;
+    size_t perTransform = strcmp(output, "octave") == 0 ? fft.getOctaves() : n / 2;
+    std::vector<int16_t> input(BATCH * 2 * n);
+    std::vector<uint16_t> lin(BATCH * perTransform);
+    std::vector<uint8_t> bytes(BATCH * perTransform);
+    double seconds = 0;
+    for (size_t done=0; done<total; done+=BATCH){
+        size_t count = total - done < BATCH ? total - done : BATCH;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        fft.load(&samples[done * hop], hop, &input[0], count);
+        if (windowed)
+            fft.window(&input[0], count);
+        fft.reorder(&input[0], count);
+        fft.run(&input[0], count);
+        if (strcmp(output, "lin") == 0)
+            fft.magLin(&input[0], &lin[0], count);
+        else if (strcmp(output, "log") == 0)
+            fft.magLog(&input[0], &bytes[0], count);
+        else if (strcmp(output, "lin8") == 0)
+            fft.magLin8(&input[0], &bytes[0], count, scale);
+        else
+            fft.magOctave(&input[0], &bytes[0], count);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (quiet)
+            continue;
+        for (size_t t=0; t<count; ++t){
+            printArray("fft_input", &input[t * 2 * n], n, 2);
+            if (strcmp(output, "lin") == 0)
+                printArray("fft_lin_out", &lin[t * perTransform], perTransform, 1);
+            else if (strcmp(output, "log") == 0)
+                printArray("fft_log_out", &bytes[t * perTransform], perTransform, 1);
+            else if (strcmp(output, "lin8") == 0)
+                printArray("fft_lin_out8", &bytes[t * perTransform], perTransform, 1);
+            else
+                printArray("fft_oct_out", &bytes[t * perTransform], perTransform, 1);
+        }
+    }
+    fprintf(stderr, "%lu samples, %lu transforms of %lu in %.3f s", (unsigned long)samples.size(),
+            (unsigned long)total, (unsigned long)n, seconds);
+    if (seconds > 0)
+        fprintf(stderr, " (%.0f a second)", total / seconds);
+    fprintf(stderr, "\n");
+    return 0;
+}
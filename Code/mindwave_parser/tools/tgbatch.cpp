@@ -0,0 +1,434 @@
+/*
+ * tgbatch: computes spectrograms and band powers of recorded sessions,
+ * capture files (see ThinkGearCapture.h) or columnar session files (see
+ * ThinkGearSession.h), on every core at once.
+ *
+ *   tgbatch [-w window] [-h hop] [-c frames] [-j threads] -o out.tgsp
+ *           recording...
+ *
+ *   -w window   samples per frame, a power of two from 256 to 4096 (512)
+ *   -h hop      samples between frames, at most the window (64, 8 a second)
+ *   -c frames   frames per chunk of work (1024)
+ *   -j threads  worker threads (one per core)
+ *   -o file     where the frames go
+ *
+ * Each recording is split into runs of samples without stalls, and each
+ * run into chunks of frames.  A stall is a gap of more than
+ * SessionWriter::RAW_STALL_MICROS between the arrival of two samples, in
+ * captures as in sessions, so a capture gives the same runs and times as
+ * the session tgsession makes of it.  A chunk reads its frames' samples plus the
+ * window - hop before them that its first frame overlaps, so chunks need
+ * nothing from each other and run on a WorkPool (ThinkGearPool.h) in any
+ * order.  The output file is sized for every frame before any chunk runs,
+ * and each chunk writes its frames straight to their place in it; there
+ * is nothing to merge afterwards.  Capture files are decoded first, into
+ * memory by a thinkgear::Parser that only takes raw rows (see
+ * ThinkGearParser.h); session files are read in place.  Each capture is
+ * decoded serially, start to end, by one worker, as a packet may span
+ * reads and chunks: several captures decode side by side, but one long
+ * capture takes one core's time before any chunk of frames runs.
+ *
+ * Output, all integers little-endian (the host order on every machine
+ * this builds for):
+ *
+ * File header, 32 bytes:
+ *   0  char[4]  "TGSP"
+ *   4  uint16   version, 1
+ *   6  uint16   header size in bytes
+ *   8  uint32   window
+ *  12  uint32   hop
+ *  16  uint32   bins: window / 2 + 1
+ *  20  uint32   record size in bytes, a multiple of 8
+ *  24  uint64   number of records
+ *
+ * then one record per frame, recording by recording in argument order,
+ * run by run, in time order:
+ *   0  uint32   recording, from 0 in argument order
+ *   4  uint32   run of samples within the recording, from 0
+ *   8  uint64   time of the frame's last sample, us since the recording
+ *               started
+ *  16  uint32[8] band powers, delta to mid-gamma (see ThinkGearBands.h)
+ *  48  float[bins] amplitudes from 0 Hz up (see ThinkGearSpectrum.h)
+ *
+ * Build with the Makefile in the parent directory: make tools
+ */
+
+#include "ThinkGearBands.h"
+#include "ThinkGearCapture.h"
+#include "ThinkGearParser.h"
+#include "ThinkGearPool.h"
+#include "ThinkGearSession.h"
+#include "ThinkGearSpectrum.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+using thinkgear::SessionChunk;
+
+namespace {
+
+const size_t HEADER_SIZE = 32;
+const size_t RECORD_HEADER = 48;
+
+// A recording given on the command line
+struct Recording {
+    const char *path;
+    bool isCapture;
+    thinkgear::SessionReader session;
+    std::vector<int16_t> decoded;       // a capture's samples
+    std::vector<size_t> runStarts;      // index in decoded of each run's first sample
+    std::vector<uint64_t> runMicros;    // and its arrival
+    bool failed;
+};
+
+// Samples without a stall, in one or more pieces
+struct Run {
+    uint32_t recording;
+    uint32_t number;
+    uint64_t startMicros;
+    std::vector<const int16_t*> pieces;
+    std::vector<uint64_t> pieceStarts;  // sample number of each piece's first sample
+    uint64_t samples;
+    uint64_t firstRecord;
+};
+
+struct Chunk {
+    size_t run;
+    uint64_t first;                     // frame number within the run
+    uint64_t frames;
+};
+
+// Everything one worker reuses from chunk to chunk
+struct WorkerState {
+    thinkgear::Stft stft;
+    thinkgear::BandBank bands;
+    std::vector<int16_t> samples;
+    std::vector<unsigned char> records;
+};
+
+struct Job {
+    size_t window, hop;
+    size_t recordSize;
+    std::vector<Recording*> recordings;
+    std::vector<Run> runs;
+    std::vector<Chunk> chunks;
+    std::vector<WorkerState*> states;
+    int fd;
+    std::atomic<bool> failed;
+};
+
+void put32(unsigned char *p, uint32_t v){
+    memcpy(p, &v, 4);
+}
+
+void put64(unsigned char *p, uint64_t v){
+    memcpy(p, &v, 8);
+}
+
+bool writeAll(int fd, const unsigned char *p, size_t n, uint64_t offset){
+    while (n > 0){
+        ssize_t w = pwrite(fd, p, n, (off_t)offset);
+        if (w <= 0)
+            return false;
+        p += w;
+        n -= (size_t)w;
+        offset += (uint64_t)w;
+    }
+    return true;
+}
+
+// Appends the samples of each raw row, decoded like the C frame parser does
+struct RawSamples {
+    std::vector<int16_t> *samples;
+    void operator()(unsigned char, unsigned char, unsigned char numBytes,
+                    const unsigned char *value){
+        if (numBytes < 2 || (numBytes & 1))
+            return;
+        for (const unsigned char *end = value + numBytes; value < end; value += 2)
+            samples->push_back((int16_t)(((uint16_t)value[0] << 8) | value[1]));
+    }
+};
+
+// Only raw rows reach the handler; everything else is skipped unseen
+typedef thinkgear::Parser<RawSamples, PARSER_CODE_RAW_SIGNAL> RawParser;
+
+// Task: decodes capture file @c task
+void decodeCapture(size_t task, size_t, void *customData){
+    Job& job = *static_cast<Job*>(customData);
+    Recording& r = *job.recordings[task];
+    if (!r.isCapture)
+        return;
+    thinkgear::CaptureReader reader;
+    if (!reader.open(r.path)){
+        r.failed = true;
+        return;
+    }
+    RawSamples handler = { &r.decoded };
+    RawParser *parser = new RawParser(handler);
+    parser->setResync(true);
+    // One read at a time, so samples get the time their packet arrived
+    // as in a session, and a stall between them starts a new run
+    thinkgear::CaptureChunk chunk;
+    uint64_t lastMicros = 0;
+    while (reader.next(chunk)){
+        thinkgear::CaptureReadIterator reads(chunk);
+        const unsigned char *p = chunk.bytes;
+        const unsigned char *end = chunk.bytes + chunk.numBytes;
+        uint64_t micros;
+        size_t n;
+        while (reads.next(micros, n) && n <= (size_t)(end - p)){
+            size_t before = r.decoded.size();
+            parser->parse(p, n);
+            p += n;
+            if (r.decoded.size() == before)
+                continue;
+            if (before == 0 || micros > lastMicros + thinkgear::SessionWriter::RAW_STALL_MICROS){
+                r.runStarts.push_back(before);
+                r.runMicros.push_back(micros);
+            }
+            lastMicros = micros;
+        }
+    }
+    delete parser;
+}
+
+// Copies samples [from, to) of @c run into @c out
+void gather(const Run& run, uint64_t from, uint64_t to, std::vector<int16_t>& out){
+    out.resize((size_t)(to - from));
+    size_t p = std::upper_bound(run.pieceStarts.begin(), run.pieceStarts.end(), from) -
+               run.pieceStarts.begin() - 1;
+    uint64_t at = from;
+    while (at < to){
+        uint64_t pieceEnd = p + 1 < run.pieces.size() ? run.pieceStarts[p+1] : run.samples;
+        uint64_t n = std::min(to, pieceEnd) - at;
+        memcpy(&out[(size_t)(at - from)], run.pieces[p] + (at - run.pieceStarts[p]),
+               (size_t)n * sizeof(int16_t));
+        at += n;
+        ++p;
+    }
+}
+
+// Task: computes and writes out chunk @c task
+void computeChunk(size_t task, size_t worker, void *customData){
+    Job& job = *static_cast<Job*>(customData);
+    const Chunk& c = job.chunks[task];
+    const Run& run = job.runs[c.run];
+    WorkerState& s = *job.states[worker];
+
+    // Frame f covers samples [f * hop, f * hop + window)
+    uint64_t from = c.first * job.hop;
+    gather(run, from, from + (c.frames - 1) * job.hop + job.window, s.samples);
+    s.stft.reset();
+    s.bands.reset();
+    s.records.assign((size_t)c.frames * job.recordSize, 0);
+
+    size_t bins = s.stft.getBins();
+    size_t at = 0, step = job.window;
+    for (uint64_t f=0; f<c.frames; ++f){
+        // The first feed fills the window, each later one moves it a hop
+        s.stft.feed(&s.samples[at], step);
+        s.bands.feed(&s.samples[at], step);
+        at += step;
+        step = job.hop;
+
+        unsigned char *rec = &s.records[(size_t)f * job.recordSize];
+        uint64_t end = from + at;
+        put32(rec, run.recording);
+        put32(rec + 4, run.number);
+        put64(rec + 8, run.startMicros + (end - 1) * 1000000 / THINKGEAR_RAW_RATE);
+        memcpy(rec + 16, s.bands.getPowers(), THINKGEAR_EEG_BANDS * sizeof(uint32_t));
+        memcpy(rec + RECORD_HEADER, s.stft.getFrame(s.stft.getFramesWritten() - 1),
+               bins * sizeof(float));
+    }
+    uint64_t offset = HEADER_SIZE + (run.firstRecord + c.first) * job.recordSize;
+    if (!writeAll(job.fd, &s.records[0], s.records.size(), offset))
+        job.failed = true;
+}
+
+// Splits a session's raw column into runs at each stall
+void addSessionRuns(Job& job, uint32_t recording){
+    const thinkgear::SessionReader& session = job.recordings[recording]->session;
+    uint64_t lastMicros = 0;
+    uint32_t number = 0;
+    for (size_t i=0; i<session.getChunkCount(thinkgear::SESSION_RAW); ++i){
+        SessionChunk chunk;
+        if (!session.getChunk(thinkgear::SESSION_RAW, i, chunk) || chunk.count == 0)
+            continue;
+        bool stalled = job.runs.empty() || job.runs.back().recording != recording ||
+                       chunk.firstMicros > lastMicros + thinkgear::SessionWriter::RAW_STALL_MICROS;
+        if (stalled){
+            Run run;
+            run.recording = recording;
+            run.number = number++;
+            run.startMicros = chunk.firstMicros;
+            run.samples = 0;
+            run.firstRecord = 0;
+            job.runs.push_back(run);
+        }
+        Run& run = job.runs.back();
+        run.pieces.push_back(chunk.values<int16_t>());
+        run.pieceStarts.push_back(run.samples);
+        run.samples += chunk.count;
+        lastMicros = chunk.lastMicros;
+    }
+}
+
+// Makes a run of each stretch of a decoded capture between stalls
+void addCaptureRuns(Job& job, uint32_t recording){
+    const Recording& r = *job.recordings[recording];
+    for (size_t i=0; i<r.runStarts.size(); ++i){
+        size_t end = i + 1 < r.runStarts.size() ? r.runStarts[i+1] : r.decoded.size();
+        Run run;
+        run.recording = recording;
+        run.number = (uint32_t)i;
+        run.startMicros = r.runMicros[i];
+        run.pieces.push_back(&r.decoded[r.runStarts[i]]);
+        run.pieceStarts.push_back(0);
+        run.samples = end - r.runStarts[i];
+        run.firstRecord = 0;
+        job.runs.push_back(run);
+    }
+}
+
+double since(std::chrono::steady_clock::time_point t){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+}
+
+int usage(){
+    fprintf(stderr, "usage: tgbatch [-w window] [-h hop] [-c frames] [-j threads] "
+            "-o out.tgsp recording...\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    Job job;
+    job.window = 512;
+    job.hop = 64;
+    size_t chunkFrames = 1024;
+    size_t threads = 0;
+    const char *out = NULL;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; ++arg){
+        if (strcmp(argv[arg], "-w") == 0 && arg+1 < argc)
+            job.window = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-h") == 0 && arg+1 < argc)
+            job.hop = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-c") == 0 && arg+1 < argc)
+            chunkFrames = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-j") == 0 && arg+1 < argc)
+            threads = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-o") == 0 && arg+1 < argc)
+            out = argv[++arg];
+        else
+            return usage();
+    }
+    thinkgear::BandBank check;
+    if (arg == argc || !out || chunkFrames == 0 || job.hop == 0 || job.hop > job.window ||
+        !check.setup(job.hop, job.window))
+        return usage();
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    thinkgear::WorkPool pool(threads);
+    for (; arg < argc; ++arg){
+        Recording *r = new Recording();
+        r->path = argv[arg];
+        r->failed = false;
+        thinkgear::CaptureReader capture;
+        r->isCapture = capture.open(r->path);
+        if (!r->isCapture && !r->session.open(r->path)){
+            fprintf(stderr, "%s: neither a capture nor a session file\n", r->path);
+            return 1;
+        }
+        job.recordings.push_back(r);
+    }
+
+    // Captures have to be decoded before their samples can be counted
+    pool.run(job.recordings.size(), decodeCapture, &job);
+    double decoding = since(t0);
+
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    uint64_t samples = 0, records = 0;
+    for (uint32_t i=0; i<job.recordings.size(); ++i){
+        Recording& r = *job.recordings[i];
+        if (r.failed){
+            fprintf(stderr, "%s: cannot read\n", r.path);
+            return 1;
+        }
+        if (r.isCapture)
+            addCaptureRuns(job, i);
+        else
+            addSessionRuns(job, i);
+    }
+    for (size_t i=0; i<job.runs.size(); ++i){
+        Run& run = job.runs[i];
+        run.firstRecord = records;
+        uint64_t frames = run.samples < job.window ? 0 : (run.samples - job.window) / job.hop + 1;
+        for (uint64_t f=0; f<frames; f+=chunkFrames){
+            Chunk c = { i, f, std::min<uint64_t>(chunkFrames, frames - f) };
+            job.chunks.push_back(c);
+        }
+        records += frames;
+        samples += run.samples;
+    }
+
+    // Every record's place is known now, so size the file once
+    size_t bins = job.window / 2 + 1;
+    job.recordSize = (RECORD_HEADER + bins * sizeof(float) + 7) & ~(size_t)7;
+    job.fd = ::open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (job.fd < 0){
+        fprintf(stderr, "%s: cannot create\n", out);
+        return 1;
+    }
+    unsigned char header[HEADER_SIZE] = { 'T', 'G', 'S', 'P', 1, 0, HEADER_SIZE, 0 };
+    put32(header + 8, (uint32_t)job.window);
+    put32(header + 12, (uint32_t)job.hop);
+    put32(header + 16, (uint32_t)bins);
+    put32(header + 20, (uint32_t)job.recordSize);
+    put64(header + 24, records);
+    off_t size = (off_t)(HEADER_SIZE + records * job.recordSize);
+    bool sized = ftruncate(job.fd, size) == 0;
+#if defined(__linux__)
+    // Reserve the blocks too, so a full disk fails here rather than halfway
+    sized = sized && posix_fallocate(job.fd, 0, size) == 0;
+#endif
+    if (!sized || !writeAll(job.fd, header, HEADER_SIZE, 0)){
+        fprintf(stderr, "%s: cannot make room for %llu records\n", out, (unsigned long long)records);
+        return 1;
+    }
+    for (size_t i=0; i<pool.getThreads(); ++i){
+        job.states.push_back(new WorkerState());
+        job.states.back()->stft.setup(job.window, job.hop, 1);
+        job.states.back()->bands.setup(job.hop, job.window);
+    }
+    double planning = since(t1);
+
+    std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+    job.failed = false;
+    pool.run(job.chunks.size(), computeChunk, &job);
+    double computing = since(t2);
+    if (close(job.fd) != 0 || job.failed){
+        fprintf(stderr, "%s: write failed\n", out);
+        return 1;
+    }
+
+    double hours = samples / (double)THINKGEAR_RAW_RATE / 3600;
+    fprintf(stderr, "%lu recordings, %.2f h of samples: %llu frames in %lu chunks on %lu threads\n"
+            "decode %.2f s, plan %.3f s, compute %.2f s (%.0fx real time), %llu chunks stolen\n",
+            (unsigned long)job.recordings.size(), hours, (unsigned long long)records,
+            (unsigned long)job.chunks.size(), (unsigned long)pool.getThreads(),
+            decoding, planning, computing, computing > 0 ? hours * 3600 / computing : 0.0,
+            (unsigned long long)pool.getSteals());
+    for (size_t i=0; i<job.states.size(); ++i)
+        delete job.states[i];
+    for (size_t i=0; i<job.recordings.size(); ++i)
+        delete job.recordings[i];
+    return 0;
+}
@@ -0,0 +1,342 @@
+/*
+ * tgbench: measures how fast the parser gets through a byte stream, one
+ * byte at a time with THINKGEAR_parseByte() and in read()-sized chunks
+ * with THINKGEAR_parseBuffer(), both decoding into a ThinkGearFrame, and
+ * with thinkgear::Parser (ThinkGearParser.h) handed every DataRow or only
+ * raw rows, which it decodes into samples.  A run of parseBuffer() over
+ * noise without a SyncByte pair times the bulk sync scan alone.  Last,
+ * EegData::feed() (ThinkGearEeg.h) ranks the band powers of many headsets
+ * in turn, against the std::list it used to clear, refill and sort on
+ * every feed.
+ *
+ *   tgbench [-m megabytes] [-c chunk] [-d rate] [-n headsets] [capture.tgc]
+ *
+ *   -m megabytes  length of the stream (64)
+ *   -c chunk      bytes per parseBuffer() call (512)
+ *   -d rate       chance each byte of a simulated stream is dropped (0)
+ *   -n headsets   EegData ranked in turn, a million feeds in all (64)
+ *
+ * The stream is the bytes of a capture file, repeated as needed, or else
+ * a simulated headset streaming raw samples (see ThinkGearSimulator.h).
+ * Each way is timed three times and the best run is printed; the ways
+ * must agree on every counter, or tgbench says so and fails.
+ *
+ * Build with the Makefile in the parent directory: make tools
+ */
+
+#include "ThinkGearCapture.h"
+#include "ThinkGearEeg.h"
+#include "ThinkGearParser.h"
+#include "ThinkGearSimulator.h"
+#include "ThinkGearStreamParser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <list>
+#include <vector>
+
+namespace {
+
+// Runs of each benchmark; the fastest counts
+const int RUNS = 3;
+
+// Every Packet starts with two of these
+const unsigned char SYNC_BYTE = 0xAA;
+
+struct Counts {
+    unsigned long frames;       // or DataRows, for a thinkgear::Parser
+    unsigned long samples;
+    long sampleSum;             // so both ways can be seen to decode the same
+};
+
+void countFrame(const ThinkGearFrame *frame, void *customData){
+    Counts& c = *static_cast<Counts*>(customData);
+    c.frames++;
+    c.samples += frame->numRaw;
+    for (int i=0; i<frame->numRaw; ++i)
+        c.sampleSum += frame->raw[i];
+}
+
+void ignoreDataValue(unsigned char, unsigned char, unsigned char, const unsigned char *, void *){
+}
+
+bool readCapture(const char *path, size_t bytes, std::vector<unsigned char>& out){
+    std::vector<unsigned char> once;
+    thinkgear::CaptureReader reader;
+    if (!reader.open(path))
+        return false;
+    thinkgear::CaptureChunk chunk;
+    while (reader.next(chunk))
+        once.insert(once.end(), chunk.bytes, chunk.bytes + chunk.numBytes);
+    if (once.empty())
+        return false;
+    while (out.size() < bytes)
+        out.insert(out.end(), once.begin(), once.end());
+    out.resize(bytes);
+    return true;
+}
+
+void simulate(size_t bytes, double dropRate, std::vector<unsigned char>& out){
+    thinkgear::HeadsetSimulator sim(1, 1);
+    thinkgear::SimulatorFaults faults;
+    faults.dropRate = dropRate;
+    sim.setFaults(faults);
+    sim.setConnected(0);
+    for (uint64_t micros = 0; out.size() < bytes; micros += 1000000)
+        sim.generate(micros, out);
+    out.resize(bytes);
+}
+
+// Random bytes in which no two SyncBytes follow each other
+void noise(size_t bytes, std::vector<unsigned char>& out){
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+    out.resize(bytes);
+    for (size_t i=0; i<bytes; ++i){
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        out[i] = (unsigned char)((x * 0x2545F4914F6CDD1DULL) >> 56);
+        if (out[i] == SYNC_BYTE && i > 0 && out[i-1] == SYNC_BYTE)
+            out[i] = 0;
+    }
+}
+
+// A parse of the whole stream: what it found and how long the best run took
+struct Result {
+    Counts counts;
+    ThinkGearParserStats stats;
+    double seconds;
+};
+
+Result parse(const std::vector<unsigned char>& stream, size_t chunk){
+    static ThinkGearStreamParser parser;
+    static ThinkGearFrame frame;
+    Result r;
+    r.seconds = 0;
+    for (int run=0; run<RUNS; ++run){
+        Counts counts = { 0, 0, 0 };
+        THINKGEAR_initFrameParser(&parser, &frame, countFrame, ignoreDataValue, &counts);
+        THINKGEAR_setResync(&parser, 1);
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        if (chunk == 0){
+            for (size_t i=0; i<stream.size(); ++i)
+                THINKGEAR_parseByte(&parser, stream[i]);
+        } else {
+            for (size_t at=0; at<stream.size(); at+=chunk){
+                size_t n = stream.size() - at < chunk ? stream.size() - at : chunk;
+                THINKGEAR_parseBuffer(&parser, &stream[at], n);
+            }
+        }
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (run == 0 || s < r.seconds)
+            r.seconds = s;
+        r.counts = counts;
+        THINKGEAR_getStats(&parser, &r.stats);
+    }
+    return r;
+}
+
+// Counts every DataRow, and decodes raw rows like the frame parser does
+struct CountRows {
+    Counts *counts;
+    void operator()(unsigned char extendedCodeLevel, unsigned char code, unsigned char numBytes,
+                    const unsigned char *value){
+        counts->frames++;
+        if (extendedCodeLevel != 0 || code != PARSER_CODE_RAW_SIGNAL ||
+            numBytes < 2 || (numBytes & 1))
+            return;
+        counts->samples += numBytes / 2;
+        for (const unsigned char *end = value + numBytes; value < end; value += 2)
+            counts->sampleSum += (int16_t)(((uint16_t)value[0] << 8) | value[1]);
+    }
+};
+
+typedef thinkgear::Parser<CountRows> AllRowsParser;
+typedef thinkgear::Parser<CountRows, PARSER_CODE_RAW_SIGNAL> RawRowsParser;
+
+// A parse by a thinkgear::Parser, in chunks
+template <class TemplateParser>
+Result parseTemplate(const std::vector<unsigned char>& stream, size_t chunk){
+    Result r;
+    r.seconds = 0;
+    memset(&r.stats, 0, sizeof(r.stats));
+    for (int run=0; run<RUNS; ++run){
+        Counts counts = { 0, 0, 0 };
+        CountRows handler = { &counts };
+        TemplateParser *parser = new TemplateParser(handler);
+        parser->setResync(true);
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        for (size_t at=0; at<stream.size(); at+=chunk){
+            size_t n = stream.size() - at < chunk ? stream.size() - at : chunk;
+            parser->parse(&stream[at], n);
+        }
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (run == 0 || s < r.seconds)
+            r.seconds = s;
+        r.counts = counts;
+        delete parser;
+    }
+    return r;
+}
+
+// EegData as it ranked before the sorting network: the same parts, in a
+// std::list cleared, refilled and sorted on every feed
+class ListEegData {
+public:
+    std::list<EegDataPart*> data;
+    EegDataPart parts[8] = {
+        EEG_DELTA, EEG_THETA, EEG_LOW_ALPHA, EEG_HIGH_ALPHA,
+        EEG_LOW_BETA, EEG_HIGH_BETA, EEG_LOW_GAMMA, EEG_MID_GAMMA
+    };
+
+    void feed(const unsigned int *power){
+        data.clear();
+        unsigned long int total = 0;
+        for (int i=0; i<8; ++i)
+            total += power[i];
+        for (int i=0; i<8; ++i){
+            parts[i].feed(power[i], total);
+            data.push_back(&parts[i]);
+        }
+        data.sort(EegData::compare);
+    }
+};
+
+// Band powers of @c headsets, one vector of 8 after another, each headset
+// scattered around a spectrum of its own so rankings change now and then
+void bandPowers(size_t headsets, size_t feeds, std::vector<unsigned int>& out){
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+    std::vector<unsigned int> spectra(headsets * 8);
+    out.resize(feeds * 8);
+    for (size_t i=0; i<spectra.size() + out.size(); ++i){
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        unsigned int r = (unsigned int)((x * 0x2545F4914F6CDD1DULL) >> 40);
+        if (i < spectra.size()){
+            spectra[i] = 1000 + (r & 0xFFFFF);
+            continue;
+        }
+        // Between half and one and a half times the headset's own power
+        size_t n = i - spectra.size();
+        unsigned int base = spectra[n / 8 % headsets * 8 + n % 8];
+        out[n] = base / 2 + (unsigned int)((uint64_t)base * (r & 0xFFFF) >> 16);
+    }
+}
+
+// Ranks every vector of @c powers, headset after headset; @c hash of
+// the final rankings tells the two ways apart if they disagree
+template <class Eeg>
+double rank(size_t headsets, const std::vector<unsigned int>& powers, uint64_t& hash){
+    double best = 0;
+    for (int run=0; run<RUNS; ++run){
+        std::vector<Eeg> eeg(headsets);
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        for (size_t at=0, h=0; at<powers.size(); at+=8, h = h+1 < headsets ? h+1 : 0)
+            eeg[h].feed(&powers[at]);
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (run == 0 || s < best)
+            best = s;
+        hash = 0xCBF29CE484222325ULL;
+        for (size_t h=0; h<headsets; ++h)
+            for (EegDataPart *part : eeg[h].data)
+                hash = (hash ^ (uint64_t)part->kind) * 0x100000001B3ULL;
+    }
+    return best;
+}
+
+void print(const char *name, const Result& r, size_t bytes, unsigned long packets){
+    if (packets)
+        printf("%-24s %8.1f MB/s  %8.1f ns/packet\n", name, bytes / r.seconds / 1e6,
+               r.seconds * 1e9 / packets);
+    else
+        printf("%-24s %8.1f MB/s\n", name, bytes / r.seconds / 1e6);
+}
+
+int usage(){
+    fprintf(stderr, "usage: tgbench [-m megabytes] [-c chunk] [-d rate] [-n headsets]\n"
+                    "               [capture.tgc]\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    size_t megabytes = 64, chunk = 512, headsets = 64;
+    double dropRate = 0;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; ++arg){
+        if (strcmp(argv[arg], "-m") == 0 && arg+1 < argc)
+            megabytes = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-c") == 0 && arg+1 < argc)
+            chunk = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-d") == 0 && arg+1 < argc)
+            dropRate = atof(argv[++arg]);
+        else if (strcmp(argv[arg], "-n") == 0 && arg+1 < argc)
+            headsets = atoi(argv[++arg]);
+        else
+            return usage();
+    }
+    if (arg + 1 < argc || megabytes == 0 || chunk == 0 || headsets == 0)
+        return usage();
+
+    std::vector<unsigned char> stream;
+    size_t bytes = megabytes << 20;
+    if (arg < argc){
+        if (!readCapture(argv[arg], bytes, stream)){
+            fprintf(stderr, "%s: not a capture file, or empty\n", argv[arg]);
+            return 1;
+        }
+    } else {
+        simulate(bytes, dropRate, stream);
+    }
+
+    Result byByte = parse(stream, 0);
+    Result byBuffer = parse(stream, chunk);
+    Result allRows = parseTemplate<AllRowsParser>(stream, chunk);
+    Result rawRows = parseTemplate<RawRowsParser>(stream, chunk);
+    std::vector<unsigned char> noiseStream;
+    noise(bytes, noiseStream);
+    Result noiseScan = parse(noiseStream, chunk);
+    unsigned long packets = byByte.counts.frames;
+    printf("%lu MB: %lu packets, %lu raw samples, %lu checksum failures\n",
+           (unsigned long)megabytes, packets, byByte.counts.samples,
+           (unsigned long)byByte.stats.checksumFailures);
+    print("parseByte", byByte, bytes, packets);
+    print("parseBuffer", byBuffer, bytes, packets);
+    print("Parser, every row", allRows, bytes, packets);
+    print("Parser, raw rows only", rawRows, bytes, packets);
+    print("parseBuffer, noise", noiseScan, bytes, 0);
+
+    const size_t FEEDS = 1000000;
+    std::vector<unsigned int> powers;
+    bandPowers(headsets, FEEDS, powers);
+    uint64_t networkHash, listHash;
+    double network = rank<EegData>(headsets, powers, networkHash);
+    double list = rank<ListEegData>(headsets, powers, listHash);
+    printf("%-24s %8.1f ns/feed\n", "EegData::feed", network * 1e9 / FEEDS);
+    printf("%-24s %8.1f ns/feed\n", "EegData, std::list", list * 1e9 / FEEDS);
+    if (memcmp(&byByte.stats, &byBuffer.stats, sizeof(byByte.stats)) != 0 ||
+        byByte.counts.frames != byBuffer.counts.frames ||
+        byByte.counts.samples != byBuffer.counts.samples){
+        fprintf(stderr, "tgbench: parseBuffer() and parseByte() disagree\n");
+        return 1;
+    }
+    if (noiseScan.counts.frames != 0){
+        fprintf(stderr, "tgbench: parseBuffer() found packets in noise\n");
+        return 1;
+    }
+    if (allRows.counts.samples != byByte.counts.samples ||
+        allRows.counts.sampleSum != byByte.counts.sampleSum ||
+        rawRows.counts.samples != byByte.counts.samples ||
+        rawRows.counts.sampleSum != byByte.counts.sampleSum){
+        fprintf(stderr, "tgbench: thinkgear::Parser and the C parser decode different samples\n");
+        return 1;
+    }
+    if (networkHash != listHash){
+        fprintf(stderr, "tgbench: the sorting network and std::list rank differently\n");
+        return 1;
+    }
+    return 0;
+}
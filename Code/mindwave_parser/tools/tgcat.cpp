@@ -0,0 +1,152 @@
+/*
+ * tgcat: reads a ThinkGear device, or anything that talks like one such
+ * as a pseudo-terminal, and prints one line per decoded packet.  Needs no
+ * openFrameworks; see ThinkGearHeadset.h.
+ *
+ *   tgcat [-t] [-b baud] [-s seconds] [-r capture.tgc] [-q] /dev/ttyUSB0
+ *
+ *   -t  read on a background thread instead of polling from main()
+ *   -s  stop after this many seconds
+ *   -r  also record everything read to a capture file
+ *   -q  print only the parser counters at the end
+ *
+ * Build with the Makefile in the parent directory: make tools
+ */
+
+#include "ThinkGearHeadset.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+volatile sig_atomic_t stopping = 0;
+
+void handleSignal(int){
+    stopping = 1;
+}
+
+struct Options {
+    bool quiet;
+    unsigned long packets;
+    uint64_t start;
+};
+
+void printFrame(const ThinkGearFrame& frame, uint64_t micros, void *customData){
+    Options& o = *static_cast<Options*>(customData);
+    o.packets++;
+    if (o.quiet)
+        return;
+    printf("%.6f", (micros - o.start) * 1e-6);
+    if (frame.present & THINKGEAR_FRAME_RAW){
+        printf(" raw=");
+        for (int i=0; i<frame.numRaw; ++i)
+            printf(i ? ",%d" : "%d", frame.raw[i]);
+    }
+    if (frame.present & THINKGEAR_FRAME_POOR_SIGNAL)
+        printf(" poorSignal=%d", frame.poorSignal);
+    if (frame.present & THINKGEAR_FRAME_ATTENTION)
+        printf(" attention=%d", frame.attention);
+    if (frame.present & THINKGEAR_FRAME_MEDITATION)
+        printf(" meditation=%d", frame.meditation);
+    if (frame.present & THINKGEAR_FRAME_BLINK)
+        printf(" blink=%d", frame.blinkStrength);
+    if (frame.present & THINKGEAR_FRAME_BATTERY)
+        printf(" battery=%d", frame.battery);
+    if (frame.present & THINKGEAR_FRAME_EEG_POWER){
+        printf(" eeg=");
+        for (int b=0; b<THINKGEAR_EEG_BANDS; ++b)
+            printf(b ? ",%lu" : "%lu", (unsigned long)frame.eegPower[b]);
+    }
+    if (frame.present & THINKGEAR_FRAME_DONGLE)
+        printf(" dongle=0x%02X", frame.dongleStatus);
+    printf("\n");
+}
+
+void printDataValue(unsigned char extendedCodeLevel, unsigned char code,
+                    unsigned char valueLength, const unsigned char *, void *customData){
+    if (!static_cast<Options*>(customData)->quiet)
+        printf("unknown level=%d code=0x%02X length=%d\n", extendedCodeLevel, code, valueLength);
+}
+
+int usage(){
+    fprintf(stderr, "usage: tgcat [-t] [-b baud] [-s seconds] [-r capture.tgc] [-q] device\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    bool threaded = false;
+    int baud = THINKGEAR_DEFAULT_BAUD;
+    double seconds = 0;
+    const char *record = NULL;
+    Options o = { false, 0, 0 };
+    int i = 1;
+    for (; i<argc-1 && argv[i][0] == '-'; ++i){
+        if (strcmp(argv[i], "-t") == 0)
+            threaded = true;
+        else if (strcmp(argv[i], "-q") == 0)
+            o.quiet = true;
+        else if (strcmp(argv[i], "-b") == 0 && i+2 < argc)
+            baud = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i+2 < argc)
+            seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i+2 < argc)
+            record = argv[++i];
+        else
+            return usage();
+    }
+    if (i != argc-1)
+        return usage();
+    const char *path = argv[i];
+
+    signal(SIGINT, handleSignal);
+    signal(SIGTERM, handleSignal);
+
+    thinkgear::Headset headset;
+    headset.setFrameCallback(printFrame, &o);
+    headset.setDataValueCallback(printDataValue, &o);
+    o.start = thinkgear::Headset::nowMicros();
+    uint64_t end = seconds > 0 ? o.start + (uint64_t)(seconds * 1e6) : 0;
+
+    if (threaded){
+        headset.startThread(path, baud);
+    } else if (!headset.open(path, baud)){
+        fprintf(stderr, "%s: cannot open at %d baud\n", path, baud);
+        return 1;
+    }
+    if (record && !headset.startRecording(record)){
+        fprintf(stderr, "%s: cannot create\n", record);
+        return 1;
+    }
+
+    while (!stopping && (!end || thinkgear::Headset::nowMicros() < end)){
+        if (threaded){
+            headset.drain();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        } else if (headset.poll(100) < 0){
+            fprintf(stderr, "%s: device went away\n", path);
+            break;
+        }
+        fflush(stdout);
+    }
+    if (threaded)
+        headset.drain();
+
+    ThinkGearParserStats s = headset.getStats();
+    thinkgear::ConnectionStats c = headset.getConnectionStats();
+    headset.close();
+    fprintf(stderr, "%s: %u connect requests, %u not found, connected %u times",
+            thinkgear::connectionStateName(c.state), c.requests, c.notFound, c.connects);
+    if (c.connects)
+        fprintf(stderr, ", last in %.1f ms", c.lastConnectMicros * 1e-3);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "%lu packets, %lu bytes, %lu checksum failures, %lu resyncs, %lu dropped\n",
+            o.packets, (unsigned long)s.bytesIn, (unsigned long)s.checksumFailures,
+            (unsigned long)s.resyncs, headset.getDroppedFrames());
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * tgmon: reads many ThinkGear devices at once (see ThinkGearManager.h)
+ * and prints a line per device every second: its state, the dongle
+ * handshake state and time to connect, packets and raw samples per second,
+ * checksum failures and reconnects.
+ *
+ *   tgmon [-j threads] [-s seconds] [-q] port-or-glob...
+ *
+ *   -j threads  pool threads (one per 32 devices)
+ *   -s seconds  stop after this many seconds
+ *   -q          print only the totals at the end
+ *
+ * Quote globs so the shell leaves them to tgmon, which keeps looking for
+ * new matches: tgmon '/dev/ttyUSB*'
+ *
+ * Build with the Makefile in the parent directory: make tools
+ */
+
+#include "ThinkGearManager.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using thinkgear::Headset;
+using thinkgear::DeviceStatus;
+
+namespace {
+
+volatile sig_atomic_t stopping = 0;
+
+void handleSignal(int){
+    stopping = 1;
+}
+
+struct Counts {
+    unsigned long packets;
+    unsigned long samples;
+};
+
+std::vector<Counts> counts;
+
+void countFrame(size_t device, const ThinkGearFrame& frame, uint64_t, void *){
+    if (device >= counts.size())
+        counts.resize(device + 1, Counts());
+    counts[device].packets++;
+    counts[device].samples += frame.numRaw;
+}
+
+double cpuSeconds(){
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+}
+
+int usage(){
+    fprintf(stderr, "usage: tgmon [-j threads] [-s seconds] [-q] port-or-glob...\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    int threads = 0;
+    double seconds = 0;
+    bool quiet = false;
+    thinkgear::HeadsetManager manager;
+    manager.setFrameCallback(countFrame, NULL);
+
+    int ports = 0;
+    for (int i=1; i<argc; ++i){
+        if (strcmp(argv[i], "-j") == 0 && i+1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i+1 < argc)
+            seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "-q") == 0)
+            quiet = true;
+        else if (argv[i][0] == '-')
+            return usage();
+        else if (strpbrk(argv[i], "*?[")){
+            manager.addPorts(argv[i]);
+            ports++;
+        } else {
+            manager.addPort(argv[i]);
+            ports++;
+        }
+    }
+    if (ports == 0)
+        return usage();
+
+    signal(SIGINT, handleSignal);
+    signal(SIGTERM, handleSignal);
+
+    uint64_t start = Headset::nowMicros();
+    uint64_t end = seconds > 0 ? start + (uint64_t)(seconds * 1e6) : 0;
+    uint64_t nextReport = start + 1000000;
+    std::vector<Counts> last;
+    manager.start(threads);
+
+    while (!stopping && (!end || Headset::nowMicros() < end)){
+        manager.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        uint64_t now = Headset::nowMicros();
+        if (quiet || now < nextReport)
+            continue;
+        nextReport += 1000000;
+        last.resize(counts.size(), Counts());
+        printf("%-24s %-9s %-12s %8s %8s %8s %8s %6s %6s\n",
+               "device", "state", "headset", "conn ms", "pkt/s", "raw/s", "badsum",
+               "fails", "reconn");
+        for (size_t i=0; i<manager.getDeviceCount(); ++i){
+            DeviceStatus s = manager.getStatus(i);
+            Counts c = i < counts.size() ? counts[i] : Counts();
+            Counts l = i < last.size() ? last[i] : Counts();
+            printf("%-24s %-9s %-12s %8.0f %8lu %8lu %8lu %6lu %6lu\n",
+                   s.path.c_str(), thinkgear::deviceStateName(s.state),
+                   thinkgear::connectionStateName(s.connection.state),
+                   s.connection.lastConnectMicros * 1e-3, c.packets - l.packets, c.samples - l.samples,
+                   (unsigned long)s.stats.checksumFailures,
+                   (unsigned long)s.failures, (unsigned long)s.reconnects);
+        }
+        printf("\n");
+        fflush(stdout);
+        last = counts;
+    }
+    manager.update();
+    manager.stop();
+
+    double elapsed = (Headset::nowMicros() - start) * 1e-6;
+    unsigned long packets = 0, samples = 0;
+    for (size_t i=0; i<counts.size(); ++i){
+        packets += counts[i].packets;
+        samples += counts[i].samples;
+    }
+    size_t n = manager.getDeviceCount();
+    fprintf(stderr, "%lu devices for %.1f s: %lu packets, %.0f raw samples/s per device, "
+            "%.1f%% of one core\n", (unsigned long)n, elapsed, packets,
+            n ? samples / elapsed / n : 0.0, 100 * cpuSeconds() / elapsed);
+    return 0;
+}
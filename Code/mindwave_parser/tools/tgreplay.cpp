@@ -0,0 +1,135 @@
+/*
+ * tgreplay: feeds capture files (see ThinkGearCapture.h) through
+ * ThinkGearStreamParser as fast as possible and reports how the parser
+ * did and how much faster than real time it ran.
+ *
+ *   tgreplay [-r] [-n repeat] capture.tgc...
+ *
+ *   -r         hand the parser one serial read at a time, as it arrived,
+ *              instead of one whole chunk at a time
+ *   -n repeat  replay each file this many times (for timing)
+ *
+ * Build with the Makefile in the parent directory: make tools
+ */
+
+#include "ThinkGearCapture.h"
+#include "ThinkGearStreamParser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+namespace {
+
+struct Totals {
+    unsigned long frames;
+    unsigned long samples;
+};
+
+void handleFrame(const ThinkGearFrame *frame, void *customData){
+    Totals& totals = *static_cast<Totals*>(customData);
+    totals.frames++;
+    totals.samples += frame->numRaw;
+}
+
+void handleDataValue(unsigned char, unsigned char, unsigned char,
+                     const unsigned char *, void *){
+}
+
+int usage(){
+    fprintf(stderr, "usage: tgreplay [-r] [-n repeat] capture.tgc...\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    bool perRead = false;
+    long repeat = 1;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; ++arg){
+        if (strcmp(argv[arg], "-r") == 0){
+            perRead = true;
+        } else if (strcmp(argv[arg], "-n") == 0 && arg+1 < argc){
+            repeat = atol(argv[++arg]);
+            if (repeat < 1)
+                return usage();
+        } else {
+            return usage();
+        }
+    }
+    if (arg == argc)
+        return usage();
+
+    int status = 0;
+    for (; arg < argc; ++arg){
+        thinkgear::CaptureReader reader;
+        if (!reader.open(argv[arg])){
+            fprintf(stderr, "%s: not a capture file\n", argv[arg]);
+            status = 1;
+            continue;
+        }
+
+        static ThinkGearStreamParser parser;
+        static ThinkGearFrame frame;
+        Totals totals = Totals();
+        THINKGEAR_initFrameParser(&parser, &frame, handleFrame, handleDataValue, &totals);
+        THINKGEAR_setResync(&parser, 1);
+
+        uint64_t firstMicros = 0, lastMicros = 0;
+        bool first = true;
+        unsigned long packets = 0;
+        unsigned long long bytes = 0;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+        for (long r=0; r<repeat; ++r){
+            thinkgear::CaptureChunk chunk;
+            reader.rewind();
+            while (reader.next(chunk)){
+                thinkgear::CaptureReadIterator reads(chunk);
+                bytes += chunk.numBytes;
+                if (perRead){
+                    const unsigned char *p = chunk.bytes;
+                    const unsigned char *end = chunk.bytes + chunk.numBytes;
+                    uint64_t micros;
+                    size_t n;
+                    while (reads.next(micros, n) && n <= (size_t)(end - p)){
+                        packets += THINKGEAR_parseBuffer(&parser, p, n);
+                        p += n;
+                        lastMicros = micros;
+                    }
+                } else {
+                    packets += THINKGEAR_parseBuffer(&parser, chunk.bytes, chunk.numBytes);
+                    // Only the time span is needed, so skip the reads
+                    lastMicros = chunk.baseMicros;
+                    uint64_t micros;
+                    size_t n;
+                    while (reads.next(micros, n))
+                        lastMicros = micros;
+                }
+                if (first){
+                    firstMicros = chunk.baseMicros;
+                    first = false;
+                }
+            }
+        }
+
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        double recorded = (double)(lastMicros - firstMicros) * 1e-6 * repeat;
+        ThinkGearParserStats stats;
+        THINKGEAR_getStats(&parser, &stats);
+
+        printf("%s%s\n", argv[arg], reader.isTruncated() ? " (truncated)" : "");
+        printf("  bytes %llu  packets %lu  frames %lu  raw samples %lu\n",
+               bytes, packets, totals.frames, totals.samples);
+        printf("  checksum failures %lu  oversize %lu  sync skipped %lu  resyncs %lu  recovered %lu  max gap %lu\n",
+               (unsigned long)stats.checksumFailures, (unsigned long)stats.oversizeLength,
+               (unsigned long)stats.syncSkipped, (unsigned long)stats.resyncs,
+               (unsigned long)stats.packetsRecovered, (unsigned long)stats.maxGapBytes);
+        printf("  recorded %.3f s  replayed in %.3f s", recorded, wall);
+        if (wall > 0 && recorded > 0)
+            printf("  (%.0fx real time, %.1f MB/s)", recorded / wall, bytes / wall / 1e6);
+        printf("\n");
+    }
+    return status;
+}
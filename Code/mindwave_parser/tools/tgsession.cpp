@@ -0,0 +1,160 @@
+/*
+ * tgsession: converts capture files (see ThinkGearCapture.h) into
+ * columnar session files (see ThinkGearSession.h) and reads them back.
+ *
+ *   tgsession capture.tgc session.tgs   decode a capture into a session
+ *   tgsession -i session.tgs            print the index of each column
+ *   tgsession -c column session.tgs     print one column as time,value
+ *
+ * Build with the Makefile in the parent directory: make tools
+ */
+
+#include "ThinkGearCapture.h"
+#include "ThinkGearSession.h"
+#include "ThinkGearStreamParser.h"
+#include <stdio.h>
+#include <string.h>
+
+using thinkgear::SessionChunk;
+using thinkgear::SessionColumn;
+
+namespace {
+
+struct Convert {
+    thinkgear::SessionWriter *writer;
+    uint64_t micros;
+};
+
+void handleFrame(const ThinkGearFrame *frame, void *customData){
+    Convert& c = *static_cast<Convert*>(customData);
+    c.writer->addFrame(*frame, c.micros);
+}
+
+void handleDataValue(unsigned char, unsigned char, unsigned char,
+                     const unsigned char *, void *){
+}
+
+int convert(const char *in, const char *out){
+    thinkgear::CaptureReader reader;
+    if (!reader.open(in)){
+        fprintf(stderr, "%s: not a capture file\n", in);
+        return 1;
+    }
+    thinkgear::SessionWriter writer;
+    if (!writer.open(out, reader.getHeader().startTime)){
+        fprintf(stderr, "%s: cannot create\n", out);
+        return 1;
+    }
+
+    static ThinkGearStreamParser parser;
+    static ThinkGearFrame frame;
+    Convert c = { &writer, 0 };
+    THINKGEAR_initFrameParser(&parser, &frame, handleFrame, handleDataValue, &c);
+    THINKGEAR_setResync(&parser, 1);
+
+    // Feed one read at a time so each frame gets the time its bytes arrived
+    thinkgear::CaptureChunk chunk;
+    while (reader.next(chunk)){
+        thinkgear::CaptureReadIterator reads(chunk);
+        const unsigned char *p = chunk.bytes;
+        const unsigned char *end = chunk.bytes + chunk.numBytes;
+        size_t n;
+        while (reads.next(c.micros, n) && n <= (size_t)(end - p)){
+            THINKGEAR_parseBuffer(&parser, p, n);
+            p += n;
+        }
+    }
+    if (reader.isTruncated())
+        fprintf(stderr, "%s: truncated, converted up to the last whole chunk\n", in);
+    if (!writer.close()){
+        fprintf(stderr, "%s: write failed\n", out);
+        return 1;
+    }
+    return 0;
+}
+
+int printIndex(const thinkgear::SessionReader& reader){
+    printf("%-11s %7s %10s %11s %12s %12s %10s\n",
+           "column", "chunks", "values", "bytes", "min", "max", "seconds");
+    for (int c=0; c<thinkgear::SESSION_COLUMNS; ++c){
+        SessionColumn column = (SessionColumn)c;
+        size_t chunks = reader.getChunkCount(column);
+        unsigned long long values = 0, bytes = 0;
+        long long lo = 0, hi = 0;
+        uint64_t first = 0, last = 0;
+        for (size_t i=0; i<chunks; ++i){
+            SessionChunk chunk;
+            reader.getChunk(column, i, chunk);
+            if (i == 0 || chunk.min < lo) lo = chunk.min;
+            if (i == 0 || chunk.max > hi) hi = chunk.max;
+            if (i == 0) first = chunk.firstMicros;
+            last = chunk.lastMicros;
+            values += chunk.count;
+            bytes += (unsigned long long)chunk.count * thinkgear::sessionValueSize(column);
+        }
+        printf("%-11s %7lu %10llu %11llu %12lld %12lld %10.1f\n",
+               thinkgear::sessionColumnName(column), (unsigned long)chunks, values,
+               bytes, lo, hi, (last - first) * 1e-6);
+    }
+    return 0;
+}
+
+int printColumn(const thinkgear::SessionReader& reader, const char *name){
+    int c = 0;
+    while (c < thinkgear::SESSION_COLUMNS &&
+           strcmp(name, thinkgear::sessionColumnName((SessionColumn)c)) != 0)
+        ++c;
+    if (c == thinkgear::SESSION_COLUMNS){
+        fprintf(stderr, "unknown column %s\n", name);
+        return 2;
+    }
+    SessionColumn column = (SessionColumn)c;
+    for (size_t i=0; i<reader.getChunkCount(column); ++i){
+        SessionChunk chunk;
+        reader.getChunk(column, i, chunk);
+        if (column == thinkgear::SESSION_RAW){
+            // Raw samples are evenly spaced within a chunk
+            double step = chunk.count > 1 ?
+                (double)(chunk.lastMicros - chunk.firstMicros) / (chunk.count - 1) : 0;
+            for (uint32_t k=0; k<chunk.count; ++k)
+                printf("%.6f,%lld\n", (chunk.firstMicros + k * step) * 1e-6, (long long)chunk.value(k));
+        } else {
+            // The 1 Hz columns are chunked in step with their time column
+            SessionChunk times;
+            reader.getChunk(thinkgear::SESSION_SLOW_TIME, i, times);
+            for (uint32_t k=0; k<chunk.count && k<times.count; ++k)
+                printf("%.6f,%lld\n", times.values<uint64_t>()[k] * 1e-6, (long long)chunk.value(k));
+        }
+    }
+    return 0;
+}
+
+int usage(){
+    fprintf(stderr,
+            "usage: tgsession capture.tgc session.tgs\n"
+            "       tgsession -i session.tgs\n"
+            "       tgsession -c column session.tgs\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    if (argc == 3 && strcmp(argv[1], "-i") != 0)
+        return convert(argv[1], argv[2]);
+
+    const char *path;
+    if (argc == 3 && strcmp(argv[1], "-i") == 0)
+        path = argv[2];
+    else if (argc == 4 && strcmp(argv[1], "-c") == 0)
+        path = argv[3];
+    else
+        return usage();
+
+    thinkgear::SessionReader reader;
+    if (!reader.open(path)){
+        fprintf(stderr, "%s: not a session file\n", path);
+        return 1;
+    }
+    return argc == 3 ? printIndex(reader) : printColumn(reader, argv[2]);
+}
@@ -0,0 +1,247 @@
+/*
+ * tgsim: simulates MindWave dongles and headsets on pseudo-terminals (see
+ * ThinkGearSimulator.h).  Prints the name of each terminal, then serves
+ * them until interrupted; point ofxThinkgear, tgcat or anything else that
+ * reads a serial port at those names.
+ *
+ *   tgsim [options]
+ *
+ *   -n count    headsets to simulate (1)
+ *   -j threads  threads serving them (1 per 32 headsets)
+ *   -l prefix   also link prefix0, prefix1... to the terminals
+ *   -m          start out streaming, without the dongle handshake
+ *   -d rate     chance each byte is dropped
+ *   -c rate     chance each byte is corrupted
+ *   -b rate     chance per second of a burst...
+ *   -B millis   ...that holds the stream back this long (200)
+ *   -f rate     chance a connect request ends in "headset not found"
+ *   -s seconds  stop after this many seconds
+ *   -S seed     seed for the signals and faults (1)
+ *
+ * Build with the Makefile in the parent directory: make tools
+ */
+
+#include "ThinkGearSimulator.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using thinkgear::HeadsetSimulator;
+
+namespace {
+
+volatile sig_atomic_t stopping = 0;
+
+void handleSignal(int){
+    stopping = 1;
+}
+
+uint64_t nowMicros(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Terminal {
+    HeadsetSimulator sim;
+    int master;
+    int slave;              // kept open so the master never sees a hangup
+    std::string name;
+    std::string link;
+    uint64_t overflow;      // bytes the terminal had no room for
+
+    Terminal(uint16_t id, uint64_t seed)
+        : sim(id, seed), master(-1), slave(-1), overflow(0) {}
+};
+
+bool openTerminal(Terminal& t){
+    t.master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (t.master < 0 || grantpt(t.master) != 0 || unlockpt(t.master) != 0)
+        return false;
+    const char *name = ptsname(t.master);
+    if (!name)
+        return false;
+    t.name = name;
+    t.slave = open(name, O_RDWR | O_NOCTTY);
+    if (t.slave < 0)
+        return false;
+    // Binary bytes both ways: no echo, no newline translation
+    struct termios tio;
+    if (tcgetattr(t.slave, &tio) != 0)
+        return false;
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B115200);
+    cfsetospeed(&tio, B115200);
+    if (tcsetattr(t.slave, TCSANOW, &tio) != 0)
+        return false;
+    return fcntl(t.master, F_SETFL, fcntl(t.master, F_GETFL) | O_NONBLOCK) == 0;
+}
+
+// Serves its share of the terminals until stopping or end
+void serve(std::vector<Terminal*> terminals, uint64_t end){
+    std::vector<struct pollfd> fds(terminals.size());
+    std::vector<unsigned char> out;
+    out.reserve(65536);
+    unsigned char commands[64];
+
+    for (size_t i=0; i<terminals.size(); ++i){
+        fds[i].fd = terminals[i]->master;
+        fds[i].events = POLLIN;
+    }
+    while (!stopping){
+        uint64_t now = nowMicros();
+        if (end && now >= end)
+            break;
+        uint64_t next = now + 10000;
+        for (size_t i=0; i<terminals.size(); ++i){
+            uint64_t n = terminals[i]->sim.nextMicros();
+            if (n < next)
+                next = n;
+        }
+        int timeout = next > now ? (int)((next - now + 999) / 1000) : 0;
+        if (poll(&fds[0], fds.size(), timeout) < 0 && errno != EINTR)
+            break;
+
+        now = nowMicros();
+        for (size_t i=0; i<terminals.size(); ++i){
+            Terminal& t = *terminals[i];
+            if (fds[i].revents & POLLIN){
+                ssize_t n;
+                while ((n = read(t.master, commands, sizeof(commands))) > 0)
+                    for (ssize_t k=0; k<n; ++k)
+                        t.sim.command(commands[k], now);
+            }
+            out.clear();
+            if (t.sim.generate(now, out) == 0)
+                continue;
+            ssize_t w = write(t.master, &out[0], out.size());
+            if (w < 0)
+                w = 0;
+            // A serial port with nobody reading loses bytes the same way
+            t.overflow += out.size() - (size_t)w;
+        }
+    }
+}
+
+int usage(){
+    fprintf(stderr,
+            "usage: tgsim [-n count] [-j threads] [-l prefix] [-m] [-d rate] [-c rate]\n"
+            "             [-b rate] [-B millis] [-f rate] [-s seconds] [-S seed]\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    int count = 1;
+    int threads = 0;
+    const char *prefix = NULL;
+    bool mobile = false;
+    double seconds = 0;
+    uint64_t seed = 1;
+    thinkgear::SimulatorFaults faults;
+
+    for (int i=1; i<argc; ++i){
+        const char *a = argv[i];
+        bool value = i+1 < argc;
+        if (strcmp(a, "-m") == 0) mobile = true;
+        else if (strcmp(a, "-n") == 0 && value) count = atoi(argv[++i]);
+        else if (strcmp(a, "-j") == 0 && value) threads = atoi(argv[++i]);
+        else if (strcmp(a, "-l") == 0 && value) prefix = argv[++i];
+        else if (strcmp(a, "-d") == 0 && value) faults.dropRate = atof(argv[++i]);
+        else if (strcmp(a, "-c") == 0 && value) faults.corruptRate = atof(argv[++i]);
+        else if (strcmp(a, "-b") == 0 && value) faults.burstRate = atof(argv[++i]);
+        else if (strcmp(a, "-B") == 0 && value) faults.burstMillis = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(a, "-f") == 0 && value) faults.notFoundRate = atof(argv[++i]);
+        else if (strcmp(a, "-s") == 0 && value) seconds = atof(argv[++i]);
+        else if (strcmp(a, "-S") == 0 && value) seed = strtoull(argv[++i], NULL, 0);
+        else return usage();
+    }
+    if (count < 1)
+        return usage();
+    if (threads < 1)
+        threads = (count + 31) / 32;
+    if (threads > count)
+        threads = count;
+
+    signal(SIGINT, handleSignal);
+    signal(SIGTERM, handleSignal);
+
+    std::vector<Terminal*> terminals;
+    int status = 0;
+    uint64_t start = nowMicros();
+    for (int i=0; i<count; ++i){
+        Terminal *t = new Terminal((uint16_t)(0x1000 + i), seed + i);
+        terminals.push_back(t);
+        if (!openTerminal(*t)){
+            fprintf(stderr, "cannot open pseudo-terminal %d: %s\n", i, strerror(errno));
+            status = 1;
+            break;
+        }
+        t->sim.setFaults(faults);
+        if (mobile)
+            t->sim.setConnected(start);
+        if (prefix){
+            char link[256];
+            snprintf(link, sizeof(link), "%s%d", prefix, i);
+            unlink(link);
+            if (symlink(t->name.c_str(), link) != 0){
+                fprintf(stderr, "%s: %s\n", link, strerror(errno));
+                status = 1;
+                break;
+            }
+            t->link = link;
+        }
+        printf("%s\n", prefix ? t->link.c_str() : t->name.c_str());
+    }
+    fflush(stdout);
+
+    if (status == 0){
+        uint64_t end = seconds > 0 ? start + (uint64_t)(seconds * 1e6) : 0;
+        std::vector<std::thread> pool;
+        for (int j=0; j<threads; ++j){
+            std::vector<Terminal*> share;
+            for (int i=j; i<count; i+=threads)
+                share.push_back(terminals[i]);
+            pool.push_back(std::thread(serve, share, end));
+        }
+        for (size_t j=0; j<pool.size(); ++j)
+            pool[j].join();
+    }
+
+    uint64_t out = 0, dropped = 0, corrupted = 0, overflow = 0;
+    unsigned long connected = 0, bursts = 0;
+    for (size_t i=0; i<terminals.size(); ++i){
+        Terminal& t = *terminals[i];
+        out += t.sim.getBytesOut();
+        dropped += t.sim.getBytesDropped();
+        corrupted += t.sim.getBytesCorrupted();
+        bursts += t.sim.getBursts();
+        overflow += t.overflow;
+        if (t.sim.getState() == HeadsetSimulator::CONNECTED)
+            connected++;
+        if (!t.link.empty())
+            unlink(t.link.c_str());
+        if (t.slave >= 0)
+            close(t.slave);
+        if (t.master >= 0)
+            close(t.master);
+        delete &t;
+    }
+    double elapsed = (nowMicros() - start) * 1e-6;
+    fprintf(stderr, "%lu headsets (%lu connected) for %.1f s: %llu bytes, %llu dropped, "
+            "%llu corrupted, %lu bursts, %llu not read in time\n",
+            (unsigned long)terminals.size(), connected, elapsed,
+            (unsigned long long)out, (unsigned long long)dropped,
+            (unsigned long long)corrupted, bursts, (unsigned long long)overflow);
+    return status;
+}
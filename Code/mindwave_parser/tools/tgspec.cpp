@@ -0,0 +1,231 @@
+/*
+ * tgspec: reads many ThinkGear devices at once, like tgmon, and runs a
+ * short-time Fourier transform over each one's raw samples (see
+ * ThinkGearSpectrum.h).  Prints a line per device every second with the
+ * spectra computed and the strongest frequency between 1 and 40 Hz.
+ *
+ *   tgspec [-w window] [-h hop] [-m hz] [-W wisdom] [-j threads] [-s seconds]
+ *          [-q] port-or-glob...
+ *
+ *   -w window   samples per transform, a power of two (256)
+ *   -h hop      samples between transforms (64, 8 a second)
+ *   -m hz       filter out drift and hum at this mains frequency first, all
+ *               devices in one FilterBank (see ThinkGearFilter.h)
+ *   -W wisdom   FFTW wisdom file to load and keep up to date
+ *   -j threads  pool threads reading the devices
+ *   -s seconds  stop after this many seconds
+ *   -q          print only the totals at the end
+ *
+ * Build with the Makefile in the parent directory: make tools
+ */
+
+#include "ThinkGearFilter.h"
+#include "ThinkGearManager.h"
+#include "ThinkGearSpectrum.h"
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using thinkgear::Headset;
+using thinkgear::Stft;
+
+namespace {
+
+volatile sig_atomic_t stopping = 0;
+
+void handleSignal(int){
+    stopping = 1;
+}
+
+size_t window = 256;
+size_t hop = 64;
+std::vector<Stft*> spectra;
+uint64_t stftMicros = 0;
+uint64_t filterMicros = 0;
+
+// With -m, raw samples wait here until filterPending()
+float mainsHz = 0;
+thinkgear::FilterBank filter;
+std::vector<std::vector<int16_t> > pending;
+
+void feedFrame(size_t device, const ThinkGearFrame& frame, uint64_t, void *){
+    while (device >= spectra.size()){
+        spectra.push_back(new Stft());
+        spectra.back()->setup(window, hop);
+    }
+    if (!(frame.present & THINKGEAR_FRAME_RAW))
+        return;
+    if (mainsHz > 0){
+        if (device >= pending.size())
+            pending.resize(device + 1);
+        pending[device].insert(pending[device].end(), frame.raw, frame.raw + frame.numRaw);
+        return;
+    }
+    uint64_t start = Headset::nowMicros();
+    spectra[device]->feed(frame.raw, frame.numRaw);
+    stftMicros += Headset::nowMicros() - start;
+}
+
+void feedFiltered(size_t device, const float *samples, size_t count){
+    int16_t raw[512];
+    for (size_t done=0; done<count; done+=512){
+        size_t n = count - done < 512 ? count - done : 512;
+        for (size_t i=0; i<n; ++i){
+            float y = samples[done + i];
+            raw[i] = (int16_t)lrintf(y < -32768 ? -32768 : y > 32767 ? 32767 : y);
+        }
+        spectra[device]->feed(raw, n);
+    }
+}
+
+// Filters what every device has received, all of them together for as
+// long as each has samples, then alone any device over a second ahead of
+// the slowest (e.g. next to an unplugged one)
+void filterPending(){
+    size_t devices = pending.size();
+    if (devices == 0)
+        return;
+    uint64_t start = Headset::nowMicros();
+    if (filter.getChannels() != devices)
+        filter.setup(thinkgear::mainsChain(mainsHz), devices);
+    size_t common = pending[0].size();
+    for (size_t i=1; i<devices; ++i)
+        if (pending[i].size() < common)
+            common = pending[i].size();
+
+    static std::vector<std::vector<float> > out;
+    out.resize(devices);
+    std::vector<const int16_t*> in(devices);
+    std::vector<float*> outs(devices);
+    for (size_t i=0; i<devices; ++i){
+        size_t alone = pending[i].size() - common > THINKGEAR_RAW_RATE ? pending[i].size() - common : 0;
+        out[i].resize(common + alone);
+        in[i] = pending[i].data();
+        outs[i] = out[i].data();
+    }
+    if (common)
+        filter.process(in.data(), outs.data(), common);
+    for (size_t i=0; i<devices; ++i){
+        size_t alone = out[i].size() - common;
+        if (alone)
+            filter.process(i, pending[i].data() + common, out[i].data() + common, alone);
+        pending[i].erase(pending[i].begin(), pending[i].begin() + out[i].size());
+    }
+    uint64_t filtered = Headset::nowMicros();
+    filterMicros += filtered - start;
+    for (size_t i=0; i<devices; ++i)
+        feedFiltered(i, out[i].data(), out[i].size());
+    stftMicros += Headset::nowMicros() - filtered;
+}
+
+double cpuSeconds(){
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+}
+
+int usage(){
+    fprintf(stderr, "usage: tgspec [-w window] [-h hop] [-m hz] [-W wisdom] [-j threads] "
+            "[-s seconds] [-q] port-or-glob...\n");
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+    int threads = 0;
+    double seconds = 0;
+    bool quiet = false;
+    thinkgear::HeadsetManager manager;
+    manager.setFrameCallback(feedFrame, NULL);
+
+    int ports = 0;
+    for (int i=1; i<argc; ++i){
+        if (strcmp(argv[i], "-w") == 0 && i+1 < argc)
+            window = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-h") == 0 && i+1 < argc)
+            hop = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0 && i+1 < argc)
+            mainsHz = atof(argv[++i]);
+        else if (strcmp(argv[i], "-W") == 0 && i+1 < argc){
+            if (!thinkgear::setFftWisdomFile(argv[++i]))
+                fprintf(stderr, "tgspec: built without FFTW, ignoring -W\n");
+        } else if (strcmp(argv[i], "-j") == 0 && i+1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i+1 < argc)
+            seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "-q") == 0)
+            quiet = true;
+        else if (argv[i][0] == '-')
+            return usage();
+        else if (strpbrk(argv[i], "*?[")){
+            manager.addPorts(argv[i]);
+            ports++;
+        } else {
+            manager.addPort(argv[i]);
+            ports++;
+        }
+    }
+    Stft check;
+    if (ports == 0 || !check.setup(window, hop))
+        return usage();
+
+    signal(SIGINT, handleSignal);
+    signal(SIGTERM, handleSignal);
+
+    uint64_t start = Headset::nowMicros();
+    uint64_t end = seconds > 0 ? start + (uint64_t)(seconds * 1e6) : 0;
+    uint64_t nextReport = start + 1000000;
+    std::vector<uint64_t> last;
+    manager.start(threads);
+
+    while (!stopping && (!end || Headset::nowMicros() < end)){
+        manager.update();
+        filterPending();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        uint64_t now = Headset::nowMicros();
+        if (quiet || now < nextReport)
+            continue;
+        nextReport += 1000000;
+        last.resize(spectra.size(), 0);
+        printf("%-24s %8s %8s %8s\n", "device", "frames/s", "peak Hz", "peak");
+        for (size_t i=0; i<spectra.size(); ++i){
+            const Stft& s = *spectra[i];
+            uint64_t n = s.getFramesWritten();
+            const float *m = n ? s.getFrame(n - 1) : NULL;
+            size_t peak = 0;
+            for (size_t k=1; m && k<s.getBins() && k*s.getBinHz()<=40; ++k)
+                if (k*s.getBinHz() >= 1 && (!peak || m[k] > m[peak]))
+                    peak = k;
+            printf("%-24s %8lu %8.1f %8.1f\n", manager.getStatus(i).path.c_str(),
+                   (unsigned long)(n - last[i]), peak * s.getBinHz(), m ? m[peak] : 0.0f);
+            last[i] = n;
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+    manager.update();
+    filterPending();
+    manager.stop();
+
+    double elapsed = (Headset::nowMicros() - start) * 1e-6;
+    uint64_t frames = 0;
+    for (size_t i=0; i<spectra.size(); ++i){
+        frames += spectra[i]->getFramesWritten();
+        delete spectra[i];
+    }
+    size_t n = manager.getDeviceCount();
+    fprintf(stderr, "%lu devices for %.1f s: %.1f spectra/s per device, %.1f us each, "
+            "%.1f%% of one core in the STFT, %.2f%% filtering, %.1f%% in all\n",
+            (unsigned long)n, elapsed, n ? frames / elapsed / n : 0.0,
+            frames ? stftMicros / (double)frames : 0.0, 100 * stftMicros * 1e-6 / elapsed,
+            100 * filterMicros * 1e-6 / elapsed, 100 * cpuSeconds() / elapsed);
+    return 0;
+}